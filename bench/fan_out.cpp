@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "analysis.h"
+#include "san.h"
+#include "spectate.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief the client end of one spectator connection
+    struct Watcher
+    {
+        int fd = -1;
+        uint32_t game = 0;
+        /// @brief reads only the frame that confirms the subscription and then stops, like a stalled client
+        bool slow = false;
+        uint64_t frames = 0;
+        std::string partial;
+        std::string lastFrame;
+    };
+
+    int connectTo(const std::string &path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), address.sun_path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+            throw std::runtime_error("failed to connect to " + path);
+        return fd;
+    }
+
+    /// @return false when the server closed the connection
+    bool readFrames(Watcher &watcher)
+    {
+        char buffer[16384];
+        ssize_t received = recv(watcher.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received == 0)
+            return false;
+        if (received < 0)
+            return true;
+        watcher.partial.append(buffer, static_cast<size_t>(received));
+        size_t start = 0;
+        size_t end;
+        while ((end = watcher.partial.find('\n', start)) != std::string::npos)
+        {
+            watcher.frames++;
+            watcher.lastFrame.assign(watcher.partial, start, end + 1 - start);
+            start = end + 1;
+        }
+        watcher.partial.erase(0, start);
+        return true;
+    }
+}
+
+/// @brief fan-out: broadcasts replayed games to many spectator connections and measures what publishing costs
+int main(int argc, char **argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "--help")
+    {
+        std::println("usage: {0} <games dir | archive.cga | file.pgn> [--spectators N] [--slow N] [--games N] [--moves N]", argv[0]);
+        std::println("       [--queue N] [--policy coalesce|drop]");
+        return argc < 2 ? 1 : 0;
+    }
+
+    size_t spectatorCount = 500;
+    size_t slowCount = 10;
+    size_t gameCount = 20;
+    size_t moveCount = 20000;
+    SpectatorOptions options;
+
+    try
+    {
+        for (int i = 2; i + 1 < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if (flag == "--spectators")
+                spectatorCount = std::stoul(value);
+            else if (flag == "--slow")
+                slowCount = std::stoul(value);
+            else if (flag == "--games")
+                gameCount = std::max<size_t>(1, std::stoul(value));
+            else if (flag == "--moves")
+                moveCount = std::stoul(value);
+            else if (flag == "--queue")
+                options.maxQueuedFrames = std::stoul(value);
+            else if (flag == "--policy" && (value == "coalesce" || value == "drop"))
+                options.policy = value == "drop" ? SlowSpectatorPolicy::DROP : SlowSpectatorPolicy::COALESCE;
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+        slowCount = std::min(slowCount, spectatorCount);
+
+        // both ends of every connection are in this process
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+
+        namespace fs = std::filesystem;
+        const std::string corpusPath = fs::absolute(argv[1]).string();
+        const fs::path scratch = fs::temp_directory_path() / ("chess-fan-out-" + std::to_string(getpid()));
+        fs::create_directories(scratch / "games");
+        fs::current_path(scratch);
+
+        std::vector<AnalysisJob> jobs;
+        for (AnalysisJob &job : GameAnalyzer::loadJobs(corpusPath))
+        {
+            if (job.game.getTag("FEN").empty())
+                jobs.push_back(std::move(job));
+        }
+        if (jobs.empty())
+            throw std::runtime_error("no games from the standard position in " + corpusPath);
+
+        options.path = (scratch / "spectate.sock").string();
+        SpectatorServer server(options);
+
+        // every game runs one corpus game after another on its own board
+        struct LiveGame
+        {
+            std::unique_ptr<PieceFactory> factory = std::make_unique<PieceFactory>();
+            std::unique_ptr<GameManager> gm = std::make_unique<GameManager>(*factory);
+            size_t job = 0;
+            size_t ply = 0;
+        };
+        std::vector<LiveGame> games(gameCount);
+        size_t nextJob = 0;
+        auto startGame = [&](LiveGame &game)
+        {
+            game.job = nextJob++ % jobs.size();
+            game.ply = 0;
+            GameAnalyzer::setupJob(jobs[game.job], *game.gm);
+        };
+        auto playMove = [&](uint32_t id, LiveGame &game)
+        {
+            for (size_t attempts = 0; attempts < jobs.size(); attempts++)
+            {
+                const AnalysisJob &job = jobs[game.job];
+                const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+                if (game.ply < plies)
+                {
+                    try
+                    {
+                        Move move = GameAnalyzer::resolveMove(job, *game.gm, game.ply);
+                        std::string san = SanNotation::toSan(*game.gm, move);
+                        if (game.gm->replayMove(move))
+                        {
+                            game.ply++;
+                            server.publishMove(id, *game.gm, san + SanNotation::checkSuffix(*game.gm));
+                            return;
+                        }
+                    }
+                    catch (const std::exception &)
+                    {
+                        // a broken corpus game is skipped like a finished one
+                    }
+                }
+                startGame(game);
+            }
+            throw std::runtime_error("no game in " + corpusPath + " replays");
+        };
+
+        // one move per game first, so every subscription is confirmed by the frame a late joiner gets
+        for (size_t g = 0; g < gameCount; g++)
+        {
+            startGame(games[g]);
+            playMove(static_cast<uint32_t>(g + 1), games[g]);
+        }
+        std::vector<Watcher> watchers(spectatorCount);
+        for (size_t i = 0; i < spectatorCount; i++)
+        {
+            Watcher &watcher = watchers[i];
+            watcher.fd = connectTo(options.path);
+            watcher.game = static_cast<uint32_t>(i % gameCount + 1);
+            watcher.slow = i < slowCount;
+            std::string request = "watch " + std::to_string(watcher.game) + "\n";
+            if (send(watcher.fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size()))
+                throw std::runtime_error("failed to subscribe");
+            while (watcher.frames == 0)
+            {
+                pollfd fd{watcher.fd, POLLIN, 0};
+                if (poll(&fd, 1, 5000) <= 0 || !readFrames(watcher))
+                    throw std::runtime_error("subscription was not confirmed");
+            }
+        }
+
+        // the fast spectators read everything on a thread of their own while the games are played
+        std::atomic<bool> published{false};
+        std::thread reader([&]
+                           {
+            std::vector<pollfd> fds;
+            std::vector<Watcher *> open;
+            for (Watcher &watcher : watchers)
+            {
+                if (!watcher.slow)
+                {
+                    fds.push_back({watcher.fd, POLLIN, 0});
+                    open.push_back(&watcher);
+                }
+            }
+            auto idleSince = Clock::now();
+            while (!published.load() || Clock::now() - idleSince < std::chrono::milliseconds(500))
+            {
+                if (poll(fds.data(), fds.size(), 50) <= 0)
+                    continue;
+                idleSince = Clock::now();
+                for (size_t i = 0; i < fds.size(); i++)
+                {
+                    if ((fds[i].revents & (POLLIN | POLLHUP)) && !readFrames(*open[i]))
+                        fds[i].fd = -1;
+                }
+            } });
+
+        std::vector<double> latencies;
+        latencies.reserve(moveCount);
+        auto start = Clock::now();
+        for (size_t m = 0; m < moveCount; m++)
+        {
+            const size_t g = m % gameCount;
+            auto moveStart = Clock::now();
+            playMove(static_cast<uint32_t>(g + 1), games[g]);
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - moveStart).count());
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        published = true;
+        reader.join();
+        SpectatorStats stats = server.getStats();
+
+        // the latest position is what coalescing promises, so every fast spectator has to end on it
+        size_t current = 0;
+        uint64_t fastFrames = 0;
+        for (Watcher &watcher : watchers)
+        {
+            if (watcher.slow)
+                continue;
+            fastFrames += watcher.frames;
+            const std::string latest = SpectatorServer::serialize(watcher.game, *games[watcher.game - 1].gm, "");
+            const size_t fen = latest.find("\"fen\"");
+            current += watcher.lastFrame.find(latest.substr(fen, latest.find(",\"status\"") - fen)) != std::string::npos;
+        }
+        for (Watcher &watcher : watchers)
+            close(watcher.fd);
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p)
+        { return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+        std::println("{0} moves in {1} games to {2} spectators ({3} slow): {4:.3f} s, {5:.0f} moves/s", moveCount, gameCount,
+                     spectatorCount, slowCount, seconds, moveCount / seconds);
+        std::println("move + serialize + fan-out p50 {0:.1f} us, p99 {1:.1f} us", percentile(0.5), percentile(0.99));
+        std::println("{0} frames serialized, {1} bytes, {2:.1f} bytes per frame", stats.published, stats.serializedBytes,
+                     stats.published ? static_cast<double>(stats.serializedBytes) / stats.published : 0.0);
+        std::println("{0} frames queued, {1} sent, {2} coalesced, {3} spectators dropped, {4} still connected", stats.queued, stats.sent,
+                     stats.coalesced, stats.dropped, stats.spectators);
+        std::println("fast spectators: {0} frames read, {1} of {2} ended on the latest position", fastFrames, current,
+                     spectatorCount - slowCount);
+
+        fs::current_path(scratch.parent_path());
+        fs::remove_all(scratch);
+        // under DROP a fast spectator that fell behind is rightly gone
+        return options.policy == SlowSpectatorPolicy::DROP || current == spectatorCount - slowCount ? 0 : 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "journal.h"
+#include "writer.h"
+
+namespace
+{
+    struct RunResult
+    {
+        double seconds = 0;
+        /// @brief per-save acknowledgement latency in microseconds
+        std::vector<double> latencies;
+    };
+
+    /// @brief the save path used before the journal: temporary file, fsync, rename
+    void saveDirect(const std::string &file, const std::string &content, size_t)
+    {
+        std::string tempFile = file + ".tmp";
+        int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ::write(fd, content.data(), content.size()) != static_cast<ssize_t>(content.size()) || ::fsync(fd) != 0)
+            throw std::runtime_error("failed to write " + tempFile);
+        ::close(fd);
+        std::filesystem::rename(tempFile, file);
+    }
+
+    /// @brief every thread plays its games move by move, saving the game file after each move; save gets the
+    /// whole content and where the new move starts in it
+    template <typename Save>
+    RunResult run(const std::string &dir, int threads, int games, int moves, Save save)
+    {
+        std::vector<std::vector<double>> latencies(threads);
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                for (int g = 0; g < games; g++)
+                {
+                    std::string file = dir + "/game_" + std::to_string(t) + "_" + std::to_string(g) + ".txt";
+                    std::string content = "[Date \"2026-01-01\"]\n\n";
+                    for (int m = 1; m <= moves; m++)
+                    {
+                        const size_t moveStart = m == 1 ? 0 : content.size();
+                        content += std::to_string(m) + ". e2 -> e4 | e7 -> e5\n";
+                        auto saveStart = std::chrono::steady_clock::now();
+                        save(file, content, moveStart);
+                        latencies[t].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - saveStart).count());
+                    }
+                } });
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+
+        RunResult result;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (const std::vector<double> &threadLatencies : latencies)
+            result.latencies.insert(result.latencies.end(), threadLatencies.begin(), threadLatencies.end());
+        std::sort(result.latencies.begin(), result.latencies.end());
+        return result;
+    }
+
+    void report(const char *name, const RunResult &result)
+    {
+        auto percentile = [&](double p)
+        { return result.latencies[static_cast<size_t>(p * (result.latencies.size() - 1))]; };
+        std::println("{0:<8} {1:>8} saves in {2:.3f} s, {3:.0f} saves/s, ack latency p50 {4:.0f} us, p99 {5:.0f} us",
+                     name, result.latencies.size(), result.seconds, result.latencies.size() / result.seconds,
+                     percentile(0.5), percentile(0.99));
+    }
+}
+
+/// @brief group-commit: compares journaled game saves, direct and through per-game writer threads, against one fsync per save
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::println("usage: {0} <scratch dir> [threads] [games per thread] [moves per game] [interval us]", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        const std::string dir = argv[1];
+        const int threads = argc > 2 ? std::stoi(argv[2]) : 64;
+        const int games = argc > 3 ? std::stoi(argv[3]) : 4;
+        const int moves = argc > 4 ? std::stoi(argv[4]) : 20;
+        std::filesystem::create_directories(dir);
+
+        RunResult direct = run(dir, threads, games, moves, saveDirect);
+        report("fsync", direct);
+
+        JournalOptions options;
+        options.path = dir + "/journal.log";
+        if (argc > 5)
+            options.interval = std::chrono::microseconds(std::stoi(argv[5]));
+        JournalStats stats;
+        RunResult journaled;
+        {
+            GameJournal journal(options);
+            journaled = run(dir, threads, games, moves, [&](const std::string &file, const std::string &content, size_t moveStart)
+                            { journal.write(file, content.substr(moveStart), moveStart); });
+            stats = journal.getStats();
+        }
+        report("journal", journaled);
+        std::println("journal: {0} records, {1} commits ({2:.1f} saves per fsync), {3:.2f} MB journaled, {4} checkpoints",
+                     stats.records, stats.commits, stats.commits ? static_cast<double>(stats.records) / stats.commits : 0.0,
+                     stats.bytes / (1024.0 * 1024.0), stats.checkpoints);
+
+        // every game thread owns a writer, as every Chess does; the ack is the push, durability comes later
+        WriterStats writerStats;
+        RunResult written;
+        {
+            GameJournal journal(options);
+            std::vector<std::unique_ptr<GameWriter>> writers;
+            for (int t = 0; t < threads; t++)
+                writers.push_back(std::make_unique<GameWriter>(journal));
+            std::atomic<size_t> nextWriter{0};
+            written = run(dir, threads, games, moves, [&](const std::string &file, const std::string &content, size_t moveStart)
+                          {
+                thread_local GameWriter *writer = writers[nextWriter++].get();
+                writer->write(file, content.substr(moveStart), moveStart); });
+            for (const auto &writer : writers)
+            {
+                writer->flush();
+                WriterStats one = writer->getStats();
+                writerStats.records += one.records;
+                writerStats.maxQueueDepth = std::max(writerStats.maxQueueDepth, one.maxQueueDepth);
+                writerStats.producerStalls += one.producerStalls;
+                writerStats.maxPushLatency = std::max(writerStats.maxPushLatency, one.maxPushLatency);
+                writerStats.maxDurableLatency = std::max(writerStats.maxDurableLatency, one.maxDurableLatency);
+                writerStats.totalDurableLatency += one.totalDurableLatency;
+            }
+        }
+        report("writer", written);
+        std::println("writer:  max queue depth {0}, {1} stalls, max push {2} ns, durable after {3:.0f} us on average ({4} us max)",
+                     writerStats.maxQueueDepth, writerStats.producerStalls, writerStats.maxPushLatency.count(),
+                     writerStats.records ? static_cast<double>(writerStats.totalDurableLatency.count()) / writerStats.records : 0.0,
+                     writerStats.maxDurableLatency.count());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
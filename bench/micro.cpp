@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "classes.h"
+#include "fen.h"
+#include "searchboard.h"
+
+namespace
+{
+    /// @brief fixed positions every rules benchmark runs over: openings, middlegames, endgames, checks, en passant,
+    /// promotion, two checkmates and a stalemate
+    const char *const corpusFens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "8/P6k/8/8/8/8/6Kp/8 w - - 0 1",
+        "8/8/8/4k3/8/8/3q4/4K3 w - - 0 1",
+        "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3",
+        "R5k1/5ppp/8/8/8/8/8/6K1 b - - 0 1",
+        "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1",
+    };
+
+    /// @brief the game the notation benchmarks write, parse and load: Morphy's opera game
+    const char *const gameSan[] = {
+        "e4", "e5", "Nf3", "d6", "d4", "Bg4", "dxe5", "Bxf3", "Qxf3", "dxe5", "Bc4", "Nf6", "Qb3", "Qe7", "Nc3", "c6", "Bg5",
+        "b5", "Nxb5", "cxb5", "Bxb5+", "Nbd7", "O-O-O", "Rd8", "Rxd7", "Rxd7", "Rd1", "Qe6", "Bxd7+", "Nxd7", "Qb8+", "Nxb8", "Rd8#",
+    };
+
+    /// @brief the standard perft positions with their known leaf counts at perftDepth, which the compact move
+    /// generator has to reproduce before anything is timed
+    struct PerftCheck
+    {
+        const char *fen;
+        uint64_t nodes;
+    };
+    constexpr int perftDepth = 3;
+    const PerftCheck perftChecks[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 8902},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 97862},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 2812},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 9467},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 62379},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 89890},
+    };
+
+    struct Benchmark
+    {
+        std::string name;
+        std::string corpus;
+        /// @brief runs the operation over its whole corpus once and returns how many calls that made;
+        /// results are folded into the checksum so nothing is optimised away and changes in behaviour show
+        std::function<uint64_t(uint64_t &checksum)> pass;
+    };
+
+    struct Measurement
+    {
+        uint64_t opsPerPass = 0;
+        uint64_t checksum = 0;
+        /// @brief nanoseconds per operation of every sample, sorted
+        std::vector<double> samples;
+    };
+
+    Measurement measure(const Benchmark &benchmark, std::chrono::milliseconds minTime, size_t samples)
+    {
+        using Clock = std::chrono::steady_clock;
+        Measurement result;
+        auto start = Clock::now();
+        result.opsPerPass = std::max<uint64_t>(1, benchmark.pass(result.checksum));
+        const double firstPass = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // enough passes per sample that each one takes at least minTime
+        const double target = std::chrono::duration<double>(minTime).count();
+        const uint64_t passes = std::max<uint64_t>(1, static_cast<uint64_t>(target / std::max(firstPass, 1e-9)));
+        for (size_t sample = 0; sample < samples; sample++)
+        {
+            uint64_t sink = 0;
+            start = Clock::now();
+            for (uint64_t pass = 0; pass < passes; pass++)
+                benchmark.pass(sink);
+            const double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            result.samples.push_back(nanoseconds / static_cast<double>(passes * result.opsPerPass));
+        }
+        std::sort(result.samples.begin(), result.samples.end());
+        return result;
+    }
+
+    void writeJson(std::ostream &out, const std::vector<Benchmark> &benchmarks, const std::vector<Measurement> &results,
+                   std::chrono::milliseconds minTime, size_t samples)
+    {
+#ifdef __OPTIMIZE__
+        const bool optimized = true;
+#else
+        const bool optimized = false;
+#endif
+        out << "{\n  \"build\": {\"optimized\": " << (optimized ? "true" : "false") << ", \"compiler\": \"" << __VERSION__
+            << "\"},\n  \"settings\": {\"minTimeMs\": " << minTime.count() << ", \"samples\": " << samples
+            << "},\n  \"benchmarks\": [";
+        for (size_t i = 0; i < benchmarks.size(); i++)
+        {
+            const Measurement &m = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << benchmarks[i].name << "\", \"corpus\": \"" << benchmarks[i].corpus
+                << "\", \"opsPerPass\": " << m.opsPerPass << ", \"nsPerOp\": {\"median\": " << m.samples[m.samples.size() / 2]
+                << ", \"min\": " << m.samples.front() << ", \"max\": " << m.samples.back() << "}, \"checksum\": " << m.checksum << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+/// @brief bench: microbenchmarks of the rules and notation hot paths on a fixed corpus, written as JSON
+int main(int argc, char **argv)
+{
+    std::string filter;
+    std::string outputPath;
+    std::chrono::milliseconds minTime{200};
+    size_t samples = 5;
+
+    try
+    {
+        for (int i = 1; i < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            if (flag == "--help")
+            {
+                std::cout << "usage: " << argv[0] << " [--filter substring] [--min-time ms] [--samples N] [--output file.json]\n";
+                return 0;
+            }
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value for " + flag);
+            std::string value = argv[i + 1];
+            if (flag == "--filter")
+                filter = value;
+            else if (flag == "--min-time")
+                minTime = std::chrono::milliseconds(std::stoi(value));
+            else if (flag == "--samples")
+                samples = std::max(1ul, std::stoul(value));
+            else if (flag == "--output")
+                outputPath = std::filesystem::absolute(value).string();
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+#ifndef __OPTIMIZE__
+        std::cerr << "warning: unoptimised build, configure without -DCMAKE_BUILD_TYPE=Debug for meaningful numbers\n";
+#endif
+
+        // game files are written to games/ under the working directory, so the benchmark gets a scratch one;
+        // creating games/ up front also keeps PgnNotation from announcing it on stdout
+        namespace fs = std::filesystem;
+        const fs::path scratch = fs::temp_directory_path() / ("chess-bench-" + std::to_string(getpid()));
+        fs::create_directories(scratch / "games");
+        fs::current_path(scratch);
+
+        // a factory hands its pieces back on every setup, so each position needs its own
+        std::deque<PieceFactory> factories;
+        std::deque<GameManager> positions;
+        for (const char *fen : corpusFens)
+            FenNotation::fromFen(positions.emplace_back(factories.emplace_back()), fen);
+        const std::string corpus = std::to_string(positions.size()) + " positions";
+
+        // archive decoding, search, analysis, puzzles and self-play all rest on SearchBoard's move generator,
+        // so a wrong count fails the run instead of being timed
+        std::vector<SearchBoard> perftBoards;
+        for (const PerftCheck &check : perftChecks)
+        {
+            PieceFactory factory;
+            GameManager gm(factory);
+            FenNotation::fromFen(gm, check.fen);
+            uint64_t nodes = perftBoards.emplace_back(gm).perft(perftDepth);
+            if (nodes != check.nodes)
+                throw std::runtime_error("perft " + std::to_string(perftDepth) + " of " + check.fen + " is " +
+                                         std::to_string(nodes) + ", expected " + std::to_string(check.nodes));
+        }
+
+        // the game as the app saves it, one writeTurn call per ply
+        struct GameMove
+        {
+            PieceColor color;
+            PieceType type;
+            Move move;
+            std::string special;
+        };
+        std::vector<GameMove> game;
+        {
+            PieceFactory factory;
+            GameManager gm(factory);
+            gm.setupBoard();
+            for (const char *san : gameSan)
+            {
+                std::optional<Move> move = SanNotation::fromSan(gm, san);
+                if (!move)
+                    throw std::runtime_error(std::string("benchmark game does not replay at ") + san);
+                PieceInterface *piece = gm.getBoard().getPieceAt(move->from);
+                std::string special;
+                if (piece->getType() == PieceType::KING && std::abs(move->to.col - move->from.col) == 2)
+                    special = move->to.col > move->from.col ? "O-O" : "O-O-O";
+                game.push_back({piece->getColor(), piece->getType(), *move, special});
+                gm.replayMove(*move);
+            }
+        }
+        auto writeGame = [&game](PgnNotation &pgn)
+        {
+            for (size_t ply = 0; ply < game.size(); ply++)
+            {
+                const GameMove &m = game[ply];
+                pgn.writeTurn(static_cast<int>(ply / 2 + 1), m.color, m.type, m.move.from.col, m.move.from.row, m.move.to.col, m.move.to.row, m.special);
+            }
+        };
+
+        std::string savedGame;
+        {
+            PgnNotation pgn;
+            pgn.initNewGame();
+            writeGame(pgn);
+            std::ifstream in(pgn.getFileName());
+            std::ostringstream content;
+            content << in.rdbuf();
+            savedGame = content.str();
+        }
+        std::ofstream("games/bench.txt") << savedGame;
+        std::vector<std::string> savedLines;
+        std::istringstream lines(savedGame);
+        for (std::string line; std::getline(lines, line);)
+            savedLines.push_back(line);
+        const std::string gameCorpus = std::to_string(game.size()) + " plies";
+
+        auto forEachSquare = [](auto &&body)
+        {
+            for (int row = 1; row <= 8; row++)
+                for (char col = 'a'; col <= 'h'; col++)
+                    body(Position(col, row));
+        };
+
+        std::vector<Benchmark> benchmarks = {
+            {"MoveManager::isValidMove", corpus + ", every piece to every square",
+             [&](uint64_t &checksum)
+             {
+                 uint64_t ops = 0;
+                 for (GameManager &gm : positions)
+                 {
+                     const Board &board = gm.getBoard();
+                     MoveManager mm(gm.getEnPassantSquare());
+                     forEachSquare([&](const Position &from)
+                                   {
+                         PieceInterface *piece = board.getPieceAt(from);
+                         if (!piece)
+                             return;
+                         forEachSquare([&](const Position &to)
+                                       {
+                             checksum += mm.isValidMove(from, to, board, *piece);
+                             ops++; }); });
+                 }
+                 return ops;
+             }},
+            {"MoveManager::isPathClear", corpus + ", every pair of squares on a line",
+             [&](uint64_t &checksum)
+             {
+                 uint64_t ops = 0;
+                 MoveManager mm;
+                 for (GameManager &gm : positions)
+                 {
+                     const Board &board = gm.getBoard();
+                     forEachSquare([&](const Position &from)
+                                   { forEachSquare([&](const Position &to)
+                                                   {
+                         const int cols = std::abs(to.col - from.col);
+                         const int rows = std::abs(to.row - from.row);
+                         if ((cols || rows) && (cols == 0 || rows == 0 || cols == rows))
+                         {
+                             checksum += mm.isPathClear(from, to, board);
+                             ops++;
+                         } }); });
+                 }
+                 return ops;
+             }},
+            {"GameManager::isSquareUnderAttack", corpus + ", every square for both colors",
+             [&](uint64_t &checksum)
+             {
+                 uint64_t ops = 0;
+                 for (GameManager &gm : positions)
+                 {
+                     forEachSquare([&](const Position &square)
+                                   {
+                         checksum += gm.isSquareUnderAttack(square, PieceColor::WHITE);
+                         checksum += gm.isSquareUnderAttack(square, PieceColor::BLACK) << 1;
+                         ops += 2; });
+                 }
+                 return ops;
+             }},
+            {"GameManager::isCheckmate", corpus + ", side to move",
+             [&](uint64_t &checksum)
+             {
+                 for (GameManager &gm : positions)
+                     checksum += gm.isCheckmate(gm.getCurrentTurnColor());
+                 return static_cast<uint64_t>(positions.size());
+             }},
+            {"GameManager::isStalemate", corpus + ", side to move",
+             [&](uint64_t &checksum)
+             {
+                 for (GameManager &gm : positions)
+                     checksum += gm.isStalemate(gm.getCurrentTurnColor());
+                 return static_cast<uint64_t>(positions.size());
+             }},
+            {"SearchBoard::perft", std::to_string(perftBoards.size()) + " perft positions to depth " + std::to_string(perftDepth),
+             [&](uint64_t &checksum)
+             {
+                 uint64_t nodes = 0;
+                 for (SearchBoard &board : perftBoards)
+                     nodes += board.perft(perftDepth);
+                 checksum += nodes;
+                 return nodes;
+             }},
+            {"PgnNotation::writeTurn", gameCorpus + " into a new game file",
+             [&](uint64_t &checksum)
+             {
+                 PgnNotation pgn;
+                 pgn.initNewGame();
+                 writeGame(pgn);
+                 checksum += std::filesystem::file_size(pgn.getFileName());
+                 return static_cast<uint64_t>(game.size());
+             }},
+            {"PgnNotation::parseMovesFromFile", gameCorpus + ", every line of the saved game",
+             [&](uint64_t &checksum)
+             {
+                 for (const std::string &line : savedLines)
+                 {
+                     for (const Move &move : PgnNotation::parseMovesFromFile(line))
+                         checksum += squareIndex(move.from) * 64 + squareIndex(move.to);
+                 }
+                 return static_cast<uint64_t>(savedLines.size());
+             }},
+            {"PgnNotation::loadGame", gameCorpus + " saved game",
+             [&](uint64_t &checksum)
+             {
+                 PgnNotation pgn;
+                 checksum += pgn.loadGame("bench.txt");
+                 return uint64_t{1};
+             }},
+        };
+        std::erase_if(benchmarks, [&filter](const Benchmark &b)
+                      { return b.name.find(filter) == std::string::npos; });
+
+        std::vector<Measurement> results;
+        for (const Benchmark &benchmark : benchmarks)
+        {
+            results.push_back(measure(benchmark, minTime, samples));
+            std::cerr << benchmark.name << ": " << results.back().samples[results.back().samples.size() / 2] << " ns/op\n";
+        }
+
+        fs::current_path(scratch.parent_path());
+        fs::remove_all(scratch);
+
+        if (outputPath.empty())
+            writeJson(std::cout, benchmarks, results, minTime, samples);
+        else
+        {
+            std::ofstream out(outputPath, std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("failed to open " + outputPath);
+            writeJson(out, benchmarks, results, minTime, samples);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <iostream>
+#include <print>
+#include <string>
+#include <vector>
+#include "classes.h"
+#include "analysis.h"
+#include "search.h"
+
+/// @brief multi-pv: what every extra MultiPV line costs over a single line, on positions sampled from a batch of games
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::println("usage: {0} <games dir | archive.cga | file.pgn> [depth] [max lines] [positions]", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        const int depth = argc > 2 ? std::stoi(argv[2]) : 7;
+        const size_t maxLines = argc > 3 ? std::stoul(argv[3]) : 5;
+        const size_t maxPositions = argc > 4 ? std::stoul(argv[4]) : 200;
+
+        // every fifth position of each game, so openings do not dominate
+        std::vector<SearchBoard> positions;
+        PieceFactory factory;
+        GameManager gm(factory);
+        for (const AnalysisJob &job : GameAnalyzer::loadJobs(argv[1]))
+        {
+            try
+            {
+                GameAnalyzer::setupJob(job, gm);
+                const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+                for (size_t ply = 0; ply < plies && positions.size() < maxPositions; ply++)
+                {
+                    gm.replayMove(GameAnalyzer::resolveMove(job, gm, ply));
+                    if (ply % 5 == 4 && gm.evaluateStatus() == GameStatus::ONGOING)
+                        positions.emplace_back(gm);
+                }
+            }
+            catch (const std::exception &)
+            {
+                // positions up to the bad move are still fine
+            }
+            if (positions.size() >= maxPositions)
+                break;
+        }
+        std::println("{0} positions, depth {1}", positions.size(), depth);
+
+        SearchEngine engine;
+        uint64_t baseNodes = 0;
+        double baseSeconds = 0;
+        for (size_t lines = 1; lines <= maxLines; lines++)
+        {
+            uint64_t nodes = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const SearchBoard &board : positions)
+            {
+                engine.clearTable();
+                for (const SearchResult &line : engine.searchMultiPv(board, {depth, 0, {}}, lines))
+                    nodes += line.nodes;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (lines == 1)
+            {
+                baseNodes = nodes;
+                baseSeconds = seconds;
+            }
+            std::println("{0} lines: {1:>10} nodes, {2:.3f} s, x{3:.2f} nodes and x{4:.2f} time of one line, +{5:.0f}% per extra line",
+                         lines, nodes, seconds, static_cast<double>(nodes) / baseNodes, seconds / baseSeconds,
+                         lines > 1 ? 100.0 * (static_cast<double>(nodes) / baseNodes - 1) / (lines - 1) : 0.0);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <chrono>
+#include <iostream>
+#include <print>
+#include <string>
+#include <sys/resource.h>
+#include "pgnstream.h"
+
+/// @brief pgn-scan: streams every game of a PGN file and reports tokenizer throughput
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::println("usage: {0} <file.pgn>", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        PgnStreamReader reader(argv[1]);
+        PgnGameView game;
+        size_t plies = 0;
+        size_t decisive = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        while (reader.nextGame(game))
+        {
+            plies += game.moves.size();
+            if (game.result == "1-0" || game.result == "0-1")
+                decisive++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double megabytes = static_cast<double>(reader.getBytesConsumed()) / (1024.0 * 1024.0);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        std::println("input:      {0} ({1})", argv[1], reader.isMapped() ? "mmap" : "buffered");
+        std::println("games:      {0} ({1} decisive)", reader.getGamesRead(), decisive);
+        std::println("plies:      {0}", plies);
+        std::println("size:       {0:.2f} MB", megabytes);
+        std::println("time:       {0:.3f} s", seconds);
+        std::println("throughput: {0:.0f} games/s, {1:.1f} MB/s",
+                     seconds > 0 ? reader.getGamesRead() / seconds : 0.0,
+                     seconds > 0 ? megabytes / seconds : 0.0);
+        std::println("max rss:    {0} KB", usage.ru_maxrss);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "analysis.h"
+#include "fen.h"
+#include "rules.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief sums every answer, so two ways of answering the same requests can be compared
+    uint64_t checksum(const std::vector<RulesResponse> &responses)
+    {
+        uint64_t sum = 0;
+        for (const RulesResponse &response : responses)
+        {
+            sum = sum * 31 + static_cast<uint64_t>(response.error) * 7 + response.legal * 3 + static_cast<uint64_t>(response.status) +
+                  response.inCheck * 11 + response.moves.size() * 13 + response.fen.size();
+        }
+        return sum;
+    }
+
+    /// @return requests per second answered by one service, batch by batch
+    double runInProcess(const std::vector<RulesRequest> &requests, size_t batchSize, uint64_t &sum)
+    {
+        RulesService service;
+        std::vector<RulesRequest> batch;
+        std::vector<RulesResponse> responses;
+        std::vector<RulesResponse> all;
+        all.reserve(requests.size());
+        auto start = Clock::now();
+        for (size_t first = 0; first < requests.size(); first += batchSize)
+        {
+            batch.assign(requests.begin() + first, requests.begin() + std::min(requests.size(), first + batchSize));
+            service.evaluate(batch, responses);
+            all.insert(all.end(), responses.begin(), responses.end());
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        sum = checksum(all);
+        return requests.size() / seconds;
+    }
+}
+
+/// @brief rules-api: throughput of the stateless rules queries, in process and through the socket server
+int main(int argc, char **argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "--help")
+    {
+        std::println("usage: {0} <games dir | archive.cga | file.pgn> [--positions N] [--batch N] [--clients N]", argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    size_t positionCount = 20000;
+    size_t socketBatch = 256;
+    size_t clients = std::max(1u, std::thread::hardware_concurrency());
+
+    try
+    {
+        for (int i = 2; i + 1 < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if (flag == "--positions")
+                positionCount = std::stoul(value);
+            else if (flag == "--batch")
+                socketBatch = std::max<size_t>(1, std::stoul(value));
+            else if (flag == "--clients")
+                clients = std::max<size_t>(1, std::stoul(value));
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+
+        namespace fs = std::filesystem;
+        const std::string corpusPath = fs::absolute(argv[1]).string();
+        const fs::path scratch = fs::temp_directory_path() / ("chess-rules-api-" + std::to_string(getpid()));
+        fs::create_directories(scratch / "games");
+        fs::current_path(scratch);
+
+        // every position of the corpus asks what a caller keeping its own games would: is the played move legal,
+        // is a made-up one, what is the status, and now and then the move list; then the move is played
+        std::vector<RulesRequest> requests;
+        std::vector<RulesRequest> validations;
+        {
+            PieceFactory factory;
+            GameManager gm(factory);
+            for (const AnalysisJob &job : GameAnalyzer::loadJobs(corpusPath))
+            {
+                try
+                {
+                    GameAnalyzer::setupJob(job, gm);
+                    const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+                    for (size_t ply = 0; ply < plies && validations.size() < positionCount; ply++)
+                    {
+                        Move move = GameAnalyzer::resolveMove(job, gm, ply);
+                        const std::string fen = FenNotation::toFen(gm);
+                        Move madeUp{move.from, Position(static_cast<char>('a' + (move.to.col - 'a' + 3) % 8), (move.to.row + 4) % 8 + 1)};
+                        validations.push_back({RulesQuery::VALIDATE, fen, move});
+                        requests.push_back({RulesQuery::VALIDATE, fen, move});
+                        requests.push_back({RulesQuery::VALIDATE, fen, madeUp});
+                        requests.push_back({RulesQuery::STATUS, fen});
+                        if (ply % 8 == 0)
+                            requests.push_back({RulesQuery::LEGAL_MOVES, fen});
+                        requests.push_back({RulesQuery::PLAY, fen, move});
+                        if (!gm.replayMove(move))
+                            throw std::runtime_error("illegal move");
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    // games that do not replay are left out
+                }
+                if (validations.size() >= positionCount)
+                    break;
+            }
+        }
+        if (validations.empty())
+            throw std::runtime_error("no replayable games in " + corpusPath);
+        std::println("{0} positions, {1} mixed requests", validations.size(), requests.size());
+
+        uint64_t reference = 0;
+        for (size_t batchSize : {size_t{1}, size_t{64}, size_t{4096}})
+        {
+            uint64_t sum = 0;
+            const double rate = runInProcess(requests, batchSize, sum);
+            if (batchSize == 1)
+                reference = sum;
+            std::println("in process, batches of {0:>4}: {1:>9.0f} requests/s{2}", batchSize, rate, sum == reference ? "" : "  ANSWERS DIFFER");
+        }
+        uint64_t validationSum = 0;
+        std::println("in process, validations only: {0:>9.0f} requests/s", runInProcess(validations, 4096, validationSum));
+
+        // every client sends the whole mix in batches on its own connection, so each has a server thread of its own
+        RulesServer server((scratch / "rules.sock").string());
+        std::vector<uint64_t> sums(clients);
+        std::vector<std::thread> threads;
+        std::mutex errorMutex;
+        std::string error;
+        auto start = Clock::now();
+        for (size_t c = 0; c < clients; c++)
+        {
+            threads.emplace_back([&, c]
+                                 {
+                try
+                {
+                    RulesClient client(server.getPath());
+                    std::vector<RulesRequest> batch;
+                    std::vector<RulesResponse> responses;
+                    std::vector<RulesResponse> all;
+                    for (size_t first = 0; first < requests.size(); first += socketBatch)
+                    {
+                        batch.assign(requests.begin() + first, requests.begin() + std::min(requests.size(), first + socketBatch));
+                        client.call(batch, responses);
+                        all.insert(all.end(), responses.begin(), responses.end());
+                    }
+                    sums[c] = checksum(all);
+                }
+                catch (const std::exception &e)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    error = e.what();
+                } });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (!error.empty())
+            throw std::runtime_error(error);
+        const bool same = std::all_of(sums.begin(), sums.end(), [reference](uint64_t sum)
+                                      { return sum == reference; });
+        std::println("socket, {0} clients, batches of {1}: {2:.0f} requests/s, {3:.0f} per client{4}", clients, socketBatch,
+                     clients * requests.size() / seconds, requests.size() / seconds, same ? "" : "  ANSWERS DIFFER");
+
+        fs::current_path(scratch.parent_path());
+        fs::remove_all(scratch);
+        return same ? 0 : 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "analysis.h"
+#include "fen.h"
+#include "journal.h"
+#include "replay.h"
+#include "writer.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief endgames for the mate scenario: mates in one, positions with none, a stalemate trap and a mated king
+    const char *const endgameFens[] = {
+        "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1",
+        "k7/8/1K6/8/8/8/8/7Q w - - 0 1",
+        "7k/8/6K1/8/8/8/8/R7 w - - 0 1",
+        "8/8/8/8/8/5k2/7q/5K2 b - - 0 1",
+        "3k4/8/3K4/8/8/8/8/4R3 w - - 0 1",
+        "8/8/8/8/4k3/8/8/4K2R w K - 0 1",
+        "7k/5Q2/5K2/8/8/8/8/8 w - - 0 1",
+        "8/8/8/8/8/2k5/1q6/K7 w - - 0 1",
+        "4k3/8/4K3/8/8/8/8/1R6 w - - 0 1",
+        "8/6k1/8/5K2/8/8/8/5B1N w - - 0 1",
+        "r5k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+        "8/p7/8/1P6/K7/8/5k2/8 w - - 0 1",
+    };
+
+    struct ScenarioResult
+    {
+        std::string name;
+        /// @brief what one operation is, and so what throughput and latency are per
+        std::string unit;
+        uint64_t operations = 0;
+        double seconds = 0.0;
+        double throughput = 0.0;
+        double p50Us = 0.0;
+        double p99Us = 0.0;
+    };
+
+    struct Scenario
+    {
+        std::string name;
+        std::function<ScenarioResult()> run;
+    };
+
+    /// @brief fills in the summary from the wall time of the whole run and the latency of every operation
+    ScenarioResult summarize(std::string name, std::string unit, Clock::duration wall, std::vector<Clock::duration> &latencies)
+    {
+        ScenarioResult result{std::move(name), std::move(unit), latencies.size()};
+        result.seconds = std::chrono::duration<double>(wall).count();
+        result.throughput = result.seconds > 0 ? result.operations / result.seconds : 0.0;
+        if (!latencies.empty())
+        {
+            std::sort(latencies.begin(), latencies.end());
+            auto at = [&latencies](double q)
+            {
+                return std::chrono::duration<double, std::micro>(latencies[std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))]).count();
+            };
+            result.p50Us = at(0.50);
+            result.p99Us = at(0.99);
+        }
+        return result;
+    }
+
+    void writeJson(std::ostream &out, const std::vector<ScenarioResult> &results)
+    {
+#ifdef __OPTIMIZE__
+        const bool optimized = true;
+#else
+        const bool optimized = false;
+#endif
+        // one scenario per line, which is what readBaseline expects
+        out << "{\n  \"build\": {\"optimized\": " << (optimized ? "true" : "false") << ", \"compiler\": \"" << __VERSION__
+            << "\"},\n  \"scenarios\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const ScenarioResult &r = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"operations\": " << r.operations
+                << ", \"seconds\": " << r.seconds << ", \"throughput\": " << r.throughput << ", \"p50Us\": " << r.p50Us
+                << ", \"p99Us\": " << r.p99Us << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    std::optional<std::string> jsonString(const std::string &line, const std::string &key)
+    {
+        const std::string pattern = "\"" + key + "\": \"";
+        size_t start = line.find(pattern);
+        if (start == std::string::npos)
+            return std::nullopt;
+        start += pattern.size();
+        return line.substr(start, line.find('"', start) - start);
+    }
+
+    std::optional<double> jsonNumber(const std::string &line, const std::string &key)
+    {
+        const std::string pattern = "\"" + key + "\": ";
+        size_t start = line.find(pattern);
+        if (start == std::string::npos)
+            return std::nullopt;
+        return std::stod(line.substr(start + pattern.size()));
+    }
+
+    /// @brief reads a file written by this tool; anything else is not a baseline
+    std::vector<ScenarioResult> readBaseline(const std::string &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("failed to open baseline " + path);
+        std::vector<ScenarioResult> baseline;
+        for (std::string line; std::getline(in, line);)
+        {
+            std::optional<std::string> name = jsonString(line, "name");
+            std::optional<double> throughput = jsonNumber(line, "throughput");
+            std::optional<double> p99 = jsonNumber(line, "p99Us");
+            if (!name || !throughput || !p99)
+                continue;
+            ScenarioResult result;
+            result.name = *name;
+            result.throughput = *throughput;
+            result.p99Us = *p99;
+            baseline.push_back(result);
+        }
+        if (baseline.empty())
+            throw std::runtime_error(path + " holds no scenario results");
+        return baseline;
+    }
+
+    /// @return number of regressions: throughput down or p99 up by more than threshold
+    size_t compare(const std::vector<ScenarioResult> &results, const std::vector<ScenarioResult> &baseline, double threshold)
+    {
+        size_t regressions = 0;
+        std::cerr << "\nscenario            throughput   vs baseline      p99 us  vs baseline\n";
+        for (const ScenarioResult &current : results)
+        {
+            auto old = std::find_if(baseline.begin(), baseline.end(), [&current](const ScenarioResult &b)
+                                    { return b.name == current.name; });
+            std::string name = current.name;
+            name.resize(std::max<size_t>(name.size(), 18), ' ');
+            if (old == baseline.end())
+            {
+                std::cerr << name << "  not in the baseline\n";
+                continue;
+            }
+            const double throughputChange = old->throughput > 0 ? current.throughput / old->throughput - 1 : 0.0;
+            const double p99Change = old->p99Us > 0 ? current.p99Us / old->p99Us - 1 : 0.0;
+            const bool regressed = throughputChange < -threshold || p99Change > threshold;
+            regressions += regressed;
+
+            std::ostringstream line;
+            line.setf(std::ios::fixed);
+            line.precision(1);
+            line.setf(std::ios::showpos);
+            line << name << std::noshowpos << std::setw(10) << current.throughput << "/s" << std::showpos << std::setw(12)
+                 << throughputChange * 100 << '%' << std::noshowpos << std::setw(12) << current.p99Us << std::showpos << std::setw(12)
+                 << p99Change * 100 << '%' << (regressed ? "  REGRESSION" : "");
+            std::cerr << line.str() << '\n';
+        }
+        return regressions;
+    }
+}
+
+/// @brief scenarios: end-to-end runs of replay, persisted play, loading and mate detection, with a regression gate
+int main(int argc, char **argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "--help")
+    {
+        std::cout << "usage: " << argv[0] << " <games dir | archive.cga | file.pgn> [--replay N] [--play N] [--load N] [--mate N]\n"
+                  << "       [--only scenario] [--output file.json] [--baseline file.json] [--threshold 0.10]\n";
+        return argc < 2 ? 1 : 0;
+    }
+
+    size_t replayGames = 10000;
+    size_t playGames = 1000;
+    size_t loadRuns = 200;
+    size_t mateRuns = 20;
+    std::string only;
+    std::string outputPath;
+    std::string baselinePath;
+    double threshold = 0.10;
+    std::filesystem::path scratch;
+
+    try
+    {
+        for (int i = 2; i < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value for " + flag);
+            std::string value = argv[i + 1];
+            if (flag == "--replay")
+                replayGames = std::stoul(value);
+            else if (flag == "--play")
+                playGames = std::stoul(value);
+            else if (flag == "--load")
+                loadRuns = std::stoul(value);
+            else if (flag == "--mate")
+                mateRuns = std::stoul(value);
+            else if (flag == "--only")
+                only = value;
+            else if (flag == "--output")
+                outputPath = std::filesystem::absolute(value).string();
+            else if (flag == "--baseline")
+                baselinePath = std::filesystem::absolute(value).string();
+            else if (flag == "--threshold")
+                threshold = std::stod(value);
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+        std::vector<ScenarioResult> baseline;
+        if (!baselinePath.empty())
+            baseline = readBaseline(baselinePath);
+
+        // the persisted scenarios write game files and a journal under games/, so everything runs in a scratch directory
+        namespace fs = std::filesystem;
+        scratch = fs::temp_directory_path() / ("chess-scenarios-" + std::to_string(getpid()));
+        fs::create_directories(scratch / "games");
+        const std::string corpusPath = fs::absolute(argv[1]).string();
+        fs::current_path(scratch);
+
+        // every game is resolved to coordinate moves once, outside of any timing
+        struct CorpusGame
+        {
+            std::string fen;
+            std::vector<Move> moves;
+        };
+        std::vector<CorpusGame> corpus;
+        {
+            PieceFactory factory;
+            GameManager gm(factory);
+            for (const AnalysisJob &job : GameAnalyzer::loadJobs(corpusPath))
+            {
+                try
+                {
+                    GameAnalyzer::setupJob(job, gm);
+                    CorpusGame game{job.game.getTag("FEN"), {}};
+                    const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+                    for (size_t ply = 0; ply < plies; ply++)
+                    {
+                        game.moves.push_back(GameAnalyzer::resolveMove(job, gm, ply));
+                        if (!gm.replayMove(game.moves.back()))
+                            throw std::runtime_error("illegal move");
+                    }
+                    corpus.push_back(std::move(game));
+                }
+                catch (const std::exception &)
+                {
+                    // games that do not replay are left out, the corpus is what the app could have saved
+                }
+            }
+        }
+        std::vector<const CorpusGame *> standardGames;
+        for (const CorpusGame &game : corpus)
+        {
+            if (game.fen.empty() && !game.moves.empty())
+                standardGames.push_back(&game);
+        }
+        if (standardGames.empty())
+            throw std::runtime_error("no replayable games from the standard position in " + corpusPath);
+        std::cerr << corpus.size() << " replayable games, " << standardGames.size() << " from the standard position\n";
+
+        std::vector<Scenario> scenarios = {
+            {"replay", [&]
+             {
+                 // the load path: stored moves onto a fresh board, status once at the end
+                 PieceFactory factory;
+                 GameManager gm(factory);
+                 std::vector<Clock::duration> latencies;
+                 latencies.reserve(replayGames);
+                 auto start = Clock::now();
+                 for (size_t i = 0; i < replayGames; i++)
+                 {
+                     const CorpusGame &game = corpus[i % corpus.size()];
+                     auto gameStart = Clock::now();
+                     gm.resetGame();
+                     if (!game.fen.empty())
+                         FenNotation::fromFen(gm, game.fen);
+                     if (!GameReplayer::replay(gm, game.moves).ok)
+                         throw std::runtime_error("replay scenario: a corpus game did not replay");
+                     latencies.push_back(Clock::now() - gameStart);
+                 }
+                 return summarize("replay", "game", Clock::now() - start, latencies);
+             }},
+            {"play", [&]
+             {
+                 // the interactive path with persistence on: every move through playMove, its SAN and writeTurn,
+                 // the file content handed to the writer thread, and the result made durable at the end of each game
+                 GameJournal journal;
+                 GameWriter writer(journal);
+                 std::vector<Clock::duration> latencies;
+                 auto start = Clock::now();
+                 for (size_t i = 0; i < playGames; i++)
+                 {
+                     const CorpusGame &game = *standardGames[i % standardGames.size()];
+                     PieceFactory factory;
+                     GameManager gm(factory);
+                     gm.getPgn().setWriter(&writer);
+                     gm.getPgn().initNewGame();
+                     gm.resetGame();
+                     for (const Move &move : game.moves)
+                     {
+                         auto moveStart = Clock::now();
+                         if (!gm.applyMove(move))
+                             throw std::runtime_error("play scenario: a corpus move was refused");
+                         GameStatus status = gm.evaluateStatus();
+                         latencies.push_back(Clock::now() - moveStart);
+                         if (status != GameStatus::ONGOING)
+                             break;
+                     }
+                     std::string result = "*";
+                     if (gm.evaluateStatus() == GameStatus::CHECKMATE)
+                         result = gm.getCurrentTurnColor() == PieceColor::WHITE ? "0-1" : "1-0";
+                     else if (gm.evaluateStatus() != GameStatus::ONGOING)
+                         result = "1/2-1/2";
+                     gm.getPgn().writeResult(result);
+                 }
+                 writer.flush();
+                 return summarize("play", "move", Clock::now() - start, latencies);
+             }},
+            {"load", [&]
+             {
+                 // the longest corpus game saved the way the app saves it, then the app's load path on it
+                 const CorpusGame &longest = **std::max_element(standardGames.begin(), standardGames.end(), [](const CorpusGame *a, const CorpusGame *b)
+                                                                 { return a->moves.size() < b->moves.size(); });
+                 std::string largest;
+                 {
+                     PieceFactory factory;
+                     GameManager gm(factory);
+                     gm.getPgn().initNewGame();
+                     gm.resetGame();
+                     for (const Move &move : longest.moves)
+                         gm.applyMove(move);
+                     largest = fs::path(gm.getPgn().getFileName()).filename().string();
+                 }
+                 for (const auto &entry : fs::directory_iterator("games"))
+                 {
+                     if (entry.path().extension() == ".txt" && entry.file_size() > fs::file_size(fs::path("games") / largest))
+                         largest = entry.path().filename().string();
+                 }
+
+                 std::vector<Clock::duration> latencies;
+                 auto start = Clock::now();
+                 for (size_t run = 0; run < loadRuns; run++)
+                 {
+                     auto loadStart = Clock::now();
+                     PieceFactory factory;
+                     GameManager gm(factory);
+                     if (!gm.getPgn().loadGame(largest))
+                         throw std::runtime_error("load scenario: failed to open " + largest);
+                     gm.setupBoard();
+                     gm.setCurrentTurnColor(PieceColor::WHITE);
+                     GameReplayer replayer(gm);
+                     std::string line;
+                     while (gm.getPgn().readNextLine(line))
+                     {
+                         if (line.empty() || line[0] == '[' || line.starts_with("Result"))
+                             continue;
+                         for (const Move &move : PgnNotation::parseMovesFromFile(line))
+                         {
+                             if (!replayer.play(move))
+                                 throw std::runtime_error("load scenario: " + replayer.finish().error);
+                         }
+                     }
+                     bool whiteHasMoved;
+                     int savedTurn;
+                     if (gm.getPgn().loadTurnState(savedTurn, whiteHasMoved))
+                     {
+                         gm.setFullmoveNumber(savedTurn);
+                         gm.setCurrentTurnColor(whiteHasMoved ? PieceColor::BLACK : PieceColor::WHITE);
+                     }
+                     replayer.finish();
+                     latencies.push_back(Clock::now() - loadStart);
+                 }
+                 return summarize("load", "load", Clock::now() - start, latencies);
+             }},
+            {"mate", [&]
+             {
+                 // every legal move of every endgame is played and the resulting position asked for its status
+                 PieceFactory factory;
+                 GameManager gm(factory);
+                 std::vector<Clock::duration> latencies;
+                 uint64_t mates = 0;
+                 auto start = Clock::now();
+                 for (size_t run = 0; run < mateRuns; run++)
+                 {
+                     for (const char *fen : endgameFens)
+                     {
+                         auto positionStart = Clock::now();
+                         FenNotation::fromFen(gm, fen);
+                         for (const Move &move : gm.generateLegalMoves(gm.getCurrentTurnColor()))
+                         {
+                             FenNotation::fromFen(gm, fen);
+                             gm.replayMove(move);
+                             mates += gm.evaluateStatus() == GameStatus::CHECKMATE;
+                         }
+                         latencies.push_back(Clock::now() - positionStart);
+                     }
+                 }
+                 if (mateRuns && mates == 0)
+                     throw std::runtime_error("mate scenario found no mate, the positions are not what they should be");
+                 return summarize("mate", "position", Clock::now() - start, latencies);
+             }},
+        };
+
+        std::vector<ScenarioResult> results;
+        for (const Scenario &scenario : scenarios)
+        {
+            if (!only.empty() && scenario.name != only)
+                continue;
+            results.push_back(scenario.run());
+            const ScenarioResult &r = results.back();
+            std::cerr << r.name << ": " << r.operations << ' ' << r.unit << "s in " << r.seconds << " s, " << r.throughput << " per s, p50 "
+                      << r.p50Us << " us, p99 " << r.p99Us << " us\n";
+        }
+
+        fs::current_path(scratch.parent_path());
+        fs::remove_all(scratch);
+
+        if (outputPath.empty())
+            writeJson(std::cout, results);
+        else
+        {
+            std::ofstream out(outputPath, std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("failed to open " + outputPath);
+            writeJson(out, results);
+        }
+
+        if (!baseline.empty() && compare(results, baseline, threshold) > 0)
+        {
+            std::cerr << "performance regressed by more than " << threshold * 100 << "% against " << baselinePath << '\n';
+            return 2;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        if (!scratch.empty())
+        {
+            std::error_code ignored;
+            std::filesystem::current_path(scratch.parent_path(), ignored);
+            std::filesystem::remove_all(scratch, ignored);
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// @brief what an allocation was made for, by the innermost ALLOC_SCOPE around it
+enum class AllocSubsystem : uint8_t
+{
+    OTHER,
+    /// @brief playMove and replayMove: board, history and hash updates
+    MOVE,
+    /// @brief evaluateStatus and the legal-move scans behind it
+    STATUS,
+    /// @brief SAN of a move and its check suffix
+    NOTATION,
+    /// @brief PgnNotation building and rewriting the game file
+    PGN,
+    SEARCH,
+    /// @brief writer and journal threads
+    IO,
+    COUNT
+};
+
+struct SubsystemAllocations
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+    /// @brief allocated here and not freed yet, wherever the free happens
+    int64_t liveBytes = 0;
+    int64_t peakLiveBytes = 0;
+};
+
+/// @brief what single moves allocate, measured on the thread that plays them
+struct MoveAllocations
+{
+    uint64_t moves = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t maxAllocations = 0;
+    uint64_t maxBytes = 0;
+};
+
+struct GameMemory
+{
+    std::string name;
+    /// @brief bytes allocated while working on the game and still held
+    int64_t liveBytes = 0;
+    int64_t peakLiveBytes = 0;
+    uint64_t allocations = 0;
+};
+
+struct AllocReport
+{
+    std::array<SubsystemAllocations, static_cast<size_t>(AllocSubsystem::COUNT)> subsystems;
+    MoveAllocations moves;
+    /// @brief games still open
+    std::vector<GameMemory> games;
+    /// @brief games opened and closed again since the last reset
+    uint64_t closedGames = 0;
+    int64_t closedPeakTotal = 0;
+    int64_t closedPeakMax = 0;
+    /// @brief resident set of the whole process
+    uint64_t residentBytes = 0;
+};
+
+/// @brief Opt-in allocation accounting, built in only with -DCHESS_ALLOC_TRACKING=ON.
+/// The global operator new and delete are then replaced by versions that keep a 16-byte header in front of every
+/// block with its size, the subsystem and the game it was allocated for, so a free anywhere is charged back to
+/// both. Subsystems and games are thread-local tags set by the ALLOC_ macros; without the option those expand
+/// to nothing and operator new is the standard one.
+class AllocTracker
+{
+public:
+#ifdef CHESS_ALLOC_TRACKING
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+    /// @brief games that can be open at the same time; further games are not accounted
+    static constexpr size_t maxGames = 1024;
+
+    /// @brief the thread's current tags; each returns the previous one so scopes can restore it
+    static AllocSubsystem exchangeSubsystem(AllocSubsystem subsystem);
+    static uint32_t exchangeGame(uint32_t game);
+    /// @brief allocations and bytes made by the calling thread so far
+    static uint64_t threadAllocations();
+    static uint64_t threadBytes();
+    static void recordMove(uint64_t allocations, uint64_t bytes);
+
+    /// @return tag for exchangeGame, 0 when every slot is taken
+    static uint32_t openGame(const std::string &name);
+    static void closeGame(uint32_t game);
+
+    static AllocReport report();
+    /// @brief zeroes the counters; live bytes and open games are kept, they still describe what is held
+    static void reset();
+    static const char *subsystemName(AllocSubsystem subsystem);
+    static void writeReport(std::ostream &out);
+};
+
+/// @brief charges the allocations of the enclosing block to subsystem
+class AllocScope
+{
+private:
+    AllocSubsystem m_previous;
+
+public:
+    explicit AllocScope(AllocSubsystem subsystem) : m_previous(AllocTracker::exchangeSubsystem(subsystem)) {}
+    ~AllocScope() { AllocTracker::exchangeSubsystem(m_previous); }
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+};
+
+/// @brief counts the enclosing block as one move
+class AllocMoveScope
+{
+private:
+    uint64_t m_allocations;
+    uint64_t m_bytes;
+
+public:
+    AllocMoveScope() : m_allocations(AllocTracker::threadAllocations()), m_bytes(AllocTracker::threadBytes()) {}
+    ~AllocMoveScope()
+    {
+        AllocTracker::recordMove(AllocTracker::threadAllocations() - m_allocations, AllocTracker::threadBytes() - m_bytes);
+    }
+    AllocMoveScope(const AllocMoveScope &) = delete;
+    AllocMoveScope &operator=(const AllocMoveScope &) = delete;
+};
+
+/// @brief opens a game for the lifetime of the object and charges the thread's allocations to it meanwhile
+class AllocGame
+{
+private:
+    uint32_t m_game;
+    uint32_t m_previous;
+
+public:
+    explicit AllocGame(const std::string &name)
+        : m_game(AllocTracker::openGame(name)), m_previous(AllocTracker::exchangeGame(m_game)) {}
+    ~AllocGame()
+    {
+        AllocTracker::exchangeGame(m_previous);
+        AllocTracker::closeGame(m_game);
+    }
+    AllocGame(const AllocGame &) = delete;
+    AllocGame &operator=(const AllocGame &) = delete;
+};
+
+#ifdef CHESS_ALLOC_TRACKING
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_SCOPE(subsystem) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(subsystem)
+#define ALLOC_MOVE_SCOPE() AllocMoveScope ALLOC_CONCAT(allocMoveScope, __LINE__)
+#define ALLOC_GAME(name) AllocGame ALLOC_CONCAT(allocGame, __LINE__)(name)
+#else
+#define ALLOC_SCOPE(subsystem) ((void)0)
+#define ALLOC_MOVE_SCOPE() ((void)0)
+#define ALLOC_GAME(name) ((void)0)
+#endif
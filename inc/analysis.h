@@ -0,0 +1,91 @@
+#pragma once
+#include "classes.h"
+#include "search.h"
+#include "san.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief one game to analyse: moves either as Move (archives, games/ text files) or as SAN in game.moves (PGN)
+struct AnalysisJob
+{
+    std::string name;
+    PgnGame game;
+    std::vector<Move> moves;
+};
+
+/// @brief engine verdict on one ply, as stored in the binary summary
+struct PlySummary
+{
+    /// @brief score after the move from white's point of view, centipawns or a SearchEngine mate score
+    int16_t eval;
+    SearchMove best;
+    SearchMove played;
+    /// @brief centipawns the played move gave away against the best one
+    uint16_t loss;
+};
+static_assert(sizeof(PlySummary) == 8);
+
+struct GameAnalysis
+{
+    bool valid = false;
+    std::string error;
+    /// @brief the game with a [%eval] comment, the best move and the loss after every move
+    PgnGame annotated;
+    std::vector<PlySummary> plies;
+};
+
+struct AnalysisOptions
+{
+    unsigned threads = 1;
+    SearchLimits limits{8, 0, {}};
+    /// @brief lines searched per position; more than one lists the alternatives in every comment
+    size_t multiPv = 1;
+    size_t tableMegabytes = 16;
+};
+
+struct AnalysisStats
+{
+    size_t games = 0;
+    size_t validGames = 0;
+    size_t positions = 0;
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+};
+
+/// @brief Batch analysis of finished games.
+/// Worker threads take whole games off a shared counter; each owns a SearchEngine whose table is cleared per game
+/// and then kept across its plies, so every search starts from what the previous position already found.
+class GameAnalyzer
+{
+private:
+    AnalysisOptions m_options;
+    std::vector<GameAnalysis> m_results;
+
+public:
+    static constexpr char magic[4] = {'C', 'A', 'S', '1'};
+    static constexpr uint32_t version = 1;
+    /// @brief evals are capped here before taking differences, a missed mate is not worth 300 pawns
+    static constexpr int lossCap = 1000;
+
+    explicit GameAnalyzer(AnalysisOptions options) : m_options(options) {}
+
+    /// @brief reads a directory of games/ text files and .pgn files, a .cga archive or a single .pgn file
+    static std::vector<AnalysisJob> loadJobs(const std::string &path);
+    /// @brief sets gm to the position the job's game starts from
+    static void setupJob(const AnalysisJob &job, GameManager &gm);
+    /// @brief the job's move at ply, resolved against gm's position; throws when it is not legal there
+    static Move resolveMove(const AnalysisJob &job, GameManager &gm, size_t ply);
+    /// @brief analyses one game on engine; gm is left at its final position
+    static GameAnalysis analyzeGame(const AnalysisJob &job, SearchEngine &engine, GameManager &gm, const AnalysisOptions &options,
+                                    uint64_t &nodes);
+
+    AnalysisStats run(const std::vector<AnalysisJob> &jobs);
+    const std::vector<GameAnalysis> &getResults() const { return m_results; }
+
+    /// @brief every valid game, annotated, one after another
+    void writePgn(const std::string &path) const;
+    /// @brief header (magic, version, game count, depth), then per game its index, ply count and a PlySummary per ply;
+    /// host byte order like the position index. Invalid games are listed with zero plies.
+    void writeSummary(const std::string &path) const;
+};
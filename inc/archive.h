@@ -0,0 +1,100 @@
+#pragma once
+#include "classes.h"
+#include "pgnstream.h"
+#include "searchboard.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief a game as stored in an archive
+struct ArchivedGame
+{
+    std::string date;
+    GameResult result = GameResult::UNKNOWN;
+    std::vector<Move> moves;
+    /// @brief type of the piece that made each move, filled in when decoding
+    std::vector<PieceType> movers;
+};
+
+/// @brief Binary game archive.
+/// Layout: a 32 byte header (magic, version, game count, offset of the offset table),
+/// the game records back to back, then one little-endian uint64 record offset per game.
+/// A record holds the ply count (varint), the result, the date and every move as its index among
+/// SearchBoard::generateMoves, packed into just enough bits for that position's move count. The list is
+/// pseudo-legal, so decoding a ply is one generation and one makeMove, which also rejects a corrupt index.
+/// Version 1 indexed GameManager::generateLegalMoves instead, which made every ply of a read a full
+/// legality search; such archives have to be packed again.
+class GameArchive
+{
+public:
+    static constexpr char magic[4] = {'C', 'G', 'A', '1'};
+    static constexpr uint32_t version = 2;
+    static constexpr size_t headerSize = 32;
+
+    static GameResult parseResult(std::string_view text);
+    static const char *resultToString(GameResult result);
+
+    /// @brief reads a game saved by PgnNotation in the games/ text format
+    static bool readTextGame(const std::string &path, ArchivedGame &game);
+    /// @brief writes a decoded game back in the games/ text format; needs movers filled in
+    static void writeTextGame(const std::string &path, const ArchivedGame &game);
+};
+
+class GameArchiveWriter
+{
+private:
+    std::ofstream m_out;
+    std::vector<uint64_t> m_offsets;
+    uint64_t m_position = 0;
+    bool m_finished = false;
+    /// @brief only resolves SAN of PGN games; the moves are indexed on m_board
+    PieceFactory m_factory;
+    GameManager m_gm;
+    SearchBoard m_start;
+    SearchBoard m_board;
+    std::vector<SearchMove> m_moves;
+    uint64_t m_plies = 0;
+    std::vector<uint8_t> m_bits;
+    size_t m_bitCount = 0;
+
+    void beginGame();
+    void encodeMove(const Move &move);
+    size_t endGame(GameResult result, std::string_view date);
+
+public:
+    explicit GameArchiveWriter(const std::string &path);
+    ~GameArchiveWriter();
+    GameArchiveWriter(const GameArchiveWriter &) = delete;
+    GameArchiveWriter &operator=(const GameArchiveWriter &) = delete;
+
+    /// @return index of the stored game; throws if a move is illegal
+    size_t addGame(const ArchivedGame &game);
+    /// @brief resolves the SAN of a PGN game and stores it; throws for a move that does not resolve and for a
+    /// game set up from a FEN, since every record starts from the initial position
+    size_t addPgnGame(const PgnGameView &game);
+    size_t getGameCount() const { return m_offsets.size(); }
+    uint64_t getBytesWritten() const { return m_position; }
+    void finish();
+};
+
+class GameArchiveReader
+{
+private:
+    MappedFile m_file;
+    uint64_t m_gameCount = 0;
+    uint64_t m_tableOffset = 0;
+    /// @brief the starting position every game is decoded from
+    SearchBoard m_start;
+
+public:
+    explicit GameArchiveReader(const std::string &path);
+    size_t getGameCount() const { return m_gameCount; }
+    size_t getFileSize() const { return m_file.getView().size(); }
+
+    /// @brief decodes one game on a SearchBoard, without setting up a GameManager
+    void readGame(size_t index, ArchivedGame &game) const;
+    /// @brief decodes one game and replays it on gm, which is left at the game's final position
+    void readGame(size_t index, GameManager &gm, ArchivedGame &game) const;
+};
@@ -33,6 +33,7 @@ public:
     void removePiece(const Position &position);
     void removePiece(const Position &position, bool deletePiece);
     PieceInterface *getPieceAt(const Position &position) const;
+    void clear();
     void displayBoardConsole(PieceColor perspective = PieceColor::WHITE) const;  
 
 private:
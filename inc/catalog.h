@@ -0,0 +1,100 @@
+#pragma once
+#include "classes.h"
+#include "pgnstream.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class GameManager;
+
+/// @brief one catalogued game, stored as is in the catalog file
+struct CatalogEntry
+{
+    uint32_t gameId;
+    uint32_t plies;
+    uint64_t finalHash;
+    /// @brief byte offset of the game inside its file, 0 for the one-game files in games/
+    uint64_t offset;
+    uint8_t result; // GameResult
+    uint8_t reserved[7];
+    /// @brief "YYYY.MM.DD-HH:MM:SS" when the game was started, NUL padded
+    char date[24];
+    /// @brief file name relative to the games directory, NUL padded
+    char name[72];
+
+    GameResult getResult() const { return static_cast<GameResult>(result); }
+    std::string_view getDate() const { return std::string_view(date, strnlen(date, sizeof(date))); }
+    std::string_view getName() const { return std::string_view(name, strnlen(name, sizeof(name))); }
+};
+static_assert(sizeof(CatalogEntry) == 128);
+
+struct CatalogFilter
+{
+    std::optional<GameResult> result;
+    uint32_t minPlies = 0;
+    uint32_t maxPlies = UINT32_MAX;
+    /// @brief inclusive date range compared as prefixes, so "2024" or "2024.05" work too
+    std::string dateFrom;
+    std::string dateTo;
+
+    bool matches(const CatalogEntry &entry) const;
+};
+
+struct CatalogPage
+{
+    std::vector<CatalogEntry> entries;
+    /// @brief games matching the filter over all pages
+    size_t total = 0;
+};
+
+/// @brief Manifest of saved games, so listing them opens no game file.
+/// The file is a 32 byte header followed by fixed size CatalogEntry records in host byte order;
+/// a game saved again under the same name overwrites its record in place.
+/// Opening a catalog adds every game of its directory it does not list yet, such as one left by a killed session.
+class GameCatalog
+{
+private:
+    std::string m_path;
+    mutable std::mutex m_mutex;
+    std::fstream m_file;
+    mutable std::unique_ptr<MappedFile> m_mapped;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    uint32_t m_count = 0;
+
+    std::span<const CatalogEntry> entries() const;
+
+public:
+    static constexpr char magic[4] = {'C', 'G', 'C', '1'};
+    static constexpr size_t headerSize = 32;
+
+    explicit GameCatalog(const std::string &path = "games/catalog.idx");
+
+    /// @brief longest name a record can hold
+    static constexpr size_t maxNameLength = sizeof(CatalogEntry::name) - 1;
+
+    /// @brief adds or updates the record for name; thread safe
+    /// @return the game id, which is its record number
+    /// @throws std::invalid_argument when name is longer than maxNameLength, rather than storing it cut short
+    uint32_t record(const std::string &name, std::string_view date, GameResult result, uint32_t plies,
+                    uint64_t finalHash, uint64_t offset = 0);
+    /// @brief convenience for a game that was just played or replayed on gm
+    uint32_t record(const std::string &name, std::string_view date, GameResult result, const GameManager &gm);
+
+    /// @brief catalogues every .txt game of directory that is not in the catalog yet, by replaying it once;
+    /// games without a move and names too long for a record are left out
+    /// @return number of games added
+    size_t addDirectory(const std::string &directory);
+
+    /// @brief newest games first; page is zero based
+    CatalogPage list(const CatalogFilter &filter, size_t page, size_t pageSize) const;
+    std::optional<CatalogEntry> find(const std::string &name) const;
+    size_t getCount() const;
+};
@@ -3,44 +3,147 @@
 #include <print>
 #include "move.h"
 #include "pgn.h"  
+#include "journal.h"
+#include "writer.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class SpectatorServer;
 
 class GameManager
 {
 private:
     Board m_board;
     PieceColor m_currentTurnColor = PieceColor::WHITE;
+    /// @brief fullmove number, starting at 1 and going up after each black move
+    int m_fullmove = 1;
     PieceFactory &m_factory;
     MoveType m_moveType = MoveType::MOVE;
     PgnNotation m_pgn;  
-    bool m_promotionFlag = false;
+
+    /// @brief every move played since setupBoard, in both coordinate and SAN form
+    std::vector<Move> m_moveHistory;
+    std::vector<std::string> m_sanHistory;
+    /// @brief Zobrist hash of every position reached, starting with the initial one
+    std::vector<uint64_t> m_hashHistory;
+    /// @brief plies since the last capture or pawn move
+    int m_halfmoveClock = 0;
+    /// @brief castling rights still available, bit per right as in Zobrist::castling
+    uint8_t m_castlingRights = 0b1111;
+    /// @brief square the last double pawn push passed over, noSquare after any other move
+    uint8_t m_enPassantSquare = noSquare;
+    /// @brief status and check of the current position, worked out on first use and dropped by the next move
+    std::optional<GameStatus> m_status;
+    std::optional<bool> m_inCheck;
+    /// @brief legal target squares per origin square, filled by one generation pass and dropped with the status
+    std::optional<std::array<uint64_t, 64>> m_destinations;
+    /// @brief FEN the game started from, empty for the standard starting position
+    std::string m_startFen;
+    /// @brief <tag name, value> of the PGN the game was imported from, its result included; empty for games played here
+    std::vector<std::pair<std::string, std::string>> m_tags;
+    /// @brief pieces on the board per color and type, kept up to date by every capture and promotion
+    std::array<std::array<uint8_t, 6>, 2> m_material{};
+    /// @brief bishops per color on light [0] and dark [1] squares
+    std::array<std::array<uint8_t, 2>, 2> m_bishopShades{};
+
+    void countPiece(PieceColor color, PieceType type, const Position &pos, int delta);
+    /// @brief updates castling rights and the en passant square for a move from -> to
+    void updateMoveState(PieceType type, const Position &from, const Position &to);
+    /// @brief counts the material from scratch, for positions that were not reached by moves
+    void recountMaterial();
+    void invalidateStatus()
+    {
+        m_status.reset();
+        m_inCheck.reset();
+        m_destinations.reset();
+    }
 
     bool wouldMoveExposeKingToCheck(const Position &from, const Position &to, PieceColor kingColor);
     bool hasLegalMoves(PieceColor color);  
 
 public:
-    static int turn;
-    bool movePiece(const Position &from, const Position &to, bool isReplay = false);  
+    /// @brief plays a move without any console I/O; a pawn reaching the last rank becomes move.promotion,
+    /// so prompting for it is the front-end's job. isReplay skips the turn and king-safety checks and the PGN file.
+    /// With a writer set, PLAYED means the move is queued, not durable; wait on getPgn().getLastWrite() for that
+    MoveOutcome playMove(const Move &move, bool isReplay = false);
+    /// @brief playMove with every check, as a player's move, unless isReplay says the move is already trusted
+    /// @return whether playMove played the move
+    bool applyMove(const Move &move, bool isReplay = false);
+    /// @brief the piece on from is a pawn and to is on the last rank, so the move needs a promotion piece
+    bool isPromotionMove(const Position &from, const Position &to) const;
+    /// @brief applies a move already known to be legal, with only cheap sanity checks:
+    /// no legality search, no end-of-game detection, no SAN and no console I/O
+    /// @return false when the move cannot belong to this position (no piece, wrong side, own piece on the target)
+    bool replayMove(const Move &move);
 
     GameManager(PieceFactory &factory) : m_factory(factory) {}
     void setupBoard();
+    void resetGame();
+    /// @brief replaces the game with an arbitrary position, without any move history
+    /// @param castlingRights bit per right, numbered as in Zobrist::castling
+    /// @param enPassantFile file of a pawn that can be taken en passant, 0 for none
+    void setupPosition(const std::vector<PlacedPiece> &pieces, PieceColor toMove, int castlingRights,
+                       char enPassantFile, int halfmoveClock, int fullmove);
     void displayBoard() const;
     PieceColor getCurrentTurnColor() const { return m_currentTurnColor; }
-    void setCurrentTurnColor(PieceColor color) { m_currentTurnColor = color; }
+    void setCurrentTurnColor(PieceColor color)
+    {
+        m_currentTurnColor = color;
+        invalidateStatus();
+    }
     bool handleCastling(const Position &from, const Position &to);
-    PieceType handlePromotion(const Position &pos); 
+    bool canCastle(const Position &from, const Position &to) const;
+    /// @brief replaces the pawn on pos with a piece of the given type and its color
+    void promotePawn(const Position &pos, PieceType type);
     bool isSquareUnderAttack(const Position &pos, PieceColor defendingColor) const;
     bool isKingInCheck(PieceColor color) const;
     bool isCheckmate(PieceColor color);
     bool isStalemate(PieceColor color);  
+    /// @brief how the game stands for the side to move; one legal-move pass per position, cached until the next move
+    GameStatus evaluateStatus();
+    /// @brief whether the side to move is in check, cached like evaluateStatus
+    bool isInCheck();
     bool isFirstMove(const PieceInterface *piece);
+    std::vector<Move> generateLegalMoves(PieceColor color);
+    /// @brief where every piece of the side to move can go: bit squareIndex(to) of entry squareIndex(from), promotions once;
+    /// computed in one pass on first use and kept until the position changes, so repeated hints cost a lookup
+    const std::array<uint64_t, 64> &getLegalDestinations();
+    uint64_t getLegalDestinations(const Position &from) { return getLegalDestinations()[squareIndex(from)]; }
+    bool isLegalMove(const Move &move);
+    const std::vector<Move> &getMoveHistory() const { return m_moveHistory; }
+    /// @brief SAN of every move; recomputed here once when moves were added through replayMove
+    const std::vector<std::string> &getSanHistory();
+    const std::vector<uint64_t> &getHashHistory() const { return m_hashHistory; }
+    uint64_t computeHash() const;
+    /// @brief rights still available, bit per right as in Zobrist::castling
+    int getCastlingRights() const { return m_castlingRights; }
+    /// @brief file of the pawn that can be taken en passant right now, 0 for none
+    char getEnPassantFile() const;
+    uint8_t getEnPassantSquare() const { return m_enPassantSquare; }
+    int getHalfmoveClock() const { return m_halfmoveClock; }
+    int getFullmoveNumber() const { return m_fullmove; }
+    void setFullmoveNumber(int fullmove) { m_fullmove = fullmove; }
+    const std::string &getStartFen() const { return m_startFen; }
+    void setStartFen(const std::string &fen) { m_startFen = fen; }
+    const std::vector<std::pair<std::string, std::string>> &getTags() const { return m_tags; }
+    void setTags(std::vector<std::pair<std::string, std::string>> tags) { m_tags = std::move(tags); }
+    uint64_t getPositionHash() const { return m_hashHistory.empty() ? computeHash() : m_hashHistory.back(); }
     PgnNotation& getPgn() { return m_pgn; }  
     std::string promotionTypeToString(PieceType type) const;  
-    void resetPromotionFlag() { m_promotionFlag = false; }
-    bool getPromotionFlag() const { return m_promotionFlag; }
 
+    int getPieceCount(PieceColor color, PieceType type) const
+    {
+        return m_material[static_cast<int>(color)][static_cast<int>(type)];
+    }
+    /// @brief neither side can mate any more: bare kings, a single minor piece, or only bishops all on one square color
     bool hasInsufficientMaterial() const;
     bool hasOnlyKing(PieceColor color) const;
     bool hasOnlyKingAndMinorPiece(PieceColor color) const;
+    bool isFiftyMoveDraw() const { return m_halfmoveClock >= 100; }
+    /// @brief the current position, side to move and rights included, has now been reached three times
+    bool isThreefoldRepetition() const;
 
     const Board& getBoard() const;
 };
@@ -48,9 +151,31 @@ public:
 class Chess
 {
 private:
+    /// @brief declared first so they outlive the game writing through them
+    GameJournal m_journal;
+    GameWriter m_writer{m_journal};
     GameManager m_gm;
+    /// @brief where every move is broadcast to, if anywhere
+    SpectatorServer *m_spectators = nullptr;
+    uint32_t m_spectatorGame = 1;
+
+    /// @brief adds the current game to the position index so it can be found by position later
+    void indexGame(const std::string &name, GameResult result);
+    /// @brief records the current game in the catalog that 'load' lists games from
+    void catalogGame(GameResult result);
+    /// @brief announces and records the result when status ends the game
+    /// @return true when the game is over
+    bool finishGame(GameStatus status);
+    /// @brief asks the player on the console which piece a pawn becomes, until the answer is one of Q, R, B or N
+    static PieceType askPromotion();
 
 public:
     Chess(PieceFactory &factory);
     void run();
+    /// @brief broadcasts the moves of this game to the spectators of game on server
+    void setSpectators(SpectatorServer *server, uint32_t game)
+    {
+        m_spectators = server;
+        m_spectatorGame = game;
+    }
 };
\ No newline at end of file
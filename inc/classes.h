@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 enum class PieceColor
 {
@@ -32,6 +33,39 @@ enum class MoveType
     CASTLE
 };
 
+enum class GameResult
+{
+    UNKNOWN,
+    WHITE_WINS,
+    BLACK_WINS,
+    DRAW
+};
+
+/// @brief how the game stands for the side to move
+enum class GameStatus
+{
+    ONGOING,
+    CHECKMATE,
+    STALEMATE,
+    INSUFFICIENT_MATERIAL,
+    /// @brief 100 plies without a capture or pawn move
+    FIFTY_MOVE_RULE,
+    THREEFOLD_REPETITION
+};
+
+/// @brief what became of a move handed to GameManager::playMove; only PLAYED changes the game
+enum class MoveOutcome
+{
+    PLAYED,
+    NO_PIECE,
+    WRONG_TURN,
+    /// @brief the move would leave or put the mover's own king in check
+    EXPOSES_KING,
+    INVALID,
+    /// @brief a pawn reaches the last rank and the move names no queen, rook, bishop or knight for it
+    PROMOTION_REQUIRED
+};
+
 struct Position
 {
     char col;
@@ -39,6 +73,29 @@ struct Position
     Position(char col, int row) : col(col), row(row) {}
 };
 
+/// @brief compact square numbering for position state: a1 = 0, b1 = 1 ... h8 = 63
+inline uint8_t squareIndex(const Position &position)
+{
+    return static_cast<uint8_t>((position.row - 1) * 8 + (position.col - 'a'));
+}
+constexpr uint8_t noSquare = 0xff;
+
+/// @brief a single move; promotion stays PAWN unless a pawn reaches the last rank
+struct Move
+{
+    Position from;
+    Position to;
+    PieceType promotion = PieceType::PAWN;
+};
+
+/// @brief a piece to put on the board when setting up an arbitrary position
+struct PlacedPiece
+{
+    PieceType type;
+    PieceColor color;
+    Position position;
+};
+
 
 
 #include "piece.h"
@@ -52,5 +109,6 @@ struct Position
 #include "pgn.h"
 #include "factory.h"
 #include "chess.h"
+#include "san.h"
 
 std::ostream &operator<<(std::ostream &os, const PieceColor &color);
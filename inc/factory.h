@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <map>
 #include <list>
 #include <functional>
@@ -8,6 +9,9 @@ class PieceFactory
 {
 private:
     std::list<PieceInterface *> m_pieces;
+    /// @brief released pieces per type and color; a piece only ever changes its position, so setting up
+    /// a position takes them back from here instead of allocating
+    std::array<std::list<PieceInterface *>, 12> m_released;
     std::map<PieceType, std::function<PieceInterface *(const Position &, const PieceColor &)>> m_creators;
 
 public:
@@ -15,4 +19,6 @@ public:
     ~PieceFactory();
     PieceInterface *createAndStorePiece(const PieceType &type, const Position &position, const PieceColor &color);
     const std::list<PieceInterface *> &getPieces() const { return m_pieces; }
+    /// @brief takes every piece off the books; nothing may still point at them, they are handed out again
+    void releasePieces();
 };
@@ -0,0 +1,28 @@
+#pragma once
+#include "classes.h"
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class GameManager;
+
+/// @brief EPD operations in file order: <opcode, operands exactly as written, quotes included>
+using EpdOperations = std::vector<std::pair<std::string, std::string>>;
+
+/// @brief Forsyth-Edwards Notation and Extended Position Description.
+/// Setting a position replaces the whole game state of the GameManager, so no moves have to be replayed to reach it.
+class FenNotation
+{
+public:
+    static constexpr std::string_view startPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    static std::string toFen(const GameManager &gm);
+    /// @brief throws std::invalid_argument when fen is malformed; the clocks may be left out
+    static void fromFen(GameManager &gm, std::string_view fen);
+
+    /// @brief the four position fields followed by the operations, each terminated by ';'
+    static std::string toEpd(const GameManager &gm, const EpdOperations &operations = {});
+    /// @brief sets up the position and returns its operations; hmvc and fmvn set the clocks
+    static EpdOperations fromEpd(GameManager &gm, std::string_view epd);
+};
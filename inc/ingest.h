@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class GameManager;
+class PositionIndex;
+
+struct IngestOptions
+{
+    std::string path;
+    unsigned readers = 1;
+    unsigned parsers = 1;
+    unsigned replayers = 1;
+    size_t chunkSize = 1 << 20;
+    /// @brief capacity of each queue between stages, 0 picks twice the consuming stage's width
+    size_t queueDepth = 0;
+    /// @brief when set, every valid game is added to it as "<path>@<offset>"
+    PositionIndex *positionIndex = nullptr;
+};
+
+/// @brief outcome of replaying one game, keyed by the byte offset where the game starts
+struct IngestRecord
+{
+    size_t offset = 0;
+    uint32_t plies = 0;
+    std::string result;
+    bool valid = false;
+    std::string error;
+};
+
+struct IngestStats
+{
+    size_t bytes = 0;
+    size_t chunks = 0;
+    size_t games = 0;
+    size_t validGames = 0;
+    size_t plies = 0;
+    double seconds = 0.0;
+    /// @brief how often a stage had to wait because the next one was behind
+    size_t readerStalls = 0;
+    size_t parserStalls = 0;
+};
+
+/// @brief Three-stage ingestion of a PGN file: chunked reading, parsing, legality replay plus indexing.
+/// Every stage runs on its own pool of threads and hands work on through a bounded queue,
+/// so a slow stage holds back the faster ones instead of letting work pile up in memory.
+class IngestPipeline
+{
+private:
+    IngestOptions m_options;
+    std::vector<IngestRecord> m_records;
+    std::mutex m_recordsMutex;
+
+public:
+    explicit IngestPipeline(IngestOptions options);
+    IngestStats run();
+    const std::vector<IngestRecord> &getRecords() const { return m_records; }
+    void writeIndex(const std::string &path) const;
+
+    /// @brief replays one game from fen, or from the starting position when fen is empty; on failure error
+    /// names the offending move or the FEN tag
+    static bool replayGame(GameManager &gm, std::string_view fen, const std::vector<std::string_view> &moves,
+                           uint32_t &plies, std::string &error);
+};
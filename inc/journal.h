@@ -0,0 +1,102 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct JournalOptions
+{
+    std::string path = "games/journal.log";
+    /// @brief how long the committer gathers writes before one fsync covers them all
+    std::chrono::microseconds interval{2000};
+    /// @brief a batch this large is committed without waiting out the interval
+    size_t maxBatch = 4096;
+    /// @brief once the journal grows past this, game files are synced and the journal starts over
+    size_t checkpointBytes = 16 << 20;
+};
+
+struct JournalStats
+{
+    uint64_t records = 0;
+    /// @brief group commits, one fsync of the journal each
+    uint64_t commits = 0;
+    uint64_t bytes = 0;
+    uint64_t checkpoints = 0;
+};
+
+/// @brief Group-commit durability for game files.
+/// A write replaces one game file from an offset on, so a move costs the journal its own line and not the
+/// whole game. Writes from all games are appended to a single journal and made durable together by one
+/// fsync per commit interval; only then are the writers acknowledged and the game files updated in place.
+/// The first record of a file after a checkpoint holds the whole file, read back from the synced file when
+/// the write itself starts further in, so recovery never depends on what a crash left in a game file.
+/// Game files are synced lazily at checkpoints, and whatever a crash left in the journal is replayed onto
+/// them when the next journal is opened.
+/// Journal records: uint32 name length, uint32 content length, uint64 offset, uint64 FNV-1a checksum of
+/// offset, name and content, then name and content (host byte order); a torn record at the end is ignored.
+class GameJournal
+{
+private:
+    struct PendingWrite
+    {
+        std::string file;
+        uint64_t offset;
+        std::string content;
+    };
+
+    JournalOptions m_options;
+    int m_fd = -1;
+    uint64_t m_journalBytes = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_pendingReady;
+    std::condition_variable m_durableReady;
+    std::vector<PendingWrite> m_pending;
+    uint64_t m_nextTicket = 1;
+    uint64_t m_durableTicket = 0;
+    bool m_checkpointRequested = false;
+    uint64_t m_checkpointsDone = 0;
+    bool m_stop = false;
+    /// @brief set once a write or sync failed; nothing is acknowledged after that
+    std::string m_error;
+    JournalStats m_stats;
+
+    /// @brief game files journaled since the last checkpoint, so not synced and already whole in the journal;
+    /// only touched by the committer
+    std::set<std::string> m_unsyncedFiles;
+    std::thread m_committer;
+
+    void run();
+    void commit(std::vector<PendingWrite> &batch);
+    void checkpointFiles();
+
+public:
+    explicit GameJournal(JournalOptions options = {});
+    ~GameJournal();
+    GameJournal(const GameJournal &) = delete;
+    GameJournal &operator=(const GameJournal &) = delete;
+
+    /// @brief queues content to replace file from offset on, offset 0 for the whole file; thread safe
+    /// @return ticket to wait on
+    uint64_t submit(const std::string &file, std::string content, uint64_t offset = 0);
+    /// @brief blocks until the write with this ticket, and every one before it, is on disk
+    void waitDurable(uint64_t ticket);
+    /// @brief submit and wait, for callers that must not continue before the write is durable
+    void write(const std::string &file, std::string content, uint64_t offset = 0)
+    {
+        waitDurable(submit(file, std::move(content), offset));
+    }
+
+    /// @brief syncs every game file and empties the journal; blocks until done
+    void checkpoint();
+    JournalStats getStats() const;
+
+    /// @brief replays a journal left behind by a crash onto the game files it records
+    /// @return number of game files restored
+    static size_t recover(const std::string &path);
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include "analysis.h"
+#include "search.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class SpectatorServer;
+
+/// @brief one side of a match: how it searches
+struct EngineConfig
+{
+    std::string name;
+    SearchLimits limits{0, 20000, {}};
+    size_t tableMegabytes = 16;
+};
+
+/// @brief sequential probability ratio test of "B is elo1 stronger than A" against "B is elo0 stronger"
+struct SprtOptions
+{
+    double elo0 = 0.0;
+    double elo1 = 10.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+};
+
+/// @brief search cost of one side over all of its moves
+struct SideStats
+{
+    uint64_t moves = 0;
+    uint64_t nodes = 0;
+    std::chrono::microseconds time{0};
+    std::chrono::microseconds maxMoveTime{0};
+
+    double nodesPerSecond() const { return time.count() ? nodes * 1e6 / time.count() : 0.0; }
+    double microsecondsPerMove() const { return moves ? static_cast<double>(time.count()) / moves : 0.0; }
+    void add(const SideStats &other);
+};
+
+/// @brief one finished game, scored from B's point of view
+struct MatchGame
+{
+    size_t opening = 0;
+    bool bIsWhite = false;
+    GameStatus status = GameStatus::ONGOING;
+    /// @brief 1 B won, 0 draw, -1 B lost
+    int score = 0;
+    size_t plies = 0;
+    SideStats a;
+    SideStats b;
+};
+
+struct MatchStats
+{
+    size_t games = 0;
+    /// @brief from B's point of view
+    size_t wins = 0;
+    size_t draws = 0;
+    size_t losses = 0;
+    double llr = 0.0;
+    double lowerBound = 0.0;
+    double upperBound = 0.0;
+    /// @brief -1 H0 accepted, 1 H1 accepted, 0 still running or out of games
+    int verdict = 0;
+    SideStats a;
+    SideStats b;
+    double seconds = 0.0;
+
+    double eloDifference() const;
+};
+
+struct MatchOptions
+{
+    EngineConfig a;
+    EngineConfig b;
+    /// @brief every opening is played twice, once with each engine as white
+    std::vector<AnalysisJob> openings;
+    size_t maxGames = 1000;
+    unsigned threads = 1;
+    SprtOptions sprt;
+    /// @brief adjudicated as a draw after this many plies
+    size_t maxPlies = 400;
+    /// @brief broadcasts every move, game N of the match as spectator game N
+    SpectatorServer *spectators = nullptr;
+    /// @brief called after every game, with the match lock held
+    std::function<void(const MatchGame &, const MatchStats &)> onGame;
+};
+
+/// @brief Engine-vs-engine match with an SPRT stop.
+/// Worker threads each play one game at a time on their own GameManager, with one SearchEngine per side.
+/// The test is checked after every game; once it accepts a hypothesis no new game is started, and games still
+/// running are dropped so the result only counts games decided before the verdict.
+class MatchRunner
+{
+private:
+    MatchOptions m_options;
+    std::mutex m_mutex;
+    MatchStats m_stats;
+    std::vector<MatchGame> m_games;
+
+    MatchGame playGame(size_t index, GameManager &gm, SearchEngine &engineA, SearchEngine &engineB, const std::atomic<bool> &stop);
+    void updateSprt();
+
+public:
+    explicit MatchRunner(MatchOptions options);
+
+    MatchStats run();
+    const std::vector<MatchGame> &getGames() const { return m_games; }
+
+    /// @brief log-likelihood ratio of the two hypotheses for a win/draw/loss count, normal approximation
+    static double computeLlr(size_t wins, size_t draws, size_t losses, double elo0, double elo1);
+    /// @brief a few common openings as SAN, for when no suite is given
+    static std::vector<AnalysisJob> defaultOpenings();
+    /// @brief .epd/.fen files hold one position per line; anything else is read like game-analyze input
+    /// and every game is cut after plies moves
+    static std::vector<AnalysisJob> loadOpenings(const std::string &path, size_t plies);
+};
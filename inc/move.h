@@ -1,7 +1,7 @@
 #ifndef MOVE_H
 #define MOVE_H
 #include "classes.h"
-#include "pgn.h" 
+#include <cstdint>
 
 class MoveManager
 {
@@ -10,10 +10,11 @@ private:
     MoveType m_moveType=MoveType::MOVE; 
     std::string m_movePrefix;
     std::string m_moveSuffix;
-    const PgnNotation* m_pgn; 
+    /// @brief square a pawn may capture en passant onto, noSquare when the last move was no double push
+    uint8_t m_enPassantSquare;
 
 public:
-    MoveManager(const PgnNotation* pgn) : m_pgn(pgn) {} 
+    explicit MoveManager(uint8_t enPassantSquare = noSquare) : m_enPassantSquare(enPassantSquare) {}
 
     // move validators
     bool isValidMove(const Position &from, const Position &to, const Board &board, const PieceInterface &piece) const;
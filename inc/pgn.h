@@ -10,14 +10,7 @@
 #include <unordered_map>
 #include <set>
 
-struct MoveInfo {
-    PieceType type;
-    int fromRow;
-    int toRow;
-    char fromCol;
-    char toCol;
-    PieceColor color;
-};
+class GameWriter;
 
 class PgnNotation
 {
@@ -27,22 +20,25 @@ private:
     std::string m_fileName;
     std::string m_move;
     std::ofstream m_outFile;
-    std::ifstream m_inFile;
-
-    /// @brief <piece, piece color, last move starting position, last move destination>
-    MoveInfo m_lastMove;
-
-    /// @brief track if the king or rook has moved
-    std::unordered_map<std::string, bool> m_pieceMoved;
-    std::set<std::string> m_originalPositions;  
+    size_t m_readOffset = 0;
 
     std::string m_originalContent; 
+    std::string m_result;
+    /// @brief when set, files are written through it instead of directly
+    GameWriter *m_writer = nullptr;
+    /// @brief content last handed to the writer, which the file holds once it is written; empty when unknown
+    std::string m_written;
+    /// @brief sequence number of the last record handed to the writer, 0 before the first
+    uint64_t m_lastWrite = 0;
     int m_savedTurn;
     bool m_whiteHasMoved;
-    std::string getCurrentDateString() const;  
-    std::string getPieceSymbol(PieceType type);
+    static std::string getPieceSymbol(PieceType type);
+    void rewriteFile(const std::string &content);
+    /// @brief hands the writer only what changed since the last write, the whole file when that is unknown
+    void queueWrite(const std::string &content);
 
 public:
+    std::string getCurrentDateString() const;  
     void setSavedTurn(int turn) { m_savedTurn = turn; }
     void setWhiteHasMoved(bool hasMoved) { m_whiteHasMoved = hasMoved; }
     int getSavedTurn() const { return m_savedTurn; }
@@ -51,39 +47,35 @@ public:
     PgnNotation();
 
     ~PgnNotation();
+    /// @brief creates a new, empty game file named after the current time and returns its path; never one that exists
     std::string assignFileName();
     void openFile(const std::string &fileName);
     void fileHeader();
-    int getCurrentTurn();
     void appendToFile(const std::string &line);
-    void writeTurn(const PieceColor &color, const PieceType &type, const char &fromCol,
+    /// @param fullmove number of the move the owning game is on
+    void writeTurn(int fullmove, const PieceColor &color, const PieceType &type, const char &fromCol,
                    const int &fromRow, const char &toCol, const int &toRow, const std::string &specialMove);
-    MoveInfo getLastMove() const;
-    bool hasPieceMoved(const PieceType &type, const PieceColor &color, const char &col) const;
+    const std::string &getFileName() const { return m_fileName; }
+    /// @brief hands every write of this game to an I/O thread. initNewGame, appendToFile and writeTurn then
+    /// return as soon as the change is queued, before it is durable; writeResult and saveTurnState wait for it
+    void setWriter(GameWriter *writer) { m_writer = writer; }
+    /// @brief sequence number of the latest write, for GameWriter::waitFor to acknowledge a move once it is on
+    /// disk; 0 without a writer, which waits for nothing since those writes are done on return
+    uint64_t getLastWrite() const { return m_lastWrite; }
+    const std::string &getResult() const { return m_result; }
     std::string promotionTypeToString(PieceType type) const;  
     bool loadGame(const std::string& filename);
-    std::vector<std::pair<Position, Position>> parseMovesFromFile(const std::string& line);  
-    static std::vector<std::string> listSavedGames();
+    static std::vector<Move> parseMovesFromFile(const std::string& line);  
+    static std::string formatMove(PieceType type, const Move &move);
+    static std::vector<std::string> listSavedGames(const std::string &extension = ".txt");
     bool readNextLine(std::string& line);
     void skipLine();
     void writeResult(const std::string& result);  
     void initNewGame();  
-    void saveTurnState(int turn, bool whiteHasMoved);  
+    /// @param castlingRights rights still available, bit per right as in Zobrist::castling
+    void saveTurnState(int turn, bool whiteHasMoved, int castlingRights = 0b1111);
     bool loadTurnState(int& turn, bool& whiteHasMoved) const;  
     bool hasIncompleteTurn() const;  
-    void markPieceMoved(PieceType type, PieceColor color, char col, bool isReplay = false); 
-    void clearPieceMovementHistory();
-    void initializeOriginalPositions() {
-        // those are flags for tagging that kings or rooks moved from their starting positions
-        // it's for castling
-        m_originalPositions.clear();
-        m_originalPositions.insert("e0"); // White king
-        m_originalPositions.insert("e1"); // Black king
-        m_originalPositions.insert("a0"); // White queenside rook
-        m_originalPositions.insert("h0"); // White kingside rook
-        m_originalPositions.insert("a1"); // Black queenside rook
-        m_originalPositions.insert("h1"); // Black kingside rook
-    }
 };
 
 #endif
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+enum class PgnTokenType
+{
+    TAG,
+    COMMENT,
+    VARIATION,
+    NAG,
+    MOVE_NUMBER,
+    SAN,
+    RESULT,
+    END
+};
+
+/// @brief a slice of PGN text; for TAG, text is the tag name and value the raw (still escaped) value
+struct PgnToken
+{
+    PgnTokenType type = PgnTokenType::END;
+    std::string_view text;
+    std::string_view value;
+};
+
+/// @brief splits PGN text into tokens without copying it
+class PgnTokenizer
+{
+private:
+    std::string_view m_text;
+    size_t m_pos = 0;
+
+public:
+    explicit PgnTokenizer(std::string_view text) : m_text(text) {}
+    bool next(PgnToken &token);
+    size_t getPosition() const { return m_pos; }
+    void setPosition(size_t pos) { m_pos = pos; }
+};
+
+/// @brief one game as slices of the reader's buffer, valid until the next call to nextGame
+struct PgnGameView
+{
+    std::vector<std::pair<std::string_view, std::string_view>> tags;
+    std::vector<std::string_view> moves;
+    std::string_view result;
+    std::string_view text;
+
+    void clear();
+    std::string_view getTag(std::string_view name) const;
+};
+
+/// @brief scans the next game off tokenizer; complete is false when the text ran out mid-game
+bool scanPgnGame(PgnTokenizer &tokenizer, PgnGameView &game, bool &complete);
+
+/// @brief offset of the first game starting at or after pos, data.size() when there is none;
+/// a game starts at a tag line that follows a blank line
+size_t findPgnGameStart(std::string_view data, size_t pos);
+
+/// @brief read-only mapping of a whole file; anything that is not a non-empty regular file stays unmapped
+class MappedFile
+{
+private:
+    int m_fd = -1;
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    int getDescriptor() const { return m_fd; }
+    bool isMapped() const { return m_data != nullptr; }
+    std::string_view getView() const { return std::string_view(m_data, m_size); }
+
+    void adviseSequential() const;
+    void prefetch(size_t offset, size_t length) const;
+    void release(size_t offset, size_t length) const;
+};
+
+/// @brief Streams games out of a PGN file one at a time.
+/// Regular files are memory mapped, anything else is read through a sliding buffer,
+/// so memory stays bounded by the largest single game rather than the file size.
+class PgnStreamReader
+{
+private:
+    MappedFile m_file;
+    size_t m_releasedUpTo = 0;
+
+    std::string m_buffer;
+    size_t m_offset = 0;
+    bool m_eof = false;
+    size_t m_bytesConsumed = 0;
+    size_t m_gamesRead = 0;
+
+    std::string_view window() const;
+    bool refill();
+    void releaseConsumedPages();
+
+public:
+    static constexpr size_t chunkSize = 4 << 20;
+
+    explicit PgnStreamReader(const std::string &path);
+
+    bool nextGame(PgnGameView &game);
+    size_t getBytesConsumed() const { return m_bytesConsumed; }
+    size_t getGamesRead() const { return m_gamesRead; }
+    bool isMapped() const { return m_file.isMapped(); }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include "classes.h"
+#include "pgnstream.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class GameManager;
+
+/// @brief one position of one game; nextMove is the move played from it (noMove at the end of the game)
+struct PositionEntry
+{
+    uint64_t hash;
+    uint32_t gameId;
+    uint16_t ply;
+    uint16_t nextMove;
+};
+static_assert(sizeof(PositionEntry) == 16);
+
+/// @brief how often a move was played from a position, and how those games ended
+struct ExplorerLine
+{
+    uint16_t move = 0;
+    size_t games = 0;
+    size_t whiteWins = 0;
+    size_t draws = 0;
+    size_t blackWins = 0;
+};
+
+struct IndexedGame
+{
+    std::string name;
+    GameResult result = GameResult::UNKNOWN;
+    /// @brief false once the same name was indexed again; its entries are skipped and dropped by compact()
+    bool live = false;
+};
+
+/// @brief On-disk index from Zobrist position hash to (game, ply), kept in a directory:
+/// positions.<n>.idx - sorted runs: a header followed by entries sorted by hash, memory mapped for lookups
+/// positions.log     - entries appended since the last run was written, in the order they were added
+/// games.tsv         - "id<TAB>result<TAB>name" per indexed game; a repeated name supersedes the older id
+/// A full log becomes a new run, and the newest runs are merged whenever the last is at least half the size
+/// of the one before it, so every entry is rewritten only a logarithmic number of times.
+/// Entries are stored in host byte order, the index is not meant to move between machines.
+class PositionIndex
+{
+private:
+    struct SortedRun
+    {
+        /// @brief n of positions.<n>.idx, 0 for the positions.idx of older indexes; newer runs have larger ids
+        uint64_t id;
+        std::unique_ptr<MappedFile> file;
+
+        std::span<const PositionEntry> entries() const;
+    };
+
+    std::string m_directory;
+    mutable std::mutex m_mutex;
+
+    std::vector<SortedRun> m_runs;
+    uint64_t m_nextRun = 1;
+    /// @brief entries of the log; only the first m_sortedPending are in order, the rest are sorted in by the
+    /// next lookup, so adding a game never has to touch the ones before it
+    mutable std::vector<PositionEntry> m_pending;
+    mutable size_t m_sortedPending = 0;
+    std::ofstream m_log;
+    std::ofstream m_gameList;
+
+    std::vector<IndexedGame> m_games;
+    std::unordered_map<std::string, uint32_t> m_gameIds;
+
+    void load();
+    std::string path(const char *file) const { return m_directory + "/" + file; }
+    std::string runPath(uint64_t id) const;
+    void sortPendingLocked() const;
+    std::vector<PositionEntry> findLocked(uint64_t hash) const;
+    /// @brief merges sources into a new file for run id, leaving out superseded games and duplicates
+    SortedRun writeRun(uint64_t id, const std::vector<std::span<const PositionEntry>> &sources) const;
+    /// @brief writes the log as a new run and merges the newest runs while they are of similar size
+    void flushPendingLocked();
+    /// @brief replaces the runs from first on with one run holding all their entries
+    void mergeRunsLocked(size_t first);
+    void resetLogLocked();
+
+public:
+    static constexpr char magic[4] = {'C', 'P', 'I', '1'};
+    static constexpr size_t headerSize = 16;
+    static constexpr uint16_t noMove = 0xffff;
+    /// @brief the log is written out as a new run once it holds this many entries
+    static constexpr size_t compactThreshold = 1 << 20;
+
+    explicit PositionIndex(const std::string &directory = "games/index");
+
+    /// @brief indexes every position gm went through since setupBoard; thread safe
+    /// @return id of the indexed game
+    uint32_t addGame(const std::string &name, GameResult result, const GameManager &gm);
+
+    /// @brief every live game that reached the position, ordered by game id and ply
+    std::vector<PositionEntry> find(uint64_t hash) const;
+    /// @brief opening explorer view of a position, most played move first
+    std::vector<ExplorerLine> explore(uint64_t hash) const;
+    std::optional<IndexedGame> getGame(uint32_t id) const;
+
+    /// @brief merges every run and the log into one run with superseded games dropped
+    void compact();
+
+    size_t getGameCount() const;
+    size_t getEntryCount() const;
+
+    static uint16_t packMove(const Move &move);
+    static Move unpackMove(uint16_t packed);
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include "analysis.h"
+#include "search.h"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/// @brief a position with exactly one winning move, and the line that follows it
+struct Puzzle
+{
+    /// @brief EPD of the position with bm, pv, ce and id operations, as test suites store them
+    std::string epd;
+    uint64_t hash = 0;
+    std::string game;
+    size_t gameIndex = 0;
+    /// @brief ply of the game at which the position arose
+    size_t ply = 0;
+    int score = 0;
+    /// @brief score of the best other move
+    int secondScore = 0;
+    std::vector<std::string> solution;
+};
+
+struct PuzzleOptions
+{
+    unsigned threads = 1;
+    /// @brief cheap search every position gets; a candidate is where it sees the side to move gain swing centipawns
+    SearchLimits filter{3, 0, {}};
+    int swing = 200;
+    /// @brief search that confirms a candidate, once for the best move and once for the best of the rest
+    SearchLimits verify{8, 0, {}};
+    /// @brief the best move has to reach this, and no other move may get within uniqueGap of it or reach win / 2
+    int win = 250;
+    int uniqueGap = 200;
+    /// @brief longest solution kept, in plies; it always ends on a move of the solving side
+    size_t maxSolution = 7;
+    size_t tableMegabytes = 16;
+};
+
+struct PuzzleStats
+{
+    size_t games = 0;
+    size_t positions = 0;
+    /// @brief positions that passed the eval-swing filter
+    size_t candidates = 0;
+    /// @brief candidates skipped because the same position was already verified
+    size_t duplicates = 0;
+    size_t puzzles = 0;
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+};
+
+/// @brief Mines tactics out of finished games.
+/// Every position gets a shallow search; only where the side to move suddenly stands much better, i.e. the
+/// opponent just blundered, does a deep search check that one move wins and every other one does not.
+/// Positions are deduplicated by Zobrist hash across all games and threads before that expensive step.
+class PuzzleMiner
+{
+private:
+    PuzzleOptions m_options;
+    std::vector<Puzzle> m_puzzles;
+    std::mutex m_mutex;
+    std::unordered_set<uint64_t> m_seen;
+
+    /// @brief false when another game already claimed the position
+    bool claim(uint64_t hash);
+    void mineGame(const AnalysisJob &job, size_t gameIndex, SearchEngine &engine, GameManager &gm, PuzzleStats &stats);
+    std::optional<Puzzle> verify(GameManager &gm, const SearchBoard &board, SearchEngine &engine, uint64_t &nodes) const;
+
+public:
+    explicit PuzzleMiner(PuzzleOptions options) : m_options(options) {}
+
+    PuzzleStats run(const std::vector<AnalysisJob> &jobs);
+    /// @brief puzzles in the order of the games and plies they came from
+    const std::vector<Puzzle> &getPuzzles() const { return m_puzzles; }
+    /// @brief one EPD line per puzzle
+    void writeEpd(const std::string &path) const;
+};
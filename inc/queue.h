@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/// @brief Blocking FIFO with a fixed capacity shared by several producers and consumers.
+/// push waits while the queue is full, which is how a slow stage throttles the ones before it.
+template <typename T>
+class BoundedQueue
+{
+private:
+    std::deque<T> m_items;
+    size_t m_capacity;
+    size_t m_producers;
+    size_t m_fullWaits = 0;
+    bool m_closed = false;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+
+public:
+    BoundedQueue(size_t capacity, size_t producers = 1)
+        : m_capacity(capacity == 0 ? 1 : capacity), m_producers(producers) {}
+
+    /// @return false when the queue was closed and the item was dropped
+    bool push(T item)
+    {
+        std::unique_lock lock(m_mutex);
+        if (m_items.size() >= m_capacity && !m_closed)
+        {
+            m_fullWaits++;
+            m_notFull.wait(lock, [this] { return m_items.size() < m_capacity || m_closed; });
+        }
+        if (m_closed)
+            return false;
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// @return nullopt once every producer is done and the queue is drained
+    std::optional<T> pop()
+    {
+        std::unique_lock lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed || m_producers == 0; });
+        if (m_items.empty())
+            return std::nullopt;
+        T item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return item;
+    }
+
+    /// @brief called once by every producer; the last one wakes the consumers up for good
+    void producerDone()
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_producers > 0 && --m_producers == 0)
+            m_notEmpty.notify_all();
+    }
+
+    /// @brief stops the queue early, pending and future pushes are dropped
+    void close()
+    {
+        std::lock_guard lock(m_mutex);
+        m_closed = true;
+        m_items.clear();
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+    size_t getFullWaits() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_fullWaits;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_items.size();
+    }
+};
+
+/// @brief Lock-free ring for exactly one producer and one consumer thread.
+/// Neither side takes a lock: each owns one index and only reads the other's, so a push is a move into a slot
+/// plus one release store. Both sides can sleep on the other's index through std::atomic::wait when they run dry.
+template <typename T>
+class SpscRing
+{
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    /// @brief next slot to read, written by the consumer only
+    alignas(64) std::atomic<size_t> m_head{0};
+    /// @brief next slot to write, written by the producer only
+    alignas(64) std::atomic<size_t> m_tail{0};
+
+public:
+    /// @brief capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+        : m_slots(std::bit_ceil(capacity < 2 ? size_t{2} : capacity)), m_mask(m_slots.size() - 1) {}
+
+    /// @brief producer only
+    /// @return false when the ring is full, item is left untouched then
+    bool tryPush(T &item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+            return false;
+        m_slots[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+        return true;
+    }
+
+    /// @brief producer only; sleeps while the ring is full
+    /// @return true when it had to wait
+    bool push(T item)
+    {
+        bool waited = false;
+        while (!tryPush(item))
+        {
+            waited = true;
+            size_t head = m_head.load(std::memory_order_acquire);
+            if (m_tail.load(std::memory_order_relaxed) - head == m_slots.size())
+                m_head.wait(head, std::memory_order_acquire);
+        }
+        return waited;
+    }
+
+    /// @brief consumer only
+    bool tryPop(T &item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        m_head.notify_one();
+        return true;
+    }
+
+    /// @brief consumer only; sleeps until the ring holds at least one item
+    void waitForItems() const
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        m_tail.wait(head, std::memory_order_acquire);
+    }
+
+    /// @brief exact from either side, a snapshot from anywhere else
+    size_t size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+    size_t capacity() const { return m_slots.size(); }
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include "classes.h"
+#include <string>
+#include <vector>
+
+class GameManager;
+
+enum class ReplayMode
+{
+    /// @brief moves come from a source that already checked them: saved games, archives, resolved SAN
+    TRUSTED,
+    /// @brief every move is checked against the legal moves of the position first
+    VALIDATED
+};
+
+struct ReplayOutcome
+{
+    size_t plies = 0;
+    bool ok = true;
+    /// @brief names the offending ply when ok is false
+    std::string error;
+    /// @brief how the final position stands, evaluated once by finish()
+    GameStatus status = GameStatus::ONGOING;
+};
+
+/// @brief Replays stored moves onto a GameManager without the interactive move path:
+/// no per-ply check or mate detection, no SAN and never a promotion prompt.
+/// End-of-game detection runs once, on the final position.
+class GameReplayer
+{
+private:
+    GameManager &m_gm;
+    ReplayMode m_mode;
+    ReplayOutcome m_outcome;
+
+public:
+    explicit GameReplayer(GameManager &gm, ReplayMode mode = ReplayMode::TRUSTED) : m_gm(gm), m_mode(mode) {}
+
+    /// @brief plays the move from the current position; after the first failure every further move is refused
+    bool play(const Move &move);
+    const ReplayOutcome &finish();
+
+    /// @brief plays moves from gm's current position and evaluates the result
+    static ReplayOutcome replay(GameManager &gm, const std::vector<Move> &moves, ReplayMode mode = ReplayMode::TRUSTED);
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "chess.h"
+#include "factory.h"
+
+/// @brief what a request asks about its position
+enum class RulesQuery : uint8_t
+{
+    /// @brief whether the move is legal
+    VALIDATE,
+    /// @brief legality, then the FEN and status after the move
+    PLAY,
+    /// @brief status of the position and whether the side to move is in check
+    STATUS,
+    LEGAL_MOVES
+};
+
+enum class RulesError : uint8_t
+{
+    NONE,
+    BAD_FEN,
+    /// @brief a square off the board, an unknown query or a promotion piece that is not Q, R, B or N
+    BAD_REQUEST
+};
+
+struct RulesRequest
+{
+    RulesQuery query = RulesQuery::STATUS;
+    std::string fen;
+    /// @brief for VALIDATE and PLAY; a pawn reaching the last rank needs its promotion piece
+    Move move{Position('a', 1), Position('a', 1)};
+};
+
+struct RulesResponse
+{
+    RulesError error = RulesError::NONE;
+    bool legal = false;
+    /// @brief of the position, or of the one after the move for PLAY
+    GameStatus status = GameStatus::ONGOING;
+    bool inCheck = false;
+    /// @brief LEGAL_MOVES only
+    std::vector<Move> moves;
+    /// @brief PLAY of a legal move only
+    std::string fen;
+};
+
+/// @brief Stateless rules queries for callers that keep their own positions.
+/// Every request carries its FEN; a batch is answered on one reused board, and consecutive requests on the
+/// same FEN set it up only once, so a caller validating many moves of a position pays for parsing once.
+/// Not thread safe: one service per thread, as with GameManager.
+///
+/// The wire format, in host byte order like the journal, is a frame of uint32 payload length followed by the
+/// payload. A request payload is uint32 count, then per request: uint8 query, uint8 FEN length, the FEN, and for
+/// VALIDATE and PLAY uint8 from square, uint8 to square (a1 = 0 ... h8 = 63) and the promotion piece as
+/// 'q', 'r', 'b', 'n' or 0. A response payload is uint32 count, then per response: uint8 error, uint8 legal,
+/// uint8 status, uint8 in check, and for LEGAL_MOVES a uint16 count of 3-byte moves, for a legal PLAY a uint8
+/// FEN length and the FEN.
+class RulesService
+{
+private:
+    PieceFactory m_factory;
+    GameManager m_gm{m_factory};
+    /// @brief FEN the board holds right now, empty when a move has been played on it since
+    std::string m_position;
+    /// @brief decoded batch of the wire entry point, kept for its buffers
+    std::vector<RulesRequest> m_requests;
+    std::vector<RulesResponse> m_responses;
+
+    void answer(const RulesRequest &request, RulesResponse &response);
+    /// @return false when the FEN does not describe a position
+    bool load(std::string_view fen);
+
+public:
+    RulesService() = default;
+    RulesService(const RulesService &) = delete;
+    RulesService &operator=(const RulesService &) = delete;
+
+    /// @brief answers every request of the batch, in order, into responses; reusing responses across
+    /// calls keeps their buffers
+    void evaluate(const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses);
+    std::vector<RulesResponse> evaluate(const std::vector<RulesRequest> &requests);
+    /// @brief answers a request payload with a response payload, both without the length prefix
+    void evaluate(std::string_view requestPayload, std::string &responsePayload);
+
+    static void encodeRequests(const std::vector<RulesRequest> &requests, std::string &payload);
+    /// @throws std::invalid_argument on a truncated payload
+    static void decodeRequests(std::string_view payload, std::vector<RulesRequest> &requests);
+    static void encodeResponses(const std::vector<RulesRequest> &requests, const std::vector<RulesResponse> &responses, std::string &payload);
+    static void decodeResponses(std::string_view payload, const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses);
+};
+
+/// @brief RulesService on a Unix domain socket.
+/// Each connection gets a thread with a service of its own and is answered frame by frame, so concurrent
+/// clients use as many cores as they are; a frame that cannot be decoded closes its connection.
+class RulesServer
+{
+private:
+    struct Connection
+    {
+        int fd;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    std::string m_path;
+    int m_listenFd = -1;
+    std::atomic<bool> m_stop{false};
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    std::thread m_acceptor;
+
+    void acceptLoop();
+    static void serve(int fd);
+
+public:
+    /// @brief largest payload accepted, either way
+    static constexpr uint32_t maxPayload = 64 << 20;
+
+    explicit RulesServer(std::string path);
+    /// @brief closes every connection and waits for their threads
+    ~RulesServer();
+    RulesServer(const RulesServer &) = delete;
+    RulesServer &operator=(const RulesServer &) = delete;
+
+    const std::string &getPath() const { return m_path; }
+};
+
+/// @brief blocking client of a RulesServer, one batch in flight at a time
+class RulesClient
+{
+private:
+    int m_fd = -1;
+    std::string m_buffer;
+
+public:
+    explicit RulesClient(const std::string &path);
+    ~RulesClient();
+    RulesClient(const RulesClient &) = delete;
+    RulesClient &operator=(const RulesClient &) = delete;
+
+    void call(const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses);
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include "classes.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <utility>
+
+class GameManager;
+
+/// @brief one move of a PGN game together with the comment and variations that follow it
+struct PgnMove
+{
+    std::string san;
+    std::string comment;
+    std::vector<std::string> variations;
+};
+
+/// @brief a single game in standard PGN form
+struct PgnGame
+{
+    /// @brief <tag name, value> in file order
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<PgnMove> moves;
+    std::string comment; // comment placed before the first move
+    std::string result = "*";
+
+    std::string getTag(const std::string &name) const;
+    void setTag(const std::string &name, const std::string &value);
+};
+
+/// @brief Standard Algebraic Notation and PGN reading/writing.
+/// SAN is always resolved against the legal moves of the GameManager's current position,
+/// so the position has to be the one right before the move.
+class SanNotation
+{
+public:
+    static std::string toSan(GameManager &gm, const Move &move);
+    static std::string checkSuffix(GameManager &gm);
+    static std::optional<Move> fromSan(GameManager &gm, std::string_view san);
+
+    /// @brief parses the next game from text and advances text past it
+    /// @return false when no further game is found
+    static bool parseGame(std::string_view &text, PgnGame &game);
+    static std::string writeGame(const PgnGame &game);
+
+    /// @brief replays game on gm, starting from its FEN tag when it has one
+    static void importGame(GameManager &gm, const PgnGame &game, bool isReplay = true);
+    static void importMoves(GameManager &gm, const std::vector<std::string_view> &moves, bool isReplay = true);
+    static PgnGame exportGame(GameManager &gm);
+
+    static bool readPgnFile(const std::string &path, PgnGame &game);
+    static void writePgnFile(const std::string &path, const PgnGame &game);
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "classes.h"
+#include "searchboard.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+class GameManager;
+
+/// @brief when to stop searching; zero means no limit, at least depth 1 is always finished
+struct SearchLimits
+{
+    int depth = 0;
+    uint64_t nodes = 0;
+    std::chrono::milliseconds time{0};
+};
+
+struct SearchResult
+{
+    /// @brief empty when the side to move has no legal move
+    std::optional<Move> bestMove;
+    /// @brief centipawns from the side to move's point of view, or a mate score (see isMateScore)
+    int score = 0;
+    /// @brief last fully searched depth
+    int depth = 0;
+    uint64_t nodes = 0;
+    std::vector<Move> pv;
+};
+
+/// @brief Fixed-size hash table of search results, replaced by depth and age.
+/// Entries survive between searches, so searching the positions of one game in order reuses what the previous
+/// position found; clear() between unrelated games.
+class TranspositionTable
+{
+public:
+    enum Bound : uint8_t
+    {
+        NONE = 0,
+        EXACT = 1,
+        LOWER = 2,
+        UPPER = 3
+    };
+
+    struct Entry
+    {
+        uint64_t key = 0;
+        SearchMove move = SearchBoard::noMove;
+        int16_t score = 0;
+        int8_t depth = 0;
+        Bound bound = NONE;
+        uint8_t age = 0;
+    };
+    static_assert(sizeof(Entry) == 16);
+
+private:
+    std::vector<Entry> m_entries;
+    uint8_t m_age = 0;
+
+public:
+    explicit TranspositionTable(size_t megabytes = 16);
+
+    void clear();
+    /// @brief marks older entries as replaceable, called at the start of every search
+    void newSearch() { m_age++; }
+    const Entry *probe(uint64_t key) const;
+    void store(uint64_t key, SearchMove move, int score, int depth, Bound bound);
+    size_t getSize() const { return m_entries.size(); }
+};
+
+/// @brief Alpha-beta engine on SearchBoard: iterative deepening, principal variation search, quiescence search on
+/// captures, and move ordering by hash move, MVV-LVA, killers and history. Scores are in centipawns from the side
+/// to move's point of view. One engine per thread; the table belongs to the engine.
+class SearchEngine
+{
+public:
+    static constexpr int infinity = 32000;
+    static constexpr int mateScore = 31000;
+    static constexpr int maxPly = 128;
+
+private:
+    TranspositionTable m_table;
+    SearchBoard m_board;
+    SearchLimits m_limits;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_nodes = 0;
+    int m_completedDepth = 0;
+    bool m_stopped = false;
+    const std::atomic<bool> *m_stopFlag = nullptr;
+    /// @brief a move of the root position with what the last depth found below it
+    struct RootMove
+    {
+        SearchMove move;
+        int score;
+        /// @brief false when the move was only shown to be worse than the lines kept
+        bool exact;
+        std::vector<SearchMove> pv;
+        uint64_t nodes;
+    };
+
+    SearchMove m_killers[maxPly][2] = {};
+    int m_history[2][64][64] = {};
+    /// @brief triangular principal variation table
+    SearchMove m_pv[maxPly][maxPly] = {};
+    int m_pvLength[maxPly] = {};
+    /// @brief move list per ply, kept so the search does not allocate once it is warm
+    std::vector<SearchMove> m_moves[maxPly];
+
+    bool shouldStop();
+    int search(int depth, int alpha, int beta, int ply);
+    int quiescence(int alpha, int beta, int ply);
+    int scoreMove(SearchMove move, SearchMove hashMove, int ply) const;
+    std::vector<SearchResult> searchLines(const SearchBoard &board, const SearchLimits &limits, size_t lines,
+                                          const std::vector<SearchMove> &excluded);
+    void orderMoves(std::vector<SearchMove> &moves, SearchMove hashMove, int ply) const;
+
+public:
+    explicit SearchEngine(size_t tableMegabytes = 16) : m_table(tableMegabytes) {}
+
+    /// @brief searches the current position of gm, taking over its hash history for repetitions
+    SearchResult search(const GameManager &gm, const SearchLimits &limits);
+    SearchResult search(const SearchBoard &board, const SearchLimits &limits);
+    /// @brief best line without the excluded root moves; bestMove is empty when no other legal move is left
+    SearchResult search(const SearchBoard &board, const SearchLimits &limits, const std::vector<SearchMove> &excluded);
+    /// @brief the best lines moves apart, best first, each with its own score, depth, pv and the nodes spent on it.
+    /// Every depth makes one pass over the root moves and only searches a move with a full window while it can still
+    /// make the top lines. Fewer lines come back when there are fewer legal moves, one empty line for none.
+    std::vector<SearchResult> searchMultiPv(const GameManager &gm, const SearchLimits &limits, size_t lines);
+    std::vector<SearchResult> searchMultiPv(const SearchBoard &board, const SearchLimits &limits, size_t lines);
+
+    /// @brief forgets everything learned, for a position unrelated to the previous searches
+    void clearTable();
+    /// @brief lets another thread stop a running search; it still returns the last finished depth
+    void setStopFlag(const std::atomic<bool> *flag) { m_stopFlag = flag; }
+    TranspositionTable &getTable() { return m_table; }
+
+    /// @brief static evaluation: material plus piece-square tables, from the side to move's point of view
+    static int evaluate(const SearchBoard &board);
+    static bool isMateScore(int score) { return score > mateScore - maxPly || score < -mateScore + maxPly; }
+    /// @brief "+0.35", "-1.20" or "#3" / "#-2", the style of PGN [%eval] comments
+    static std::string formatScore(int score);
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include "classes.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class GameManager;
+
+/// @brief a move packed for search: from square (6 bits), to square (6 bits), promotion piece code (3 bits, 0 for none)
+using SearchMove = uint16_t;
+
+/// @brief Compact mailbox position for search.
+/// GameManager's board of polymorphic pieces is made for playing a game, not for visiting millions of positions,
+/// so the engine copies the position into 64 bytes once and makes and unmakes moves there. Hashes use the same
+/// Zobrist keys as GameManager, so they match the position index and the game's own hash history.
+class SearchBoard
+{
+public:
+    /// @brief piece codes, positive for white and negative for black
+    enum Piece : int8_t
+    {
+        EMPTY = 0,
+        PAWN = 1,
+        KNIGHT = 2,
+        BISHOP = 3,
+        ROOK = 4,
+        QUEEN = 5,
+        KING = 6
+    };
+
+    static constexpr SearchMove noMove = 0;
+
+    static SearchMove packMove(int from, int to, int promotion = EMPTY)
+    {
+        return static_cast<SearchMove>(from | (to << 6) | (promotion << 12));
+    }
+    static int moveFrom(SearchMove move) { return move & 63; }
+    static int moveTo(SearchMove move) { return (move >> 6) & 63; }
+    static int movePromotion(SearchMove move) { return move >> 12; }
+
+    static Move toMove(SearchMove move);
+    static SearchMove fromMove(const Move &move);
+    static PieceType toPieceType(int piece);
+
+private:
+    struct Undo
+    {
+        SearchMove move;
+        int8_t captured;
+        uint8_t capturedSquare;
+        uint8_t castlingRights;
+        uint8_t enPassantSquare;
+        int halfmoveClock;
+        uint64_t hash;
+    };
+
+    std::array<int8_t, 64> m_squares{};
+    /// @brief +1 when white is to move, -1 for black
+    int m_side = 1;
+    std::array<uint8_t, 2> m_kings{};
+    uint8_t m_castlingRights = 0;
+    uint8_t m_enPassantSquare = noSquare;
+    int m_halfmoveClock = 0;
+    uint64_t m_hash = 0;
+    std::vector<Undo> m_undo;
+    /// @brief hash of every position since the last capture or pawn move, the current one last
+    std::vector<uint64_t> m_history;
+
+    uint64_t enPassantKey() const;
+    uint64_t computeHash() const;
+    void generate(std::vector<SearchMove> &moves, bool capturesOnly) const;
+
+public:
+    SearchBoard() = default;
+    explicit SearchBoard(const GameManager &gm) { load(gm); }
+
+    /// @brief copies the current position of gm, with as much of its hash history as repetitions can still use
+    void load(const GameManager &gm);
+
+    int pieceAt(int square) const { return m_squares[square]; }
+    /// @brief +1 white, -1 black
+    int getSide() const { return m_side; }
+    PieceColor getSideColor() const { return m_side > 0 ? PieceColor::WHITE : PieceColor::BLACK; }
+    uint64_t getHash() const { return m_hash; }
+    int getHalfmoveClock() const { return m_halfmoveClock; }
+    int getPly() const { return static_cast<int>(m_undo.size()); }
+
+    /// @brief whether side (+1 white, -1 black) attacks square
+    bool isAttacked(int square, int side) const;
+    bool inCheck() const { return isAttacked(m_kings[m_side > 0 ? 0 : 1], -m_side); }
+
+    /// @brief pseudo-legal moves; makeMove rejects the ones that leave the king in check
+    void generateMoves(std::vector<SearchMove> &moves) const { generate(moves, false); }
+    /// @brief captures and queen promotions, for quiescence search
+    void generateCaptures(std::vector<SearchMove> &moves) const { generate(moves, true); }
+    void generateLegalMoves(std::vector<SearchMove> &moves);
+
+    /// @brief plays a pseudo-legal move
+    /// @return false, with the position unchanged, when the move leaves the mover's king in check
+    bool makeMove(SearchMove move);
+    void unmakeMove();
+    /// @brief passes the turn, for null-move pruning; never call it in check
+    void makeNullMove();
+    void unmakeNullMove() { unmakeMove(); }
+    /// @brief whether the side to move has anything besides pawns and king, where passing is rarely good
+    bool hasPieces() const;
+
+    /// @brief the position occurred before since the last irreversible move; one repetition is enough for search
+    bool isRepetition() const;
+    /// @brief 50-move rule or material no side can mate with
+    bool isRuleDraw() const;
+
+    /// @brief number of leaf nodes at depth, for checking move generation
+    uint64_t perft(int depth);
+};
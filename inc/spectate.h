@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class GameManager;
+
+/// @brief one serialized move, shared read-only by the queue of every spectator it goes to
+using SpectatorFrame = std::shared_ptr<const std::string>;
+
+/// @brief what happens to a spectator whose queue is full because it reads slower than moves are played
+enum class SlowSpectatorPolicy : uint8_t
+{
+    /// @brief the queued moves are thrown away for the newest one, which carries the whole position as FEN
+    COALESCE,
+    /// @brief the connection is closed
+    DROP
+};
+
+struct SpectatorOptions
+{
+    /// @brief Unix domain socket spectators connect to
+    std::string path = "games/spectate.sock";
+    /// @brief frames queued per spectator before the policy applies
+    size_t maxQueuedFrames = 64;
+    SlowSpectatorPolicy policy = SlowSpectatorPolicy::COALESCE;
+};
+
+struct SpectatorStats
+{
+    size_t spectators = 0;
+    /// @brief moves published, each serialized once however many watch it
+    uint64_t published = 0;
+    uint64_t serializedBytes = 0;
+    /// @brief frames put on spectator queues and frames completely written to a socket
+    uint64_t queued = 0;
+    uint64_t sent = 0;
+    /// @brief frames thrown away by COALESCE
+    uint64_t coalesced = 0;
+    /// @brief connections closed for being slow, by DROP
+    uint64_t dropped = 0;
+};
+
+/// @brief Live moves of running games for any number of watchers.
+/// Spectators connect to a Unix domain socket and send "watch <game>\n" lines, one per game they want.
+/// Every move is serialized once into an immutable frame, a JSON line with the move, its SAN, the FEN after it
+/// and the status, and the same frame is queued for every spectator of the game; a late joiner first gets the
+/// game's latest frame. One event loop thread serves all connections with non-blocking writes, so a spectator
+/// that stops reading only ever costs its bounded queue. Publishing is thread safe and does not block on I/O.
+class SpectatorServer
+{
+private:
+    struct Spectator
+    {
+        int fd = -1;
+        /// @brief unparsed start of a request line
+        std::string input;
+        std::vector<SpectatorFrame> queue;
+        /// @brief frames at the front of queue already written, and bytes of the next one
+        size_t head = 0;
+        size_t offset = 0;
+        std::vector<uint32_t> games;
+        bool closing = false;
+    };
+
+    SpectatorOptions m_options;
+    int m_listenFd = -1;
+    /// @brief publishers write a byte here to wake the event loop
+    int m_wakeFds[2] = {-1, -1};
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<int, std::unique_ptr<Spectator>> m_spectators;
+    std::unordered_map<uint32_t, std::vector<Spectator *>> m_watchers;
+    std::unordered_map<uint32_t, SpectatorFrame> m_latest;
+    SpectatorStats m_stats;
+    bool m_stop = false;
+    std::thread m_loop;
+
+    void run();
+    void accept();
+    /// @return false once the connection is finished with
+    bool read(Spectator &spectator);
+    bool write(Spectator &spectator);
+    void enqueue(Spectator &spectator, const SpectatorFrame &frame);
+    void close(Spectator &spectator);
+    void wake();
+
+public:
+    explicit SpectatorServer(SpectatorOptions options = {});
+    ~SpectatorServer();
+    SpectatorServer(const SpectatorServer &) = delete;
+    SpectatorServer &operator=(const SpectatorServer &) = delete;
+
+    /// @brief the JSON line for the move that was just played in gm, which must be the last of its history
+    /// @param san of the move; empty when the caller does not have it
+    static std::string serialize(uint32_t game, GameManager &gm, std::string_view san);
+    /// @brief fans a frame out to the spectators of game
+    void publish(uint32_t game, SpectatorFrame frame);
+    /// @brief serializes the last move of gm and publishes it
+    void publishMove(uint32_t game, GameManager &gm, std::string_view san);
+    /// @brief forgets the latest frame of a finished game; its spectators stay connected
+    void endGame(uint32_t game);
+
+    const std::string &getPath() const { return m_options.path; }
+    SpectatorStats getStats() const;
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// @brief the parts a move, a status check or a search spends its time in
+enum class TracePhase : uint8_t
+{
+    /// @brief GameManager::playMove as a whole
+    MOVE,
+    /// @brief the piece's own movement rules
+    VALIDATE,
+    /// @brief whether the move leaves the mover's king in check
+    KING_SAFETY,
+    /// @brief SAN of the move and its check suffix
+    NOTATION,
+    PGN_WRITE,
+    /// @brief GameManager::evaluateStatus when it is not cached, i.e. the mate/stalemate scan of a position
+    STATUS,
+    CHECKMATE,
+    STALEMATE,
+    SEARCH,
+    COUNT
+};
+
+enum class TraceCounter : uint8_t
+{
+    SEARCH_NODES,
+    COUNT
+};
+
+/// @brief calls and latency of one phase
+struct PhaseMetrics
+{
+    static constexpr size_t buckets = 40;
+
+    uint64_t calls = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    /// @brief bucket i counts the calls that took less than 2^i ns but not less than 2^(i-1)
+    std::array<uint64_t, buckets> histogram{};
+
+    void add(uint64_t ns);
+    void add(const PhaseMetrics &other);
+    /// @brief upper bound of the bucket the q-th fraction of calls falls into, 0 without calls
+    uint64_t percentile(double q) const;
+};
+
+struct TraceMetrics
+{
+    std::array<PhaseMetrics, static_cast<size_t>(TracePhase::COUNT)> phases;
+    std::array<uint64_t, static_cast<size_t>(TraceCounter::COUNT)> counters{};
+    /// @brief spans that were counted in the metrics but not kept for the trace, once a thread's buffer was full
+    uint64_t droppedEvents = 0;
+
+    const PhaseMetrics &operator[](TracePhase phase) const { return phases[static_cast<size_t>(phase)]; }
+    uint64_t operator[](TraceCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+};
+
+/// @brief Phase timers behind the TRACE_ macros, compiled in only with -DCHESS_TRACE=ON.
+/// Every thread records into its own buffer without locking: per-phase counts and log2 latency histograms,
+/// plus each span for the Chrome trace up to maxEvents per thread. Buffers outlive their threads, so worker
+/// threads can be traced to the end; collecting, exporting and resetting expect the traced threads to be idle.
+class Tracer
+{
+public:
+#ifdef CHESS_TRACE
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+    static constexpr size_t maxEvents = 1 << 18;
+    using Clock = std::chrono::steady_clock;
+
+    /// @param value shown with the span in the trace; nodes for a search
+    static void record(TracePhase phase, Clock::time_point start, Clock::time_point end, uint64_t value = 0);
+    static void count(TraceCounter counter, uint64_t amount);
+
+    /// @brief sums the buffers of all threads
+    static TraceMetrics collect();
+    static void reset();
+    static const char *phaseName(TracePhase phase);
+
+    /// @brief plain text table per phase with percentiles and histogram, and search nodes per second
+    static void writeMetrics(std::ostream &out);
+    /// @brief trace-event JSON for chrome://tracing or Perfetto, one complete event per span and thread
+    static void writeChromeTrace(std::ostream &out);
+    /// @brief writes <prefix>.metrics.txt and <prefix>.trace.json
+    static void writeFiles(const std::string &prefix);
+};
+
+/// @brief times the enclosing block as one span of phase
+class TraceScope
+{
+private:
+    TracePhase m_phase;
+    Tracer::Clock::time_point m_start;
+
+public:
+    explicit TraceScope(TracePhase phase) : m_phase(phase), m_start(Tracer::Clock::now()) {}
+    ~TraceScope() { Tracer::record(m_phase, m_start, Tracer::Clock::now()); }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+#ifdef CHESS_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+/// @brief times the rest of the enclosing block
+#define TRACE_SCOPE(phase) TraceScope TRACE_CONCAT(traceScope, __LINE__)(phase)
+/// @brief records a span from start until now, with a value for the trace
+#define TRACE_RECORD(phase, start, value) Tracer::record(phase, start, Tracer::Clock::now(), value)
+#define TRACE_COUNT(counter, amount) Tracer::count(counter, amount)
+#else
+#define TRACE_SCOPE(phase) ((void)0)
+#define TRACE_RECORD(phase, start, value) ((void)0)
+#define TRACE_COUNT(counter, amount) ((void)0)
+#endif
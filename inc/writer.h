@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "queue.h"
+
+class GameJournal;
+
+struct WriterStats
+{
+    uint64_t records = 0;
+    /// @brief records taken off the ring and made durable
+    uint64_t written = 0;
+    size_t queueDepth = 0;
+    size_t maxQueueDepth = 0;
+    /// @brief pushes that found the ring full and had to wait for the writer thread
+    uint64_t producerStalls = 0;
+    /// @brief time a push held up the caller, i.e. what a move pays for persistence
+    std::chrono::nanoseconds maxPushLatency{0};
+    std::chrono::nanoseconds totalPushLatency{0};
+    /// @brief time from push until the journal had the record on disk
+    std::chrono::microseconds maxDurableLatency{0};
+    std::chrono::microseconds totalDurableLatency{0};
+};
+
+/// @brief Dedicated I/O thread between a game and its journal.
+/// The game thread only formats what changed in the file and moves it into a lock-free ring; the writer thread
+/// hands everything it finds there to the journal and waits for it to become durable. Nothing on the move path
+/// touches the disk unless it asks to: write returns once the record is queued, not once it is durable, and
+/// hands back the record's sequence number, which waitFor and isDurable take to acknowledge it for real.
+/// The first failed commit stops the writer: later records are dropped unwritten, and write, waitFor and flush
+/// throw its error from then on. One producer thread per writer.
+class GameWriter
+{
+private:
+    struct Record
+    {
+        /// @brief empty for the record that stops the writer thread
+        std::string file;
+        uint64_t offset = 0;
+        std::string content;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    GameJournal &m_journal;
+    SpscRing<Record> m_ring;
+    /// @brief producer side, only the game thread writes these
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<size_t> m_maxDepth{0};
+    std::atomic<uint64_t> m_stalls{0};
+    std::atomic<int64_t> m_maxPushNs{0};
+    std::atomic<int64_t> m_totalPushNs{0};
+
+    /// @brief sequence number of the last durable record, raised by the writer thread after every journal commit;
+    /// records are numbered in push order and committed in that order, and it stays put once a commit failed
+    std::atomic<uint64_t> m_durable{0};
+    std::atomic<bool> m_failed{false};
+    /// @brief bumped whenever m_durable or m_failed changes, so waitFor can block on one atomic for both
+    std::atomic<uint32_t> m_progress{0};
+    void publishProgress();
+    mutable std::mutex m_statsMutex;
+    std::string m_error;
+    std::chrono::microseconds m_maxDurableLatency{0};
+    std::chrono::microseconds m_totalDurableLatency{0};
+    std::thread m_thread;
+
+    void run();
+
+public:
+    explicit GameWriter(GameJournal &journal, size_t capacity = 1024);
+    /// @brief drains the ring and waits for it to be durable before returning
+    ~GameWriter();
+    GameWriter(const GameWriter &) = delete;
+    GameWriter &operator=(const GameWriter &) = delete;
+
+    /// @brief queues content to replace file from offset on, as GameJournal::submit, and returns without waiting for any I/O
+    /// @return sequence number of the record, to pass to waitFor or isDurable
+    uint64_t write(const std::string &file, std::string content, uint64_t offset = 0);
+    /// @brief marks everything queued so far
+    /// @return sequence number to pass to waitFor
+    uint64_t barrier() const { return m_pushed.load(std::memory_order_relaxed); }
+    /// @brief blocks until every record up to the barrier is durable; throws when the journal failed
+    void waitFor(uint64_t barrier);
+    /// @brief whether every record up to the barrier is durable, without blocking
+    bool isDurable(uint64_t barrier) const { return m_durable.load(std::memory_order_acquire) >= barrier; }
+    /// @brief barrier and wait in one, for save and exit
+    void flush() { waitFor(barrier()); }
+
+    WriterStats getStats() const;
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include "classes.h"
+#include <cstdint>
+
+/// @brief Random keys for Zobrist position hashing. The table is generated from a fixed seed,
+/// so hashes are stable across runs and can be stored on disk.
+class Zobrist
+{
+public:
+    static uint64_t piece(PieceColor color, PieceType type, const Position &position);
+    static uint64_t blackToMove();
+    /// @brief right: 0 white kingside, 1 white queenside, 2 black kingside, 3 black queenside
+    static uint64_t castling(int right);
+    static uint64_t enPassant(char col);
+};
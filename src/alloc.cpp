@@ -0,0 +1,394 @@
+#include "alloc.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <unistd.h>
+#include <utility>
+
+namespace
+{
+    /// @brief sits right in front of every block handed out while tracking is built in
+    struct alignas(16) BlockHeader
+    {
+        uint64_t size;
+        uint32_t game;
+        /// @brief distance from the start of the underlying allocation to the block, in 16-byte units
+        uint16_t offset;
+        uint8_t subsystem;
+        uint8_t unused;
+    };
+    static_assert(sizeof(BlockHeader) == 16);
+
+    struct SubsystemCounters
+    {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<int64_t> live{0};
+        std::atomic<int64_t> peak{0};
+    };
+
+    /// @brief a game is its slot index + 1 in the low 16 bits and the slot's generation above,
+    /// so blocks of a closed game that are freed later do not count against the slot's next game
+    struct GameSlot
+    {
+        std::atomic<uint32_t> generation{0};
+        std::atomic<bool> open{false};
+        std::atomic<int64_t> live{0};
+        std::atomic<int64_t> peak{0};
+        std::atomic<uint64_t> allocations{0};
+    };
+
+    // all of these are constant-initialised, so allocations made before main are counted too
+    SubsystemCounters subsystems[static_cast<size_t>(AllocSubsystem::COUNT)];
+    GameSlot games[AllocTracker::maxGames];
+    std::atomic<uint64_t> moveCount{0};
+    std::atomic<uint64_t> moveAllocations{0};
+    std::atomic<uint64_t> moveBytes{0};
+    std::atomic<int64_t> moveMaxAllocations{0};
+    std::atomic<int64_t> moveMaxBytes{0};
+    std::atomic<uint64_t> closedGames{0};
+    std::atomic<int64_t> closedPeakTotal{0};
+    std::atomic<int64_t> closedPeakMax{0};
+
+    constinit thread_local AllocSubsystem currentSubsystem = AllocSubsystem::OTHER;
+    constinit thread_local uint32_t currentGame = 0;
+    constinit thread_local uint64_t threadAllocationCount = 0;
+    constinit thread_local uint64_t threadByteCount = 0;
+
+    void raiseMax(std::atomic<int64_t> &max, int64_t value)
+    {
+        int64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            ;
+    }
+
+    GameSlot *slotOf(uint32_t game)
+    {
+        const size_t index = (game & 0xffff) - 1;
+        if (game == 0 || index >= AllocTracker::maxGames)
+            return nullptr;
+        GameSlot &slot = games[index];
+        return (slot.generation.load(std::memory_order_relaxed) & 0xffff) == game >> 16 ? &slot : nullptr;
+    }
+
+    /// @brief names are only touched by openGame and report, never from operator new
+    struct GameNames
+    {
+        std::mutex mutex;
+        std::array<std::string, AllocTracker::maxGames> names;
+    };
+
+    GameNames &gameNames()
+    {
+        static GameNames instance;
+        return instance;
+    }
+
+    [[maybe_unused]] void *allocate(size_t size, size_t alignment)
+    {
+        const size_t offset = std::max(alignment, sizeof(BlockHeader));
+        void *base = alignment <= alignof(std::max_align_t)
+                         ? std::malloc(size + offset)
+                         : std::aligned_alloc(alignment, (size + offset + alignment - 1) / alignment * alignment);
+        if (!base)
+            return nullptr;
+
+        char *block = static_cast<char *>(base) + offset;
+        BlockHeader *header = reinterpret_cast<BlockHeader *>(block) - 1;
+        header->size = size;
+        header->game = currentGame;
+        header->offset = static_cast<uint16_t>(offset / 16);
+        header->subsystem = static_cast<uint8_t>(currentSubsystem);
+
+        SubsystemCounters &counters = subsystems[header->subsystem];
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(size, std::memory_order_relaxed);
+        raiseMax(counters.peak, counters.live.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size));
+        if (GameSlot *slot = slotOf(currentGame))
+        {
+            slot->allocations.fetch_add(1, std::memory_order_relaxed);
+            raiseMax(slot->peak, slot->live.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size));
+        }
+        threadAllocationCount++;
+        threadByteCount += size;
+        return block;
+    }
+
+    [[maybe_unused]] void release(void *block)
+    {
+        if (!block)
+            return;
+        BlockHeader *header = static_cast<BlockHeader *>(block) - 1;
+        SubsystemCounters &counters = subsystems[header->subsystem];
+        counters.frees.fetch_add(1, std::memory_order_relaxed);
+        counters.live.fetch_sub(static_cast<int64_t>(header->size), std::memory_order_relaxed);
+        if (GameSlot *slot = slotOf(header->game))
+            slot->live.fetch_sub(static_cast<int64_t>(header->size), std::memory_order_relaxed);
+        std::free(static_cast<char *>(block) - header->offset * 16);
+    }
+
+    uint64_t residentBytes()
+    {
+        std::ifstream statm("/proc/self/statm");
+        uint64_t pages = 0;
+        uint64_t resident = 0;
+        statm >> pages >> resident;
+        return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+}
+
+#ifdef CHESS_ALLOC_TRACKING
+void *operator new(size_t size)
+{
+    if (void *block = allocate(size, alignof(std::max_align_t)))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *block = allocate(size, static_cast<size_t>(alignment)))
+        return block;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *block) noexcept { release(block); }
+void operator delete[](void *block) noexcept { release(block); }
+void operator delete(void *block, size_t) noexcept { release(block); }
+void operator delete[](void *block, size_t) noexcept { release(block); }
+void operator delete(void *block, std::align_val_t) noexcept { release(block); }
+void operator delete[](void *block, std::align_val_t) noexcept { release(block); }
+void operator delete(void *block, size_t, std::align_val_t) noexcept { release(block); }
+void operator delete[](void *block, size_t, std::align_val_t) noexcept { release(block); }
+void operator delete(void *block, const std::nothrow_t &) noexcept { release(block); }
+void operator delete[](void *block, const std::nothrow_t &) noexcept { release(block); }
+void operator delete(void *block, std::align_val_t, const std::nothrow_t &) noexcept { release(block); }
+void operator delete[](void *block, std::align_val_t, const std::nothrow_t &) noexcept { release(block); }
+#endif
+
+AllocSubsystem AllocTracker::exchangeSubsystem(AllocSubsystem subsystem)
+{
+    return std::exchange(currentSubsystem, subsystem);
+}
+
+uint32_t AllocTracker::exchangeGame(uint32_t game)
+{
+    return std::exchange(currentGame, game);
+}
+
+uint64_t AllocTracker::threadAllocations()
+{
+    return threadAllocationCount;
+}
+
+uint64_t AllocTracker::threadBytes()
+{
+    return threadByteCount;
+}
+
+void AllocTracker::recordMove(uint64_t allocations, uint64_t bytes)
+{
+    moveCount.fetch_add(1, std::memory_order_relaxed);
+    moveAllocations.fetch_add(allocations, std::memory_order_relaxed);
+    moveBytes.fetch_add(bytes, std::memory_order_relaxed);
+    raiseMax(moveMaxAllocations, static_cast<int64_t>(allocations));
+    raiseMax(moveMaxBytes, static_cast<int64_t>(bytes));
+}
+
+uint32_t AllocTracker::openGame(const std::string &name)
+{
+    if constexpr (!enabled)
+        return 0;
+    GameNames &names = gameNames();
+    std::lock_guard<std::mutex> lock(names.mutex);
+    for (size_t index = 0; index < maxGames; index++)
+    {
+        GameSlot &slot = games[index];
+        if (slot.open.load(std::memory_order_relaxed))
+            continue;
+        const uint32_t generation = (slot.generation.load(std::memory_order_relaxed) + 1) & 0xffff;
+        slot.generation.store(generation, std::memory_order_relaxed);
+        slot.live.store(0, std::memory_order_relaxed);
+        slot.peak.store(0, std::memory_order_relaxed);
+        slot.allocations.store(0, std::memory_order_relaxed);
+        slot.open.store(true, std::memory_order_relaxed);
+        names.names[index] = name;
+        return generation << 16 | static_cast<uint32_t>(index + 1);
+    }
+    return 0;
+}
+
+void AllocTracker::closeGame(uint32_t game)
+{
+    GameSlot *slot = slotOf(game);
+    if (!slot)
+        return;
+    std::lock_guard<std::mutex> lock(gameNames().mutex);
+    const int64_t peak = slot->peak.load(std::memory_order_relaxed);
+    closedGames.fetch_add(1, std::memory_order_relaxed);
+    closedPeakTotal.fetch_add(peak, std::memory_order_relaxed);
+    raiseMax(closedPeakMax, peak);
+    // the generation moves on, so what the game still holds is no longer charged to the slot
+    slot->generation.fetch_add(1, std::memory_order_relaxed);
+    slot->open.store(false, std::memory_order_relaxed);
+}
+
+AllocReport AllocTracker::report()
+{
+    AllocReport report;
+    for (size_t i = 0; i < report.subsystems.size(); i++)
+    {
+        SubsystemAllocations &out = report.subsystems[i];
+        out.allocations = subsystems[i].allocations.load(std::memory_order_relaxed);
+        out.frees = subsystems[i].frees.load(std::memory_order_relaxed);
+        out.bytes = subsystems[i].bytes.load(std::memory_order_relaxed);
+        out.liveBytes = subsystems[i].live.load(std::memory_order_relaxed);
+        out.peakLiveBytes = subsystems[i].peak.load(std::memory_order_relaxed);
+    }
+    report.moves.moves = moveCount.load(std::memory_order_relaxed);
+    report.moves.allocations = moveAllocations.load(std::memory_order_relaxed);
+    report.moves.bytes = moveBytes.load(std::memory_order_relaxed);
+    report.moves.maxAllocations = static_cast<uint64_t>(moveMaxAllocations.load(std::memory_order_relaxed));
+    report.moves.maxBytes = static_cast<uint64_t>(moveMaxBytes.load(std::memory_order_relaxed));
+    report.closedGames = closedGames.load(std::memory_order_relaxed);
+    report.closedPeakTotal = closedPeakTotal.load(std::memory_order_relaxed);
+    report.closedPeakMax = closedPeakMax.load(std::memory_order_relaxed);
+    report.residentBytes = residentBytes();
+
+    std::vector<GameMemory> open;
+    {
+        GameNames &names = gameNames();
+        std::lock_guard<std::mutex> lock(names.mutex);
+        for (size_t index = 0; index < maxGames; index++)
+        {
+            const GameSlot &slot = games[index];
+            if (slot.open.load(std::memory_order_relaxed))
+                open.push_back({names.names[index], slot.live.load(std::memory_order_relaxed),
+                                slot.peak.load(std::memory_order_relaxed), slot.allocations.load(std::memory_order_relaxed)});
+        }
+    }
+    report.games = std::move(open);
+    return report;
+}
+
+void AllocTracker::reset()
+{
+    for (SubsystemCounters &counters : subsystems)
+    {
+        counters.allocations.store(0, std::memory_order_relaxed);
+        counters.frees.store(0, std::memory_order_relaxed);
+        counters.bytes.store(0, std::memory_order_relaxed);
+        counters.peak.store(counters.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    moveCount.store(0, std::memory_order_relaxed);
+    moveAllocations.store(0, std::memory_order_relaxed);
+    moveBytes.store(0, std::memory_order_relaxed);
+    moveMaxAllocations.store(0, std::memory_order_relaxed);
+    moveMaxBytes.store(0, std::memory_order_relaxed);
+    closedGames.store(0, std::memory_order_relaxed);
+    closedPeakTotal.store(0, std::memory_order_relaxed);
+    closedPeakMax.store(0, std::memory_order_relaxed);
+}
+
+const char *AllocTracker::subsystemName(AllocSubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case AllocSubsystem::MOVE:
+        return "move";
+    case AllocSubsystem::STATUS:
+        return "status";
+    case AllocSubsystem::NOTATION:
+        return "notation";
+    case AllocSubsystem::PGN:
+        return "pgn";
+    case AllocSubsystem::SEARCH:
+        return "search";
+    case AllocSubsystem::IO:
+        return "io";
+    default:
+        return "other";
+    }
+}
+
+void AllocTracker::writeReport(std::ostream &out)
+{
+    if constexpr (!enabled)
+    {
+        out << "allocation tracking is not built in, configure with -DCHESS_ALLOC_TRACKING=ON\n";
+        return;
+    }
+    const AllocReport report = AllocTracker::report();
+    auto column = [&out](auto value, size_t width)
+    {
+        std::string text = std::to_string(value);
+        out << std::string(width - std::min(width, text.size()), ' ') << text;
+    };
+
+    out << "subsystem   allocations       frees        bytes   live bytes   peak live\n";
+    for (size_t i = 0; i < report.subsystems.size(); i++)
+    {
+        const SubsystemAllocations &s = report.subsystems[i];
+        std::string name = subsystemName(static_cast<AllocSubsystem>(i));
+        out << name << std::string(10 - std::min<size_t>(10, name.size()), ' ');
+        column(s.allocations, 13);
+        column(s.frees, 12);
+        column(s.bytes, 13);
+        column(s.liveBytes, 13);
+        column(s.peakLiveBytes, 12);
+        out << '\n';
+    }
+
+    const MoveAllocations &moves = report.moves;
+    if (moves.moves)
+        out << "\nmoves: " << moves.moves << ", " << moves.allocations / moves.moves << " allocations and " << moves.bytes / moves.moves
+            << " bytes per move on average, at most " << moves.maxAllocations << " and " << moves.maxBytes << '\n';
+
+    out << "\ngames: " << report.games.size() << " open, " << report.closedGames << " closed";
+    if (report.closedGames)
+        out << ", peak per closed game " << report.closedPeakTotal / static_cast<int64_t>(report.closedGames) << " bytes on average and "
+            << report.closedPeakMax << " at most";
+    out << '\n';
+    for (const GameMemory &game : report.games)
+        out << "  " << game.name << ": " << game.liveBytes << " bytes live, " << game.peakLiveBytes << " peak, " << game.allocations
+            << " allocations\n";
+    out << "process: " << report.residentBytes / 1024 << " KB resident";
+    if (!report.games.empty())
+        out << ", " << report.residentBytes / 1024 / report.games.size() << " KB per open game";
+    out << '\n';
+}
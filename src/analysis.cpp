@@ -0,0 +1,268 @@
+#include "analysis.h"
+#include "alloc.h"
+#include "archive.h"
+#include "chess.h"
+#include "factory.h"
+#include "fen.h"
+#include "pgnstream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    void addPgnFile(const std::string &path, std::vector<AnalysisJob> &jobs)
+    {
+        PgnStreamReader reader(path);
+        PgnGameView view;
+        while (reader.nextGame(view))
+        {
+            AnalysisJob job;
+            job.name = path + "#" + std::to_string(reader.getGamesRead());
+            std::string_view text = view.text;
+            if (SanNotation::parseGame(text, job.game))
+                jobs.push_back(std::move(job));
+        }
+    }
+
+    void addTextGame(const std::string &path, std::vector<AnalysisJob> &jobs)
+    {
+        ArchivedGame game;
+        if (!GameArchive::readTextGame(path, game))
+            return;
+        AnalysisJob job;
+        job.name = path;
+        job.game.setTag("Event", std::filesystem::path(path).stem().string());
+        job.game.setTag("Date", game.date);
+        job.game.result = GameArchive::resultToString(game.result);
+        job.moves = std::move(game.moves);
+        jobs.push_back(std::move(job));
+    }
+
+    /// @brief score from the side to move's point of view, capped for centipawn loss
+    int capped(int score)
+    {
+        return std::clamp(score, -GameAnalyzer::lossCap, GameAnalyzer::lossCap);
+    }
+
+    void write(std::ofstream &out, const void *data, size_t size)
+    {
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    }
+}
+
+std::vector<AnalysisJob> GameAnalyzer::loadJobs(const std::string &path)
+{
+    std::vector<AnalysisJob> jobs;
+    if (std::filesystem::is_directory(path))
+    {
+        std::vector<std::string> files;
+        for (const auto &entry : std::filesystem::directory_iterator(path))
+        {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file() && (extension == ".txt" || extension == ".pgn"))
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        for (const std::string &file : files)
+        {
+            if (file.ends_with(".pgn"))
+                addPgnFile(file, jobs);
+            else
+                addTextGame(file, jobs);
+        }
+    }
+    else if (path.ends_with(".cga"))
+    {
+        GameArchiveReader reader(path);
+        ArchivedGame game;
+        for (size_t i = 0; i < reader.getGameCount(); i++)
+        {
+            reader.readGame(i, game);
+            AnalysisJob job;
+            job.name = path + "#" + std::to_string(i + 1);
+            job.game.setTag("Event", job.name);
+            job.game.setTag("Date", game.date);
+            job.game.result = GameArchive::resultToString(game.result);
+            job.moves = game.moves;
+            jobs.push_back(std::move(job));
+        }
+    }
+    else if (std::filesystem::is_regular_file(path))
+        addPgnFile(path, jobs);
+    else
+        throw std::invalid_argument("no such file or directory: " + path);
+    return jobs;
+}
+
+void GameAnalyzer::setupJob(const AnalysisJob &job, GameManager &gm)
+{
+    gm.resetGame();
+    if (std::string fen = job.game.getTag("FEN"); !fen.empty())
+        FenNotation::fromFen(gm, fen);
+}
+
+Move GameAnalyzer::resolveMove(const AnalysisJob &job, GameManager &gm, size_t ply)
+{
+    if (!job.moves.empty())
+        return job.moves[ply];
+    std::optional<Move> move = SanNotation::fromSan(gm, job.game.moves[ply].san);
+    if (!move)
+        throw std::runtime_error("illegal or ambiguous move '" + job.game.moves[ply].san + "'");
+    return *move;
+}
+
+GameAnalysis GameAnalyzer::analyzeGame(const AnalysisJob &job, SearchEngine &engine, GameManager &gm, const AnalysisOptions &options,
+                                       uint64_t &nodes)
+{
+    ALLOC_GAME(job.name);
+    GameAnalysis analysis;
+    analysis.annotated.tags = job.game.tags;
+    analysis.annotated.result = job.game.result;
+    analysis.annotated.comment = job.game.comment;
+
+    const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+    try
+    {
+        setupJob(job, gm);
+
+        // the table only knows this game's positions, which is what the next ply wants to find there
+        engine.clearTable();
+        SearchBoard board(gm);
+        auto searchLines = [&]
+        {
+            std::vector<SearchResult> lines = engine.searchMultiPv(board, options.limits, options.multiPv);
+            for (const SearchResult &line : lines)
+                nodes += line.nodes;
+            return lines;
+        };
+        std::vector<SearchResult> beforeLines = searchLines();
+
+        for (size_t ply = 0; ply < plies; ply++)
+        {
+            const Move move = resolveMove(job, gm, ply);
+            PgnMove annotated;
+            annotated.san = SanNotation::toSan(gm, move);
+            const SearchResult &before = beforeLines.front();
+            std::string best = before.bestMove ? SanNotation::toSan(gm, *before.bestMove) : "-";
+            // with more than one line the alternatives follow, scored like %eval from white's point of view
+            std::string alternatives;
+            for (size_t line = 0; beforeLines.size() > 1 && line < beforeLines.size(); line++)
+            {
+                int score = board.getSide() > 0 ? beforeLines[line].score : -beforeLines[line].score;
+                alternatives += (line ? ", " : ", lines ") + SanNotation::toSan(gm, *beforeLines[line].bestMove) + " " +
+                                SearchEngine::formatScore(score);
+            }
+            const SearchMove played = SearchBoard::fromMove(move);
+            if (!gm.replayMove(move) || !board.makeMove(played))
+                throw std::runtime_error("failed to replay move '" + annotated.san + "'");
+            annotated.san += SanNotation::checkSuffix(gm);
+
+            std::vector<SearchResult> afterLines = searchLines();
+            const SearchResult &after = afterLines.front();
+
+            // both scores are for the side to move, so the mover's loss is its score before plus its opponent's after
+            PlySummary summary{};
+            summary.best = before.bestMove ? SearchBoard::fromMove(*before.bestMove) : SearchBoard::noMove;
+            summary.played = played;
+            summary.loss = summary.best == played ? 0 : static_cast<uint16_t>(std::max(0, capped(before.score) + capped(after.score)));
+            int whiteEval = board.getSide() > 0 ? after.score : -after.score;
+            summary.eval = static_cast<int16_t>(whiteEval);
+
+            annotated.comment = "[%eval " + SearchEngine::formatScore(whiteEval) + "] best " + best + ", loss " +
+                                std::to_string(summary.loss) + alternatives;
+            analysis.annotated.moves.push_back(std::move(annotated));
+            analysis.plies.push_back(summary);
+            beforeLines = std::move(afterLines);
+        }
+        analysis.valid = true;
+    }
+    catch (const std::exception &e)
+    {
+        analysis.error = e.what();
+        analysis.annotated.moves.clear();
+        analysis.plies.clear();
+    }
+    return analysis;
+}
+
+AnalysisStats GameAnalyzer::run(const std::vector<AnalysisJob> &jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_results.assign(jobs.size(), GameAnalysis{});
+    std::atomic<size_t> nextGame{0};
+    std::atomic<uint64_t> totalNodes{0};
+
+    const unsigned threads = std::max(1u, m_options.threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]
+                             {
+            PieceFactory factory;
+            GameManager gm(factory);
+            SearchEngine engine(m_options.tableMegabytes);
+            uint64_t nodes = 0;
+            // games are handed out one at a time, a long game on one thread does not hold up the others
+            for (size_t i = nextGame++; i < jobs.size(); i = nextGame++)
+                m_results[i] = analyzeGame(jobs[i], engine, gm, m_options, nodes);
+            totalNodes += nodes; });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+
+    AnalysisStats stats;
+    stats.games = jobs.size();
+    for (const GameAnalysis &result : m_results)
+    {
+        if (!result.valid)
+            continue;
+        stats.validGames++;
+        stats.positions += result.plies.size() + 1;
+    }
+    stats.nodes = totalNodes;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+void GameAnalyzer::writePgn(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("failed to open " + path);
+    for (const GameAnalysis &result : m_results)
+    {
+        if (result.valid)
+            out << SanNotation::writeGame(result.annotated) << '\n';
+    }
+    if (!out.flush())
+        throw std::runtime_error("failed to write " + path);
+}
+
+void GameAnalyzer::writeSummary(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("failed to open " + path);
+
+    uint32_t gameCount = static_cast<uint32_t>(m_results.size());
+    uint32_t depth = static_cast<uint32_t>(m_options.limits.depth);
+    write(out, magic, sizeof(magic));
+    write(out, &version, sizeof(version));
+    write(out, &gameCount, sizeof(gameCount));
+    write(out, &depth, sizeof(depth));
+    for (uint32_t index = 0; index < gameCount; index++)
+    {
+        const GameAnalysis &result = m_results[index];
+        uint32_t plies = static_cast<uint32_t>(result.plies.size());
+        write(out, &index, sizeof(index));
+        write(out, &plies, sizeof(plies));
+        write(out, result.plies.data(), plies * sizeof(PlySummary));
+    }
+    if (!out.flush())
+        throw std::runtime_error("failed to write " + path);
+}
@@ -0,0 +1,326 @@
+#include "classes.h"
+#include "archive.h"
+#include <bit>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    void putLittleEndian(std::vector<uint8_t> &out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    uint64_t getLittleEndian(const char *data, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+        return value;
+    }
+
+    /// @brief bits needed to tell apart count moves; a forced move costs nothing
+    int indexWidth(size_t count)
+    {
+        return count <= 1 ? 0 : static_cast<int>(std::bit_width(count - 1));
+    }
+}
+
+GameResult GameArchive::parseResult(std::string_view text)
+{
+    if (text.starts_with("1-0"))
+        return GameResult::WHITE_WINS;
+    if (text.starts_with("0-1"))
+        return GameResult::BLACK_WINS;
+    if (text.starts_with("1/2-1/2"))
+        return GameResult::DRAW;
+    return GameResult::UNKNOWN;
+}
+
+const char *GameArchive::resultToString(GameResult result)
+{
+    switch (result)
+    {
+    case GameResult::WHITE_WINS:
+        return "1-0";
+    case GameResult::BLACK_WINS:
+        return "0-1";
+    case GameResult::DRAW:
+        return "1/2-1/2";
+    default:
+        return "*";
+    }
+}
+
+bool GameArchive::readTextGame(const std::string &path, ArchivedGame &game)
+{
+    std::ifstream inFile(path);
+    if (!inFile)
+        return false;
+
+    game = ArchivedGame();
+    std::string line;
+    while (std::getline(inFile, line))
+    {
+        if (line.starts_with("[Date \""))
+        {
+            size_t end = line.find('"', 7);
+            game.date = line.substr(7, end == std::string::npos ? std::string::npos : end - 7);
+        }
+        else if (line.starts_with("Result: "))
+        {
+            game.result = parseResult(line.substr(8));
+        }
+        else if (!line.empty() && std::isdigit(static_cast<unsigned char>(line[0])))
+        {
+            for (const Move &move : PgnNotation::parseMovesFromFile(line))
+                game.moves.push_back(move);
+        }
+    }
+    return true;
+}
+
+void GameArchive::writeTextGame(const std::string &path, const ArchivedGame &game)
+{
+    std::ofstream outFile(path, std::ios::out | std::ios::trunc);
+    if (!outFile)
+        throw std::runtime_error("failed to open " + path + " for writing");
+
+    // same layout PgnNotation::writeTurn produces
+    outFile << "[Date \"" << game.date << "\"]\n";
+    for (size_t ply = 0; ply < game.moves.size(); ply++)
+    {
+        std::string move = PgnNotation::formatMove(game.movers.at(ply), game.moves[ply]);
+        if (ply % 2 == 0)
+            outFile << (ply / 2 + 1) << ". " << move << (ply + 1 < game.moves.size() ? " | " : " |\n");
+        else
+            outFile << move << '\n';
+    }
+    if (game.result != GameResult::UNKNOWN)
+        outFile << "\nResult: " << resultToString(game.result) << '\n';
+}
+
+GameArchiveWriter::GameArchiveWriter(const std::string &path) : m_gm(m_factory)
+{
+    m_out.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_out)
+        throw std::runtime_error("failed to open " + path + " for writing");
+
+    // the header is rewritten with the real counts by finish()
+    std::vector<char> header(GameArchive::headerSize, 0);
+    m_out.write(header.data(), header.size());
+    m_position = GameArchive::headerSize;
+
+    m_gm.resetGame();
+    m_start.load(m_gm);
+}
+
+GameArchiveWriter::~GameArchiveWriter()
+{
+    try
+    {
+        finish();
+    }
+    catch (...)
+    {
+    }
+}
+
+void GameArchiveWriter::beginGame()
+{
+    m_board = m_start;
+    m_plies = 0;
+    m_bits.clear();
+    m_bitCount = 0;
+}
+
+void GameArchiveWriter::encodeMove(const Move &move)
+{
+    m_board.generateMoves(m_moves);
+
+    const SearchMove wanted = SearchBoard::fromMove(move);
+    size_t index = 0;
+    while (index < m_moves.size() && m_moves[index] != wanted)
+        index++;
+    if (index == m_moves.size() || !m_board.makeMove(wanted))
+        throw std::runtime_error("illegal move in game " + std::to_string(m_offsets.size() + 1));
+
+    // most significant bit first, so a reader can pull the same widths back off in order
+    for (int bit = indexWidth(m_moves.size()) - 1; bit >= 0; bit--)
+    {
+        if (m_bitCount % 8 == 0)
+            m_bits.push_back(0);
+        if ((index >> bit) & 1)
+            m_bits.back() |= static_cast<uint8_t>(0x80 >> (m_bitCount % 8));
+        m_bitCount++;
+    }
+    m_plies++;
+}
+
+size_t GameArchiveWriter::endGame(GameResult result, std::string_view date)
+{
+    std::vector<uint8_t> record;
+    uint64_t plies = m_plies;
+    do
+    {
+        uint8_t byte = plies & 0x7f;
+        plies >>= 7;
+        record.push_back(byte | (plies ? 0x80 : 0));
+    } while (plies);
+
+    record.push_back(static_cast<uint8_t>(result));
+    date = date.substr(0, 255);
+    record.push_back(static_cast<uint8_t>(date.size()));
+    record.insert(record.end(), date.begin(), date.end());
+    record.insert(record.end(), m_bits.begin(), m_bits.end());
+
+    m_out.write(reinterpret_cast<const char *>(record.data()), record.size());
+    m_offsets.push_back(m_position);
+    m_position += record.size();
+    return m_offsets.size() - 1;
+}
+
+size_t GameArchiveWriter::addGame(const ArchivedGame &game)
+{
+    beginGame();
+    for (const Move &move : game.moves)
+        encodeMove(move);
+    return endGame(game.result, game.date);
+}
+
+size_t GameArchiveWriter::addPgnGame(const PgnGameView &game)
+{
+    // records have no start position, and the games/ files they unpack to could not hold one either
+    if (!game.getTag("FEN").empty() || game.getTag("SetUp") == "1")
+        throw std::runtime_error("set-up positions are not supported, the game starts from a FEN");
+
+    beginGame();
+    m_gm.resetGame();
+    for (std::string_view san : game.moves)
+    {
+        std::optional<Move> move = SanNotation::fromSan(m_gm, san);
+        if (!move)
+            throw std::runtime_error("illegal or ambiguous move '" + std::string(san) + "'");
+        encodeMove(*move);
+        m_gm.replayMove(*move);
+    }
+
+    std::string date(game.getTag("Date"));
+    return endGame(GameArchive::parseResult(game.result), date);
+}
+
+void GameArchiveWriter::finish()
+{
+    if (m_finished)
+        return;
+    m_finished = true;
+
+    std::vector<uint8_t> table;
+    table.reserve(m_offsets.size() * 8);
+    for (uint64_t offset : m_offsets)
+        putLittleEndian(table, offset, 8);
+    m_out.write(reinterpret_cast<const char *>(table.data()), table.size());
+
+    std::vector<uint8_t> header(GameArchive::magic, GameArchive::magic + 4);
+    putLittleEndian(header, GameArchive::version, 4);
+    putLittleEndian(header, m_offsets.size(), 8);
+    putLittleEndian(header, m_position, 8);
+    header.resize(GameArchive::headerSize, 0);
+    m_out.seekp(0);
+    m_out.write(reinterpret_cast<const char *>(header.data()), header.size());
+    m_out.close();
+    if (!m_out)
+        throw std::runtime_error("failed to write archive");
+}
+
+GameArchiveReader::GameArchiveReader(const std::string &path) : m_file(path)
+{
+    std::string_view data = m_file.getView();
+    if (!m_file.isMapped() || data.size() < GameArchive::headerSize ||
+        std::memcmp(data.data(), GameArchive::magic, 4) != 0)
+        throw std::runtime_error(path + " is not a game archive");
+    if (getLittleEndian(data.data() + 4, 4) != GameArchive::version)
+        throw std::runtime_error(path + " has an unsupported archive version");
+
+    m_gameCount = getLittleEndian(data.data() + 8, 8);
+    m_tableOffset = getLittleEndian(data.data() + 16, 8);
+    if (m_tableOffset > data.size() || (data.size() - m_tableOffset) / 8 < m_gameCount)
+        throw std::runtime_error(path + " has a truncated offset table");
+
+    PieceFactory factory;
+    GameManager gm(factory);
+    gm.resetGame();
+    m_start.load(gm);
+}
+
+void GameArchiveReader::readGame(size_t index, ArchivedGame &game) const
+{
+    if (index >= m_gameCount)
+        throw std::out_of_range("game index out of range");
+
+    std::string_view data = m_file.getView();
+    size_t pos = getLittleEndian(data.data() + m_tableOffset + 8 * index, 8);
+    size_t end = (index + 1 < m_gameCount) ? getLittleEndian(data.data() + m_tableOffset + 8 * (index + 1), 8) : m_tableOffset;
+    if (pos >= end || end > m_tableOffset)
+        throw std::runtime_error("corrupt archive record " + std::to_string(index));
+
+    uint64_t plies = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        plies |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    if (pos + 2 > end)
+        throw std::runtime_error("corrupt archive record " + std::to_string(index));
+
+    game.moves.clear();
+    game.movers.clear();
+    game.result = static_cast<GameResult>(static_cast<uint8_t>(data[pos++]));
+    size_t dateLength = static_cast<uint8_t>(data[pos++]);
+    if (pos + dateLength > end)
+        throw std::runtime_error("corrupt archive record " + std::to_string(index));
+    game.date.assign(data.substr(pos, dateLength));
+    pos += dateLength;
+
+    const char *bits = data.data() + pos;
+    const size_t bitLimit = (end - pos) * 8;
+    size_t bitPos = 0;
+
+    SearchBoard board = m_start;
+    std::vector<SearchMove> moves;
+    for (uint64_t ply = 0; ply < plies; ply++)
+    {
+        board.generateMoves(moves);
+        int width = indexWidth(moves.size());
+        if (moves.empty() || bitPos + width > bitLimit)
+            throw std::runtime_error("corrupt archive record " + std::to_string(index));
+
+        size_t moveIndex = 0;
+        for (int bit = 0; bit < width; bit++, bitPos++)
+            moveIndex = (moveIndex << 1) | ((static_cast<uint8_t>(bits[bitPos / 8]) >> (7 - bitPos % 8)) & 1);
+        if (moveIndex >= moves.size())
+            throw std::runtime_error("corrupt archive record " + std::to_string(index));
+
+        const SearchMove move = moves[moveIndex];
+        const PieceType mover = SearchBoard::toPieceType(board.pieceAt(SearchBoard::moveFrom(move)));
+        if (!board.makeMove(move))
+            throw std::runtime_error("corrupt archive record " + std::to_string(index));
+        game.moves.push_back(SearchBoard::toMove(move));
+        game.movers.push_back(mover);
+    }
+}
+
+void GameArchiveReader::readGame(size_t index, GameManager &gm, ArchivedGame &game) const
+{
+    readGame(index, game);
+    gm.resetGame();
+    for (const Move &move : game.moves)
+    {
+        if (!gm.replayMove(move))
+            throw std::runtime_error("corrupt archive record " + std::to_string(index));
+    }
+}
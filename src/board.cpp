@@ -97,6 +97,16 @@ PieceInterface *Board::getPieceAt(const Position &position) const
     return m_grid[col][row].getPiece();
 }
 
+/// @brief empties every square without deleting pieces
+void Board::clear()
+{
+    for (auto &column : m_grid)
+    {
+        for (auto &square : column)
+            square.clearPiece();
+    }
+}
+
 void Board::displayBoardConsole(PieceColor perspective) const
 {
     bool whiteBottom = (perspective == PieceColor::WHITE);
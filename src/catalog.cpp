@@ -0,0 +1,176 @@
+#include "classes.h"
+#include "catalog.h"
+#include "archive.h"
+#include "replay.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+bool CatalogFilter::matches(const CatalogEntry &entry) const
+{
+    if (result && entry.getResult() != *result)
+        return false;
+    if (entry.plies < minPlies || entry.plies > maxPlies)
+        return false;
+
+    std::string_view date = entry.getDate();
+    if (!dateFrom.empty() && date.substr(0, dateFrom.size()) < dateFrom)
+        return false;
+    if (!dateTo.empty() && date.substr(0, dateTo.size()) > dateTo)
+        return false;
+    return true;
+}
+
+GameCatalog::GameCatalog(const std::string &path) : m_path(path)
+{
+    fs::path parent = fs::path(m_path).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent);
+
+    if (!fs::exists(m_path) || fs::file_size(m_path) < headerSize)
+    {
+        std::ofstream create(m_path, std::ios::out | std::ios::trunc | std::ios::binary);
+        char header[headerSize] = {};
+        std::memcpy(header, magic, 4);
+        create.write(header, headerSize);
+        if (!create)
+            throw std::runtime_error("failed to create " + m_path);
+    }
+
+    std::span<const CatalogEntry> stored = entries();
+    if (!m_mapped->isMapped() || std::memcmp(m_mapped->getView().data(), magic, 4) != 0)
+        throw std::runtime_error(m_path + " is not a game catalog");
+
+    // a record cut short by a crash is past m_count and simply gets overwritten
+    m_count = static_cast<uint32_t>(stored.size());
+    for (const CatalogEntry &entry : stored)
+        m_ids[std::string(entry.getName())] = entry.gameId;
+
+    m_file.open(m_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!m_file)
+        throw std::runtime_error("failed to open " + m_path + " for writing");
+
+    // games saved before there was a catalog, or by a session killed before it could catalogue them, are
+    // picked up here; only their names are listed, a game already catalogued is never opened
+    if (!parent.empty())
+        addDirectory(parent.string());
+}
+
+std::span<const CatalogEntry> GameCatalog::entries() const
+{
+    if (!m_mapped)
+        m_mapped = std::make_unique<MappedFile>(m_path);
+    std::string_view data = m_mapped->getView();
+    if (data.size() < headerSize)
+        return {};
+    return std::span<const CatalogEntry>(reinterpret_cast<const CatalogEntry *>(data.data() + headerSize),
+                                         (data.size() - headerSize) / sizeof(CatalogEntry));
+}
+
+uint32_t GameCatalog::record(const std::string &name, std::string_view date, GameResult result, uint32_t plies,
+                             uint64_t finalHash, uint64_t offset)
+{
+    if (name.size() > maxNameLength)
+        throw std::invalid_argument("game name " + name + " is longer than " + std::to_string(maxNameLength) + " bytes");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [it, inserted] = m_ids.try_emplace(name, m_count);
+    uint32_t gameId = it->second;
+
+    CatalogEntry entry{};
+    entry.gameId = gameId;
+    entry.plies = plies;
+    entry.finalHash = finalHash;
+    entry.offset = offset;
+    entry.result = static_cast<uint8_t>(result);
+    date.copy(entry.date, sizeof(entry.date) - 1);
+    name.copy(entry.name, maxNameLength);
+
+    m_file.seekp(headerSize + static_cast<std::streamoff>(gameId) * sizeof(CatalogEntry));
+    m_file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    m_file.flush();
+    if (!m_file)
+        throw std::runtime_error("failed to write " + m_path);
+
+    if (inserted)
+        m_count++;
+    // the mapping does not grow with the file, it is redone by the next read
+    m_mapped.reset();
+    return gameId;
+}
+
+uint32_t GameCatalog::record(const std::string &name, std::string_view date, GameResult result, const GameManager &gm)
+{
+    return record(name, date, result, static_cast<uint32_t>(gm.getMoveHistory().size()), gm.getPositionHash());
+}
+
+size_t GameCatalog::addDirectory(const std::string &directory)
+{
+    std::vector<fs::path> files;
+    for (const auto &entry : fs::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".txt")
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    PieceFactory factory;
+    GameManager gm(factory);
+    ArchivedGame game;
+    size_t added = 0;
+    for (const fs::path &file : files)
+    {
+        std::string name = file.filename().string();
+        if (name.size() > maxNameLength || find(name) || !GameArchive::readTextGame(file.string(), game) || game.moves.empty())
+            continue;
+
+        // a game that no longer replays is still listed, just without its final position
+        gm.resetGame();
+        if (!GameReplayer::replay(gm, game.moves).ok)
+            gm.resetGame();
+
+        // saved games are named after the time they were started
+        std::string stem = file.stem().string();
+        record(name, !stem.empty() && std::isdigit(static_cast<unsigned char>(stem[0])) ? stem : game.date,
+               game.result, static_cast<uint32_t>(game.moves.size()), gm.getPositionHash());
+        added++;
+    }
+    return added;
+}
+
+CatalogPage GameCatalog::list(const CatalogFilter &filter, size_t page, size_t pageSize) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CatalogPage result;
+    std::span<const CatalogEntry> stored = entries();
+    stored = stored.first(std::min<size_t>(m_count, stored.size()));
+    const size_t first = page * pageSize;
+
+    for (auto it = stored.rbegin(); it != stored.rend(); ++it)
+    {
+        if (!filter.matches(*it))
+            continue;
+        if (result.total >= first && result.entries.size() < pageSize)
+            result.entries.push_back(*it);
+        result.total++;
+    }
+    return result;
+}
+
+std::optional<CatalogEntry> GameCatalog::find(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_ids.find(name);
+    if (it == m_ids.end())
+        return std::nullopt;
+    return entries()[it->second];
+}
+
+size_t GameCatalog::getCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
@@ -3,56 +3,96 @@
 #include <stdexcept>
 #include <print>
 #include <array>
+#include <algorithm>
+#include <numeric>
 #include "classes.h"
 #include "chess.h"
-
-/// @brief match turn
-int GameManager::turn = 1;
+#include "zobrist.h"
+#include "archive.h"
+#include "posindex.h"
+#include "catalog.h"
+#include "fen.h"
+#include "replay.h"
+#include "trace.h"
+#include "alloc.h"
+#include "spectate.h"
+#include <filesystem>
 
 Chess::Chess(PieceFactory &factory) : m_gm(factory)
 {
+    m_gm.getPgn().setWriter(&m_writer);
     m_gm.setupBoard();
 }
 
 void Chess::run()
 {
     std::string command;
-    std::cout << "enter 'new' for new game or 'load' to load saved game: ";
+    bool gameOver = false;
+    std::cout << "enter 'new' for new game, 'load' to load saved game or 'import' to import a pgn file: ";
     std::getline(std::cin, command);
 
     if (command == "load")
     {
-        auto savedGames = PgnNotation::listSavedGames();
-        if (savedGames.empty())
-        {
-            std::println("no saved games found.");
-            return;
-        }
+        GameCatalog catalog;
+        CatalogFilter filter;
+        CatalogPage listing;
+        const size_t pageSize = 20;
+        size_t page = 0;
+        std::string selection;
 
-        std::println("available saved games:");
-        for (size_t i = 0; i < savedGames.size(); ++i)
+        while (true)
         {
-            std::println("{0}: {1}", i + 1, savedGames[i]);
-        }
+            listing = catalog.list(filter, page, pageSize);
+            if (listing.total == 0 && filter.result)
+            {
+                std::println("no saved games with that result.");
+                filter.result.reset();
+                continue;
+            }
+            if (listing.total == 0)
+            {
+                std::println("no saved games found.");
+                return;
+            }
 
-        std::print("enter game number to load: ");
-        std::string selection;
-        std::getline(std::cin, selection);
+            std::println("saved games {0}-{1} of {2}:", page * pageSize + 1, page * pageSize + listing.entries.size(), listing.total);
+            for (size_t i = 0; i < listing.entries.size(); ++i)
+            {
+                const CatalogEntry &entry = listing.entries[i];
+                std::println("{0}: {1}  {2:<7}  {3} plies", page * pageSize + i + 1, entry.getName(),
+                             GameArchive::resultToString(entry.getResult()), entry.plies);
+            }
+
+            std::print("enter game number to load, 'n'/'p' for the next/previous page or a result (1-0, 0-1, 1/2-1/2, *) to filter: ");
+            std::getline(std::cin, selection);
+
+            if (selection == "n")
+                page += ((page + 1) * pageSize < listing.total) ? 1 : 0;
+            else if (selection == "p")
+                page -= (page > 0) ? 1 : 0;
+            else if (selection == "*" || selection.find('-') != std::string::npos)
+            {
+                filter.result = GameArchive::parseResult(selection);
+                page = 0;
+            }
+            else
+                break;
+        }
 
         try
         {
-            int index = std::stoi(selection) - 1;
-            if (index >= 0 && index < static_cast<int>(savedGames.size()))
+            int index = std::stoi(selection) - 1 - static_cast<int>(page * pageSize);
+            if (index >= 0 && index < static_cast<int>(listing.entries.size()))
             {
-                if (m_gm.getPgn().loadGame(savedGames[index]))
+                std::string savedGame(listing.entries[index].getName());
+                if (m_gm.getPgn().loadGame(savedGame))
                 {
-                    GameManager::turn = 1;                       
                     m_gm.setupBoard();                           
                     m_gm.setCurrentTurnColor(PieceColor::WHITE); 
-                    m_gm.getPgn().clearPieceMovementHistory();   
 
                     std::string line;
                     bool headerSkipped = false;
+                    GameReplayer replayer(m_gm);
 
                     while (m_gm.getPgn().readNextLine(line))
                     {
@@ -70,21 +110,12 @@ void Chess::run()
                             continue;
                         }
 
-                        auto moves = m_gm.getPgn().parseMovesFromFile(line); 
+                        auto moves = PgnNotation::parseMovesFromFile(line); 
 
-                        for (const auto &[from, to] : moves)
+                        for (const Move &move : moves)
                         {
-                            auto *piece = m_gm.getBoard().getPieceAt(from);
-
-                            if (!piece)
-                            {
-                                throw std::runtime_error("no piece at source position");
-                            }
-
-                            if (!m_gm.movePiece(from, to, true))
-                            {
-                                throw std::runtime_error("failed to replay move");
-                            }
+                            if (!replayer.play(move))
+                                throw std::runtime_error(replayer.finish().error);
                         }
                     }
 
@@ -93,12 +124,34 @@ void Chess::run()
                     int savedTurn;
                     if (m_gm.getPgn().loadTurnState(savedTurn, whiteHasMoved))
                     {
-                        GameManager::turn = savedTurn;
+                        m_gm.setFullmoveNumber(savedTurn);
                         m_gm.setCurrentTurnColor(whiteHasMoved ? PieceColor::BLACK : PieceColor::WHITE);
                     }
 
                     std::println("game loaded successfully\n");
                     m_gm.displayBoard();
+
+                    // end of game is only worked out once, for the position the game was left in
+                    switch (replayer.finish().status)
+                    {
+                    case GameStatus::CHECKMATE:
+                        std::println("this game already ended in checkmate.");
+                        return;
+                    case GameStatus::STALEMATE:
+                        std::println("this game already ended in stalemate.");
+                        return;
+                    case GameStatus::INSUFFICIENT_MATERIAL:
+                        std::println("this game already ended in a draw by insufficient material.");
+                        return;
+                    case GameStatus::FIFTY_MOVE_RULE:
+                        std::println("this game already ended in a draw by the 50-move rule.");
+                        return;
+                    case GameStatus::THREEFOLD_REPETITION:
+                        std::println("this game already ended in a draw by threefold repetition.");
+                        return;
+                    default:
+                        break;
+                    }
                 }
             }
         }
@@ -108,6 +161,59 @@ void Chess::run()
             return;
         }
     }
+    else if (command == "import")
+    {
+        auto pgnFiles = PgnNotation::listSavedGames(".pgn");
+        if (pgnFiles.empty())
+        {
+            std::println("no pgn files found in games/.");
+            return;
+        }
+
+        std::println("available pgn files:");
+        for (size_t i = 0; i < pgnFiles.size(); ++i)
+        {
+            std::println("{0}: {1}", i + 1, pgnFiles[i]);
+        }
+
+        std::print("enter file number to import: ");
+        std::string selection;
+        std::getline(std::cin, selection);
+
+        try
+        {
+            int index = std::stoi(selection) - 1;
+            if (index < 0 || index >= static_cast<int>(pgnFiles.size()))
+            {
+                std::println("invalid file number.");
+                return;
+            }
+
+            PgnGame game;
+            if (!SanNotation::readPgnFile("games/" + pgnFiles[index], game))
+            {
+                std::println("no game found in {0}", pgnFiles[index]);
+                return;
+            }
+
+            // imported moves are written to a fresh native file so the game can be continued and saved
+            m_gm.getPgn().initNewGame();
+            SanNotation::importGame(m_gm, game, false);
+
+            if (!m_gm.getStartFen().empty())
+                std::println("the game starts from a set-up position, use 'export' to keep it; 'save' can only restore games from the initial position");
+            std::println("imported {0} moves\n", game.moves.size());
+            m_gm.displayBoard();
+
+            // a game decided on the board is recorded as such and not played on
+            gameOver = finishGame(m_gm.evaluateStatus());
+        }
+        catch (const std::exception &e)
+        {
+            std::println("error importing game: {}", e.what());
+            return;
+        }
+    }
     else if (command == "new")
     {
         m_gm.getPgn().initNewGame(); 
@@ -119,15 +225,17 @@ void Chess::run()
         return;
     }
 
-    while (true)
+    while (!gameOver)
     {
         std::string move;
-        std::println("TURN {0}", GameManager::turn);
+        std::println("TURN {0}", m_gm.getFullmoveNumber());
         std::println("{0} move", (m_gm.getCurrentTurnColor() == PieceColor::WHITE ? "white" : "black"));
         try
         {
             std::print("enter move: ");
-            std::getline(std::cin, move);
+            // a closed console ends the session instead of asking forever
+            if (!std::getline(std::cin, move))
+                break;
 
             // draw by agreement
             if (move == "draw")
@@ -153,12 +261,54 @@ void Chess::run()
                 if (m_gm.getCurrentTurnColor() == PieceColor::BLACK)
                 {
                     m_gm.getPgn().appendToFile("\n");
-                    m_gm.getPgn().saveTurnState(GameManager::turn, true); 
+                    m_gm.getPgn().saveTurnState(m_gm.getFullmoveNumber(), true, m_gm.getCastlingRights()); 
                 }
                 std::println("Game saved!");
                 break;
             }
 
+            if (move == "memory")
+            {
+                AllocTracker::writeReport(std::cout);
+                continue;
+            }
+
+            if (move == "fen")
+            {
+                std::println("{0}", FenNotation::toFen(m_gm));
+                continue;
+            }
+
+            // "hints e2": where the piece on e2 can go
+            if (move.starts_with("hints "))
+            {
+                std::string square = move.substr(6);
+                if (square.size() != 2 || std::tolower(square[0]) < 'a' || std::tolower(square[0]) > 'h' || square[1] < '1' || square[1] > '8')
+                    throw std::invalid_argument("give the square as in 'hints e2'");
+                uint64_t targets = m_gm.getLegalDestinations(Position(static_cast<char>(std::tolower(square[0])), square[1] - '0'));
+                std::string list;
+                for (int index = 0; index < 64; index++)
+                {
+                    if (targets & (uint64_t{1} << index))
+                    {
+                        list += ' ';
+                        list += static_cast<char>('a' + index % 8);
+                        list += static_cast<char>('1' + index / 8);
+                    }
+                }
+                std::println("{0}:{1}", square, list.empty() ? " no legal moves" : list);
+                continue;
+            }
+
+            if (move == "export")
+            {
+                std::string pgnFile = m_gm.getPgn().getFileName();
+                pgnFile = pgnFile.substr(0, pgnFile.rfind('.')) + ".pgn";
+                SanNotation::writePgnFile(pgnFile, SanNotation::exportGame(m_gm));
+                std::println("game exported to {0}", pgnFile);
+                continue;
+            }
+
             if (move.length() == 5 && move[2] == ' ')
             {
                 char fromCol = std::tolower(move[0]);
@@ -172,42 +322,41 @@ void Chess::run()
                 Position from(fromCol, fromRow);
                 Position to(toCol, toRow);
 
-                if (m_gm.movePiece(from, to, false))
+                // the piece is asked for only once the move itself is known to be legal
+                Move requested{from, to};
+                if (m_gm.isPromotionMove(from, to) && m_gm.isLegalMove(requested))
+                    requested.promotion = askPromotion();
+
+                MoveOutcome outcome = m_gm.playMove(requested);
+                if (outcome == MoveOutcome::PLAYED)
                 {
+                    // playMove only queued the move; it is not shown to anyone before it is on disk
+                    m_writer.waitFor(m_gm.getPgn().getLastWrite());
+                    if (m_spectators)
+                        m_spectators->publishMove(m_spectatorGame, m_gm, m_gm.getSanHistory().back());
                     m_gm.displayBoard();
 
-                    // Check for stalemate first
-                    if (m_gm.isStalemate(m_gm.getCurrentTurnColor())) {
-                        std::println("Stalemate! Game is a draw!");
-                        m_gm.getPgn().writeResult("1/2-1/2 (Stalemate)");
-                        break;
-                    }
-
-                    // check if game is over
-                    if (m_gm.isCheckmate(m_gm.getCurrentTurnColor())) {
-                        std::string winner = (m_gm.getCurrentTurnColor() == PieceColor::BLACK) ? "White" : "Black";
-                        std::println("game gver - checkmate! {0} wins!", winner);
-                        break;  // exit game loop on checkmate
-                    }
-
-                    // check for insufficient material draw
-                    if (m_gm.hasInsufficientMaterial())
-                    {
-                        std::println("draw by insufficient material!");
-                        m_gm.getPgn().writeResult("1/2-1/2 (draw by insufficient material)");
+                    // one status for the new position answers every end-of-game question
+                    if (finishGame(m_gm.evaluateStatus()))
                         break;
-                    }
-
-                    if (m_gm.isKingInCheck(m_gm.getCurrentTurnColor()))
+                    if (m_gm.isInCheck())
                         std::println("CHECK!");
-
-                    if (m_gm.isCheckmate(m_gm.getCurrentTurnColor()))
-                    {
-                        std::string winner = (m_gm.getCurrentTurnColor() == PieceColor::BLACK) ? "White" : "Black";
-                        std::println("checkmate! {0} wins!", winner);
-                        m_gm.getPgn().writeResult(winner == "White" ? "1-0" : "0-1");
-                        break;
-                    }
+                }
+                else if (outcome == MoveOutcome::NO_PIECE)
+                {
+                    throw std::runtime_error("no piece found at the given position");
+                }
+                else if (outcome == MoveOutcome::WRONG_TURN)
+                {
+                    std::println("it's not {0}'s turn", (m_gm.getCurrentTurnColor() == PieceColor::WHITE) ? "black" : "white");
+                }
+                else if (outcome == MoveOutcome::EXPOSES_KING)
+                {
+                    std::println("This move would leave/place your king in check!");
+                }
+                else
+                {
+                    std::println("invalid move for {0}\n", m_gm.getBoard().getPieceAt(from)->getFullSymbol());
                 }
             }
             else
@@ -221,15 +370,128 @@ void Chess::run()
             m_gm.displayBoard();
         }
     }
+
+    // the catalog must not point at a game file that is still queued
+    m_writer.flush();
+    // a session that decided nothing keeps the result of the game it imported, as its export does
+    std::string resultText = m_gm.getPgn().getResult();
+    const auto &tags = m_gm.getTags();
+    auto resultTag = std::find_if(tags.begin(), tags.end(), [](const auto &tag) { return tag.first == "Result"; });
+    if (resultText.empty() && resultTag != tags.end())
+        resultText = resultTag->second;
+    GameResult result = GameArchive::parseResult(resultText);
+    indexGame(m_gm.getPgn().getFileName(), result);
+    catalogGame(result);
+}
+
+PieceType Chess::askPromotion()
+{
+    std::string input;
+    std::cout << "promote pawn to (Q/R/B/N): ";
+    std::getline(std::cin, input);
+    while (input.empty() || std::string("QRBN").find(std::toupper(input[0])) == std::string::npos)
+    {
+        // the console is gone, so there is no one left to answer
+        if (!std::cin)
+            throw std::runtime_error("no promotion piece given");
+        std::cout << "invalid input. promote pawn to (Q/R/B/N): ";
+        std::getline(std::cin, input);
+    }
+
+    switch (std::toupper(input[0]))
+    {
+    case 'R':
+        return PieceType::ROOK;
+    case 'B':
+        return PieceType::BISHOP;
+    case 'N':
+        return PieceType::KNIGHT;
+    default:
+        return PieceType::QUEEN;
+    }
+}
+
+bool Chess::finishGame(GameStatus status)
+{
+    switch (status)
+    {
+    case GameStatus::CHECKMATE:
+    {
+        std::string winner = (m_gm.getCurrentTurnColor() == PieceColor::BLACK) ? "White" : "Black";
+        std::println("checkmate! {0} wins!", winner);
+        m_gm.getPgn().writeResult(winner == "White" ? "1-0" : "0-1");
+        return true;
+    }
+    case GameStatus::STALEMATE:
+        std::println("Stalemate! Game is a draw!");
+        m_gm.getPgn().writeResult("1/2-1/2 (Stalemate)");
+        return true;
+    case GameStatus::INSUFFICIENT_MATERIAL:
+        std::println("draw by insufficient material!");
+        m_gm.getPgn().writeResult("1/2-1/2 (draw by insufficient material)");
+        return true;
+    case GameStatus::FIFTY_MOVE_RULE:
+        std::println("draw by the 50-move rule!");
+        m_gm.getPgn().writeResult("1/2-1/2 (draw by the 50-move rule)");
+        return true;
+    case GameStatus::THREEFOLD_REPETITION:
+        std::println("draw by threefold repetition!");
+        m_gm.getPgn().writeResult("1/2-1/2 (draw by threefold repetition)");
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Chess::catalogGame(GameResult result)
+{
+    // a session left without a move is no game to list
+    if (m_gm.getMoveHistory().empty())
+        return;
+
+    try
+    {
+        std::filesystem::path file(m_gm.getPgn().getFileName());
+        GameCatalog catalog;
+        catalog.record(file.filename().string(), file.stem().string(), result, m_gm);
+    }
+    catch (const std::exception &e)
+    {
+        std::println("failed to update the game catalog: {}", e.what());
+    }
+}
+
+void Chess::indexGame(const std::string &name, GameResult result)
+{
+    // as for the catalog, a session left without a move is no game
+    if (m_gm.getMoveHistory().empty())
+        return;
+
+    try
+    {
+        PositionIndex index;
+        index.addGame(name, result, m_gm);
+    }
+    catch (const std::exception &e)
+    {
+        std::println("failed to index game: {}", e.what());
+    }
 }
 
 bool GameManager::wouldMoveExposeKingToCheck(const Position &from, const Position &to, PieceColor kingColor) {
     PieceInterface* movingPiece = m_board.getPieceAt(from);
     PieceInterface* capturedPiece = m_board.getPieceAt(to);
+    Position capturedPos = to;
+
+    // en passant takes the pawn beside the destination, not on it
+    if (!capturedPiece && movingPiece->getType() == PieceType::PAWN && from.col != to.col) {
+        capturedPos = Position(to.col, from.row);
+        capturedPiece = m_board.getPieceAt(capturedPos);
+    }
     
     m_board.removePiece(from, false);
     if (capturedPiece) {
-        m_board.removePiece(to, false);
+        m_board.removePiece(capturedPos, false);
     }
     movingPiece->move(to);
     m_board.putPiece(movingPiece);
@@ -246,46 +508,83 @@ bool GameManager::wouldMoveExposeKingToCheck(const Position &from, const Positio
     return wouldBeInCheck;
 }
 
-bool GameManager::movePiece(const Position &from, const Position &to, bool isReplay)
+MoveOutcome GameManager::playMove(const Move &move, bool isReplay)
 {
+    TRACE_SCOPE(TracePhase::MOVE);
+    ALLOC_SCOPE(AllocSubsystem::MOVE);
+    ALLOC_MOVE_SCOPE();
+    const Position &from = move.from;
+    const Position &to = move.to;
     auto *piece = m_board.getPieceAt(from);
 
     if (piece == nullptr) {
-        throw std::runtime_error("no piece found at the given position");
+        return MoveOutcome::NO_PIECE;
     }
 
     if (!isReplay && piece->getColor() != m_currentTurnColor) {
-        std::println("it's not {0}'s turn", (m_currentTurnColor == PieceColor::WHITE) ? "black" : "white");
-        return false;
+        return MoveOutcome::WRONG_TURN;
     }
 
-    if (!isReplay && wouldMoveExposeKingToCheck(from, to, piece->getColor())) {
-        std::println("This move would leave/place your king in check!");
-        return false;
+    bool exposesKing = false;
+    if (!isReplay) {
+        TRACE_SCOPE(TracePhase::KING_SAFETY);
+        exposesKing = wouldMoveExposeKingToCheck(from, to, piece->getColor());
+    }
+    if (exposesKing) {
+        return MoveOutcome::EXPOSES_KING;
     }
 
     // handle castling
     if (piece->getType() == PieceType::KING && std::abs(to.col - from.col) == 2) {
         if (handleCastling(from, to)) {
             m_moveType = MoveType::CASTLE;
+            std::string castleNotation = (to.col > from.col) ? "O-O" : "O-O-O";
             if (!isReplay) {
-                std::string castleNotation = (to.col > from.col) ? "O-O" : "O-O-O";
-                m_pgn.writeTurn(piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, castleNotation);
+                m_pgn.writeTurn(m_fullmove, piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, castleNotation);
             }
             m_currentTurnColor = (m_currentTurnColor == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
             if (m_currentTurnColor == PieceColor::WHITE)
-                turn++;
-            return true;
+                m_fullmove++;
+            m_halfmoveClock++;
+            m_hashHistory.push_back(computeHash());
+            invalidateStatus();
+            if (m_sanHistory.size() == m_moveHistory.size())
+                m_sanHistory.push_back(castleNotation + SanNotation::checkSuffix(*this));
+            m_moveHistory.push_back({from, to});
+            return MoveOutcome::PLAYED;
         }
-        return false;
+        return MoveOutcome::INVALID;
     }
 
     // regular move handling
-    MoveManager mm(&m_pgn);
-    if (!mm.isValidMove(from, to, m_board, *piece))
+    MoveManager mm(m_enPassantSquare);
+    bool valid;
     {
-        std::println("invalid move for {0}\n", piece->getFullSymbol());
-        return false;
+        TRACE_SCOPE(TracePhase::VALIDATE);
+        valid = mm.isValidMove(from, to, m_board, *piece);
+    }
+    if (!valid)
+    {
+        return MoveOutcome::INVALID;
+    }
+
+    // checked before anything changes, so a move missing its piece leaves the game as it was
+    const bool isPromotion = piece->getType() == PieceType::PAWN && (to.row == 1 || to.row == 8);
+    if (isPromotion && move.promotion != PieceType::QUEEN && move.promotion != PieceType::ROOK &&
+        move.promotion != PieceType::BISHOP && move.promotion != PieceType::KNIGHT)
+    {
+        return MoveOutcome::PROMOTION_REQUIRED;
+    }
+
+    // SAN disambiguation needs the position before the move; once replayMove has skipped SAN
+    // the history is out of step and getSanHistory rebuilds it as a whole
+    bool sanInStep = m_sanHistory.size() == m_moveHistory.size();
+    std::string san;
+    if (sanInStep)
+    {
+        TRACE_SCOPE(TracePhase::NOTATION);
+        ALLOC_SCOPE(AllocSubsystem::NOTATION);
+        san = SanNotation::toSan(*this, {from, to});
     }
 
     // handle captures
@@ -301,15 +600,17 @@ bool GameManager::movePiece(const Position &from, const Position &to, bool isRep
             isCapture = true;
             isEnPassant = true;
             Position capturedPawnPos(to.col, from.row);
-            m_board.removePiece(capturedPawnPos);
+            m_board.removePiece(capturedPawnPos, false);
+            countPiece(piece->getColor() == PieceColor::WHITE ? PieceColor::BLACK : PieceColor::WHITE, PieceType::PAWN, capturedPawnPos, -1);
             m_moveType = MoveType::CAPTURE;
         }
     }
 
-    // regular capture
+    // regular capture; the factory owns every piece, so the board only lets go of it
     if (isCapture && !isEnPassant)
     {
-        m_board.removePiece(to);
+        m_board.removePiece(to, false);
+        countPiece(capturedPiece->getColor(), capturedPiece->getType(), to, -1);
         m_moveType = MoveType::CAPTURE;
     }
 
@@ -318,104 +619,278 @@ bool GameManager::movePiece(const Position &from, const Position &to, bool isRep
     piece->move(to);
     m_board.putPiece(piece);
 
-    // only mark pieces as moved after successful regular move
-    if (!isReplay && (piece->getType() == PieceType::KING || piece->getType() == PieceType::ROOK))
-    {
-        m_pgn.markPieceMoved(piece->getType(), piece->getColor(), from.col, false);
-    }
+    updateMoveState(piece->getType(), from, to);
 
     // handle pawn promotion
-    if (piece->getType() == PieceType::PAWN && (to.row == 1 || to.row == 8))
+    PieceType promotionType = PieceType::PAWN;
+    if (isPromotion)
     {
-        PieceType promotionType = handlePromotion(to);
+        promotionType = move.promotion;
+        promotePawn(to, promotionType);
         piece = m_board.getPieceAt(to);
+        countPiece(piece->getColor(), PieceType::PAWN, to, -1);
+        countPiece(piece->getColor(), promotionType, to, 1);
+        san += "=" + promotionTypeToString(promotionType);
         std::string promotionNotation = std::string(1, from.col) + std::to_string(from.row) +
                                         " -> " + std::string(1, to.col) + std::to_string(to.row) +
                                         "=" + promotionTypeToString(promotionType);
         if (!isReplay)
         {
-            m_pgn.writeTurn(piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, promotionNotation);
+            m_pgn.writeTurn(m_fullmove, piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, promotionNotation);
         }
         m_moveType = MoveType::PROMOTION;
     }
     else if (!isReplay)
     {
-        m_pgn.writeTurn(piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, "");
+        m_pgn.writeTurn(m_fullmove, piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, "");
     }
 
     m_currentTurnColor = (m_currentTurnColor == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
     if (m_currentTurnColor == PieceColor::WHITE)
-        turn++;
+        m_fullmove++;
+    m_halfmoveClock = (isCapture || promotionType != PieceType::PAWN || piece->getType() == PieceType::PAWN) ? 0 : m_halfmoveClock + 1;
 
-    PieceColor oppositeColor = (m_currentTurnColor == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
-    if (isKingInCheck(oppositeColor)) {
-        if (isCheckmate(oppositeColor)) {
-            m_pgn.writeTurn(piece->getColor(), piece->getType(), from.col, from.row, to.col, to.row, "");
-            
-            std::string winner = (oppositeColor == PieceColor::BLACK) ? "White" : "Black";
-            std::println("Checkmate! {0} wins!", winner);
-            m_pgn.writeResult(winner == "White" ? "1-0" : "0-1");
-            
-        }
+    m_hashHistory.push_back(computeHash());
+    invalidateStatus();
+    m_moveHistory.push_back({from, to, promotionType});
+    if (sanInStep)
+    {
+        TRACE_SCOPE(TracePhase::NOTATION);
+        ALLOC_SCOPE(AllocSubsystem::NOTATION);
+        m_sanHistory.push_back(san + SanNotation::checkSuffix(*this));
     }
 
-    if (isStalemate(m_currentTurnColor)) {
-        std::println("Stalemate! Game is a draw!");
-        m_pgn.writeResult("1/2-1/2 (Stalemate)");
-        return true;
+    // the end of the game is the caller's to report, through the status cached for this position
+    return MoveOutcome::PLAYED;
+}
+
+bool GameManager::applyMove(const Move &move, bool isReplay)
+{
+    return playMove(move, isReplay) == MoveOutcome::PLAYED;
+}
+
+bool GameManager::isPromotionMove(const Position &from, const Position &to) const
+{
+    const PieceInterface *piece = m_board.getPieceAt(from);
+    return piece && piece->getType() == PieceType::PAWN && (to.row == 1 || to.row == 8);
+}
+
+bool GameManager::replayMove(const Move &move)
+{
+    ALLOC_SCOPE(AllocSubsystem::MOVE);
+    ALLOC_MOVE_SCOPE();
+    PieceInterface *piece = m_board.getPieceAt(move.from);
+    if (!piece || piece->getColor() != m_currentTurnColor)
+        return false;
+
+    PieceInterface *capturedPiece = m_board.getPieceAt(move.to);
+    if (capturedPiece && (capturedPiece->getColor() == piece->getColor() || capturedPiece->getType() == PieceType::KING))
+        return false;
+
+    const PieceType type = piece->getType();
+    const PieceColor color = piece->getColor();
+    m_moveType = capturedPiece ? MoveType::CAPTURE : MoveType::MOVE;
+
+    // the hash is updated by what changes instead of being recomputed from all 64 squares
+    uint64_t hash = m_hashHistory.empty() ? computeHash() : m_hashHistory.back();
+    const int castlingRights = getCastlingRights();
+    const char enPassantFile = getEnPassantFile();
+    hash ^= Zobrist::piece(color, type, move.from);
+
+    if (type == PieceType::KING && std::abs(move.to.col - move.from.col) == 2)
+    {
+        Position rookFrom(move.to.col > move.from.col ? 'h' : 'a', move.from.row);
+        Position rookTo(move.to.col > move.from.col ? 'f' : 'd', move.from.row);
+        PieceInterface *rook = m_board.getPieceAt(rookFrom);
+        if (capturedPiece || !rook || rook->getType() != PieceType::ROOK || rook->getColor() != color)
+            return false;
+
+        m_board.removePiece(rookFrom, false);
+        rook->move(rookTo);
+        m_board.putPiece(rook);
+        hash ^= Zobrist::piece(color, PieceType::ROOK, rookFrom) ^ Zobrist::piece(color, PieceType::ROOK, rookTo);
+        m_moveType = MoveType::CASTLE;
+    }
+    else if (type == PieceType::PAWN && move.from.col != move.to.col && !capturedPiece)
+    {
+        // a diagonal pawn step onto an empty square can only be en passant
+        Position passedPawn(move.to.col, move.from.row);
+        capturedPiece = m_board.getPieceAt(passedPawn);
+        if (!capturedPiece || capturedPiece->getType() != PieceType::PAWN || capturedPiece->getColor() == color)
+            return false;
+        m_board.removePiece(passedPawn, false);
+        countPiece(capturedPiece->getColor(), PieceType::PAWN, passedPawn, -1);
+        hash ^= Zobrist::piece(capturedPiece->getColor(), PieceType::PAWN, passedPawn);
+        m_moveType = MoveType::CAPTURE;
     }
+    else if (capturedPiece)
+    {
+        m_board.removePiece(move.to, false);
+        countPiece(capturedPiece->getColor(), capturedPiece->getType(), move.to, -1);
+        hash ^= Zobrist::piece(capturedPiece->getColor(), capturedPiece->getType(), move.to);
+    }
+
+    m_board.removePiece(move.from, false);
+    piece->move(move.to);
+    m_board.putPiece(piece);
+
+    updateMoveState(type, move.from, move.to);
 
+    // the piece comes from the move itself, a missing one means a queen
+    PieceType promotionType = PieceType::PAWN;
+    if (type == PieceType::PAWN && (move.to.row == 1 || move.to.row == 8))
+    {
+        promotionType = (move.promotion != PieceType::PAWN) ? move.promotion : PieceType::QUEEN;
+        m_board.removePiece(move.to, false);
+        m_board.putPiece(m_factory.createAndStorePiece(promotionType, move.to, color));
+        countPiece(color, PieceType::PAWN, move.to, -1);
+        countPiece(color, promotionType, move.to, 1);
+        m_moveType = MoveType::PROMOTION;
+    }
+    hash ^= Zobrist::piece(color, promotionType == PieceType::PAWN ? type : promotionType, move.to);
+
+    m_currentTurnColor = (color == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
+    if (m_currentTurnColor == PieceColor::WHITE)
+        m_fullmove++;
+    m_halfmoveClock = (capturedPiece || type == PieceType::PAWN) ? 0 : m_halfmoveClock + 1;
+
+    hash ^= Zobrist::blackToMove();
+    const int changedRights = castlingRights ^ getCastlingRights();
+    for (int right = 0; right < 4; right++)
+    {
+        if (changedRights & (1 << right))
+            hash ^= Zobrist::castling(right);
+    }
+    if (enPassantFile)
+        hash ^= Zobrist::enPassant(enPassantFile);
+    if (char file = getEnPassantFile())
+        hash ^= Zobrist::enPassant(file);
+
+    m_moveHistory.push_back({move.from, move.to, promotionType});
+    m_hashHistory.push_back(hash);
+    invalidateStatus();
     return true;
 }
 
-bool GameManager::handleCastling(const Position &from, const Position &to)
+GameStatus GameManager::evaluateStatus()
+{
+    if (m_status)
+        return *m_status;
+    TRACE_SCOPE(TracePhase::STATUS);
+    ALLOC_SCOPE(AllocSubsystem::STATUS);
+
+    // mate on the move that completes the 100th ply still counts, so it is looked at first
+    // hints already worked out every legal move, otherwise finding a single one is enough
+    const bool canMove = m_destinations ? std::ranges::any_of(*m_destinations, [](uint64_t targets)
+                                                              { return targets != 0; })
+                                        : hasLegalMoves(m_currentTurnColor);
+    if (!canMove)
+        m_status = isInCheck() ? GameStatus::CHECKMATE : GameStatus::STALEMATE;
+    else if (hasInsufficientMaterial())
+        m_status = GameStatus::INSUFFICIENT_MATERIAL;
+    else if (isFiftyMoveDraw())
+        m_status = GameStatus::FIFTY_MOVE_RULE;
+    else if (isThreefoldRepetition())
+        m_status = GameStatus::THREEFOLD_REPETITION;
+    else
+        m_status = GameStatus::ONGOING;
+    return *m_status;
+}
+
+bool GameManager::isInCheck()
+{
+    if (!m_inCheck)
+        m_inCheck = isKingInCheck(m_currentTurnColor);
+    return *m_inCheck;
+}
+
+const std::vector<std::string> &GameManager::getSanHistory()
+{
+    if (m_sanHistory.size() == m_moveHistory.size())
+        return m_sanHistory;
+
+    // replay on a scratch game from the same start; playMove works out SAN and check marks on the way
+    PieceFactory factory;
+    GameManager scratch(factory);
+    if (m_startFen.empty())
+        scratch.resetGame();
+    else
+        FenNotation::fromFen(scratch, m_startFen);
+    for (const Move &move : m_moveHistory)
+    {
+        // trusted moves, and the scratch game has no file to write them to
+        if (!scratch.applyMove(move, true))
+            break;
+    }
+    m_sanHistory = scratch.m_sanHistory;
+    return m_sanHistory;
+}
+
+bool GameManager::canCastle(const Position &from, const Position &to) const
 {
     auto *king = m_board.getPieceAt(from);
-    if (!king || king->getType() != PieceType::KING) {
+    if (!king || king->getType() != PieceType::KING || from.row != to.row || std::abs(to.col - from.col) != 2) {
         return false;
     }
 
+    int right = (king->getColor() == PieceColor::WHITE ? 0 : 2) + (to.col > from.col ? 0 : 1);
     if (from.col != 'e' ||
         (king->getColor() == PieceColor::WHITE && from.row != 1) ||
         (king->getColor() == PieceColor::BLACK && from.row != 8) ||
-        m_pgn.hasPieceMoved(PieceType::KING, king->getColor(), from.col)) {
+        !(m_castlingRights & (1 << right))) {
         return false;
     }
 
     char rookCol = (to.col > from.col) ? 'h' : 'a';
-    char newRookCol = (to.col > from.col) ? 'f' : 'd';
-    Position rookPos(rookCol, from.row);
-    auto *rook = m_board.getPieceAt(rookPos);
+    auto *rook = m_board.getPieceAt(Position(rookCol, from.row));
 
-    if (!rook || rook->getType() != PieceType::ROOK ||
-        m_pgn.hasPieceMoved(PieceType::ROOK, king->getColor(), rookCol)) {
+    if (!rook || rook->getType() != PieceType::ROOK || rook->getColor() != king->getColor()) {
         return false;
     }
 
+    // every square between king and rook must be empty
     int step = (to.col > from.col) ? 1 : -1;
     for (char col = from.col + step; col != rookCol; col += step) {
-        if (m_board.getPieceAt(Position(col, from.row)) ||
-            isSquareUnderAttack(Position(col, from.row), king->getColor())) {
+        if (m_board.getPieceAt(Position(col, from.row))) {
             return false;
         }
     }
 
+    // the king may not castle out of, through or into check
+    for (char col = from.col; col != to.col + step; col += step) {
+        if (isSquareUnderAttack(Position(col, from.row), king->getColor())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GameManager::handleCastling(const Position &from, const Position &to)
+{
+    if (!canCastle(from, to)) {
+        return false;
+    }
+
+    auto *king = m_board.getPieceAt(from);
+    char rookCol = (to.col > from.col) ? 'h' : 'a';
+    char newRookCol = (to.col > from.col) ? 'f' : 'd';
+    Position rookPos(rookCol, from.row);
+    auto *rook = m_board.getPieceAt(rookPos);
+
     m_board.removePiece(from, false);
     m_board.removePiece(rookPos, false);
     king->move(to);
     rook->move(Position(newRookCol, from.row));
     m_board.putPiece(king);
     m_board.putPiece(rook);
-
-    m_pgn.markPieceMoved(PieceType::KING, king->getColor(), from.col, false);
-    m_pgn.markPieceMoved(PieceType::ROOK, king->getColor(), rookCol, false);
+    updateMoveState(PieceType::KING, from, to);
 
     return true;
 }
 
 bool GameManager::isSquareUnderAttack(const Position &pos, PieceColor defendingColor) const
 {
-    MoveManager mm(&m_pgn);
+    MoveManager mm(m_enPassantSquare);
     for (int row = 1; row <= 8; row++)
     {
         for (char col = 'a'; col <= 'h'; col++)
@@ -424,6 +899,14 @@ bool GameManager::isSquareUnderAttack(const Position &pos, PieceColor defendingC
             PieceInterface *attacker = m_board.getPieceAt(from);
             if (attacker && attacker->getColor() != defendingColor)
             {
+                // pawns only attack diagonally, whether or not the square is occupied
+                if (attacker->getType() == PieceType::PAWN)
+                {
+                    int direction = attacker->getColor() == PieceColor::WHITE ? 1 : -1;
+                    if (pos.row == row + direction && std::abs(pos.col - col) == 1)
+                        return true;
+                    continue;
+                }
                 if (mm.isValidMove(from, pos, m_board, *attacker))
                     return true;
             }
@@ -452,11 +935,12 @@ bool GameManager::isKingInCheck(PieceColor color) const
 
 bool GameManager::isCheckmate(PieceColor color)
 {
+    TRACE_SCOPE(TracePhase::CHECKMATE);
     if (!isKingInCheck(color)) {
         return false;
     }
 
-    MoveManager mm(&m_pgn);
+    MoveManager mm(m_enPassantSquare);
     
     for (int fromRow = 1; fromRow <= 8; fromRow++) {
         for (char fromCol = 'a'; fromCol <= 'h'; fromCol++) {
@@ -537,6 +1021,15 @@ bool GameManager::isFirstMove(const PieceInterface *piece)
 
 void GameManager::setupBoard()
 {
+    m_moveHistory.clear();
+    m_sanHistory.clear();
+    m_halfmoveClock = 0;
+    m_fullmove = 1;
+    m_castlingRights = 0b1111;
+    m_enPassantSquare = noSquare;
+    m_startFen.clear();
+    m_tags.clear();
+
     for (char col = 'a'; col <= 'h'; col++)
     {
         m_board.putPiece(m_factory.createAndStorePiece(PieceType::PAWN, Position(col, 2), PieceColor::WHITE));
@@ -559,6 +1052,127 @@ void GameManager::setupBoard()
         m_board.putPiece(m_factory.createAndStorePiece(pieces[i], Position('a' + i, 1), PieceColor::WHITE));
         m_board.putPiece(m_factory.createAndStorePiece(pieces[i], Position('a' + i, 8), PieceColor::BLACK));
     }
+
+    recountMaterial();
+    m_hashHistory.clear();
+    m_hashHistory.push_back(computeHash());
+    invalidateStatus();
+}
+
+/// @brief puts the starting position back; the factory's pieces are released, so it must serve this game only
+void GameManager::resetGame()
+{
+    m_board.clear();
+    m_factory.releasePieces();
+    m_currentTurnColor = PieceColor::WHITE;
+    m_moveType = MoveType::MOVE;
+    setupBoard();
+}
+
+/// @brief Zobrist hash of the full position: pieces, side to move, castling rights and en passant file
+uint64_t GameManager::computeHash() const
+{
+    uint64_t hash = 0;
+    for (int row = 1; row <= 8; row++)
+    {
+        for (char col = 'a'; col <= 'h'; col++)
+        {
+            PieceInterface *piece = m_board.getPieceAt(Position(col, row));
+            if (piece)
+                hash ^= Zobrist::piece(piece->getColor(), piece->getType(), piece->getPosition());
+        }
+    }
+
+    if (m_currentTurnColor == PieceColor::BLACK)
+        hash ^= Zobrist::blackToMove();
+
+    int castlingRights = getCastlingRights();
+    for (int right = 0; right < 4; right++)
+    {
+        if (castlingRights & (1 << right))
+            hash ^= Zobrist::castling(right);
+    }
+
+    if (char file = getEnPassantFile())
+        hash ^= Zobrist::enPassant(file);
+    return hash;
+}
+
+char GameManager::getEnPassantFile() const
+{
+    // the file only matters when a pawn is actually there to take
+    if (m_enPassantSquare == noSquare)
+        return 0;
+
+    const char file = static_cast<char>('a' + m_enPassantSquare % 8);
+    const int pawnRow = (m_currentTurnColor == PieceColor::WHITE) ? 5 : 4;
+    for (int side : {-1, 1})
+    {
+        char col = file + side;
+        if (col < 'a' || col > 'h')
+            continue;
+        PieceInterface *pawn = m_board.getPieceAt(Position(col, pawnRow));
+        if (pawn && pawn->getType() == PieceType::PAWN && pawn->getColor() == m_currentTurnColor)
+            return file;
+    }
+    return 0;
+}
+
+void GameManager::updateMoveState(PieceType type, const Position &from, const Position &to)
+{
+    // a king or rook leaving its home square, or a rook captured on it, takes the rights tied to that square
+    for (const Position &square : {from, to})
+    {
+        if ((square.row == 1 || square.row == 8) && (square.col == 'e' || square.col == 'a' || square.col == 'h'))
+        {
+            int side = (square.row == 1) ? 0 : 2;
+            int lost = (square.col == 'e') ? 0b11 : (square.col == 'h' ? 0b01 : 0b10);
+            m_castlingRights &= ~(lost << side);
+        }
+    }
+
+    m_enPassantSquare = (type == PieceType::PAWN && std::abs(to.row - from.row) == 2)
+                            ? squareIndex(Position(from.col, (from.row + to.row) / 2))
+                            : noSquare;
+}
+
+void GameManager::setupPosition(const std::vector<PlacedPiece> &pieces, PieceColor toMove, int castlingRights,
+                                char enPassantFile, int halfmoveClock, int fullmove)
+{
+    m_board.clear();
+    m_factory.releasePieces();
+    m_moveType = MoveType::MOVE;
+    m_moveHistory.clear();
+    m_sanHistory.clear();
+    m_startFen.clear();
+    m_tags.clear();
+
+    for (const PlacedPiece &piece : pieces)
+        m_board.putPiece(m_factory.createAndStorePiece(piece.type, piece.position, piece.color));
+
+    m_currentTurnColor = toMove;
+    m_halfmoveClock = halfmoveClock;
+    m_fullmove = fullmove;
+
+    // a right only counts while king and rook are both on their home squares
+    m_castlingRights = 0;
+    for (int right = 0; right < 4; right++)
+    {
+        PieceColor color = (right < 2) ? PieceColor::WHITE : PieceColor::BLACK;
+        int row = (color == PieceColor::WHITE) ? 1 : 8;
+        PieceInterface *king = m_board.getPieceAt(Position('e', row));
+        PieceInterface *rook = m_board.getPieceAt(Position(right % 2 ? 'a' : 'h', row));
+        if ((castlingRights & (1 << right)) && king && king->getType() == PieceType::KING && king->getColor() == color &&
+            rook && rook->getType() == PieceType::ROOK && rook->getColor() == color)
+            m_castlingRights |= 1 << right;
+    }
+
+    m_enPassantSquare = enPassantFile ? squareIndex(Position(enPassantFile, toMove == PieceColor::WHITE ? 6 : 3)) : noSquare;
+
+    recountMaterial();
+    m_hashHistory.clear();
+    m_hashHistory.push_back(computeHash());
+    invalidateStatus();
 }
 
 void GameManager::displayBoard() const
@@ -585,123 +1199,89 @@ std::string GameManager::promotionTypeToString(PieceType type) const
 
 bool GameManager::hasInsufficientMaterial() const
 {
-    // case 1: only kings
-    if (hasOnlyKing(PieceColor::WHITE) && hasOnlyKing(PieceColor::BLACK))
+    for (PieceType type : {PieceType::PAWN, PieceType::ROOK, PieceType::QUEEN})
     {
-        return true;
+        if (getPieceCount(PieceColor::WHITE, type) || getPieceCount(PieceColor::BLACK, type))
+            return false;
     }
 
-    // case 2: king and minor piece (knight and bishop) vs king
-    if ((hasOnlyKing(PieceColor::WHITE) && hasOnlyKingAndMinorPiece(PieceColor::BLACK)) ||
-        (hasOnlyKing(PieceColor::BLACK) && hasOnlyKingAndMinorPiece(PieceColor::WHITE)))
-    {
+    const int knights = getPieceCount(PieceColor::WHITE, PieceType::KNIGHT) + getPieceCount(PieceColor::BLACK, PieceType::KNIGHT);
+    const int bishops = getPieceCount(PieceColor::WHITE, PieceType::BISHOP) + getPieceCount(PieceColor::BLACK, PieceType::BISHOP);
+
+    // bare kings, or king and one minor piece against king
+    if (knights + bishops <= 1)
         return true;
-    }
 
-    return false;
+    // bishops that all stand on one square color can never attack the other, so no mate is possible
+    const int lightBishops = m_bishopShades[0][0] + m_bishopShades[1][0];
+    return knights == 0 && (lightBishops == 0 || lightBishops == bishops);
 }
 
 bool GameManager::hasOnlyKing(PieceColor color) const
 {
-    int pieceCount = 0;
-    bool hasKing = false;
+    const auto &counts = m_material[static_cast<int>(color)];
+    return counts[static_cast<int>(PieceType::KING)] == 1 &&
+           std::accumulate(counts.begin(), counts.end(), 0) == 1;
+}
 
-    for (int row = 1; row <= 8; row++)
+bool GameManager::hasOnlyKingAndMinorPiece(PieceColor color) const
+{
+    const auto &counts = m_material[static_cast<int>(color)];
+    return counts[static_cast<int>(PieceType::KING)] == 1 &&
+           getPieceCount(color, PieceType::BISHOP) + getPieceCount(color, PieceType::KNIGHT) == 1 &&
+           std::accumulate(counts.begin(), counts.end(), 0) == 2;
+}
+
+bool GameManager::isThreefoldRepetition() const
+{
+    // only positions since the last capture or pawn move can come back, and only with the same side to move
+    const size_t window = std::min<size_t>(m_halfmoveClock, m_hashHistory.size() - 1);
+    if (window < 8)
+        return false;
+
+    const uint64_t current = m_hashHistory.back();
+    int seen = 1;
+    for (size_t back = 4; back <= window; back += 2)
     {
-        for (char col = 'a'; col <= 'h'; col++)
-        {
-            PieceInterface *piece = m_board.getPieceAt(Position(col, row));
-            if (piece && piece->getColor() == color)
-            {
-                pieceCount++;
-                if (piece->getType() == PieceType::KING)
-                {
-                    hasKing = true;
-                }
-            }
-        }
+        if (m_hashHistory[m_hashHistory.size() - 1 - back] == current && ++seen == 3)
+            return true;
     }
-
-    return hasKing && pieceCount == 1;
+    return false;
 }
 
-bool GameManager::hasOnlyKingAndMinorPiece(PieceColor color) const
+void GameManager::countPiece(PieceColor color, PieceType type, const Position &pos, int delta)
 {
-    int pieceCount = 0;
-    bool hasKing = false;
-    bool hasMinorPiece = false;
+    m_material[static_cast<int>(color)][static_cast<int>(type)] += delta;
+    if (type == PieceType::BISHOP)
+        m_bishopShades[static_cast<int>(color)][(pos.col - 'a' + pos.row) % 2] += delta;
+}
 
+void GameManager::recountMaterial()
+{
+    m_material = {};
+    m_bishopShades = {};
     for (int row = 1; row <= 8; row++)
     {
         for (char col = 'a'; col <= 'h'; col++)
         {
-            PieceInterface *piece = m_board.getPieceAt(Position(col, row));
-            if (piece && piece->getColor() == color)
-            {
-                pieceCount++;
-                if (piece->getType() == PieceType::KING)
-                {
-                    hasKing = true;
-                }
-                else if (piece->getType() == PieceType::BISHOP ||
-                         piece->getType() == PieceType::KNIGHT)
-                {
-                    hasMinorPiece = true;
-                }
-            }
+            if (PieceInterface *piece = m_board.getPieceAt(Position(col, row)))
+                countPiece(piece->getColor(), piece->getType(), piece->getPosition(), 1);
         }
     }
-
-    return hasKing && hasMinorPiece && pieceCount == 2;
 }
 
 const Board &GameManager::getBoard() const { return m_board; }
 
-PieceType GameManager::handlePromotion(const Position &pos)
+void GameManager::promotePawn(const Position &pos, PieceType type)
 {
-    m_promotionFlag = true;
-    char promotion;
-    std::string input;
-
-    std::cout << "promote pawn to (Q/R/B/N): ";
-    std::getline(std::cin, input);
-    while (input.empty() || std::string("QRBN").find(std::toupper(input[0])) == std::string::npos)
-    {
-        std::cout << "invalid input. promote pawn to (Q/R/B/N): ";
-        std::getline(std::cin, input);
-    }
-    promotion = std::toupper(input[0]);
-
     PieceColor color = m_board.getPieceAt(pos)->getColor();
-    m_board.removePiece(pos, true);
-
-    PieceType newType;
-    switch (promotion)
-    {
-    case 'Q':
-        newType = PieceType::QUEEN;
-        break;
-    case 'R':
-        newType = PieceType::ROOK;
-        break;
-    case 'B':
-        newType = PieceType::BISHOP;
-        break;
-    case 'N':
-        newType = PieceType::KNIGHT;
-        break;
-    default:
-        newType = PieceType::QUEEN;
-        break; 
-    }
-
-    PieceInterface *newPiece = m_factory.createAndStorePiece(newType, pos, color);
+    m_board.removePiece(pos, false);
+    PieceInterface *newPiece = m_factory.createAndStorePiece(type, pos, color);
     m_board.putPiece(newPiece);
-    return newType;
 }
 
 bool GameManager::hasLegalMoves(PieceColor color) {
-    MoveManager mm(&m_pgn);
+    MoveManager mm(m_enPassantSquare);
     
     for (int fromRow = 1; fromRow <= 8; fromRow++) {
         for (char fromCol = 'a'; fromCol <= 'h'; fromCol++) {
@@ -730,6 +1310,81 @@ bool GameManager::hasLegalMoves(PieceColor color) {
     return false; 
 }
 
+const std::array<uint64_t, 64> &GameManager::getLegalDestinations()
+{
+    if (!m_destinations)
+    {
+        std::array<uint64_t, 64> destinations{};
+        for (const Move &move : generateLegalMoves(m_currentTurnColor))
+            destinations[squareIndex(move.from)] |= uint64_t{1} << squareIndex(move.to);
+        m_destinations = destinations;
+    }
+    return *m_destinations;
+}
+
+std::vector<Move> GameManager::generateLegalMoves(PieceColor color)
+{
+    std::vector<Move> moves;
+    MoveManager mm(m_enPassantSquare);
+    const std::array<PieceType, 4> promotions = {PieceType::QUEEN, PieceType::ROOK, PieceType::BISHOP, PieceType::KNIGHT};
+
+    for (int fromRow = 1; fromRow <= 8; fromRow++) {
+        for (char fromCol = 'a'; fromCol <= 'h'; fromCol++) {
+            Position from(fromCol, fromRow);
+            PieceInterface* piece = m_board.getPieceAt(from);
+
+            if (!piece || piece->getColor() != color) {
+                continue;
+            }
+
+            if (piece->getType() == PieceType::KING && fromCol == 'e') {
+                for (char toCol : {'c', 'g'}) {
+                    if (canCastle(from, Position(toCol, fromRow))) {
+                        moves.push_back({from, Position(toCol, fromRow)});
+                    }
+                }
+            }
+
+            for (int toRow = 1; toRow <= 8; toRow++) {
+                for (char toCol = 'a'; toCol <= 'h'; toCol++) {
+                    Position to(toCol, toRow);
+
+                    if (!mm.isValidMove(from, to, m_board, *piece) ||
+                        wouldMoveExposeKingToCheck(from, to, color)) {
+                        continue;
+                    }
+
+                    if (piece->getType() == PieceType::PAWN && (toRow == 1 || toRow == 8)) {
+                        for (PieceType type : promotions) {
+                            moves.push_back({from, to, type});
+                        }
+                    } else {
+                        moves.push_back({from, to});
+                    }
+                }
+            }
+        }
+    }
+    return moves;
+}
+
+bool GameManager::isLegalMove(const Move &move)
+{
+    PieceInterface* piece = m_board.getPieceAt(move.from);
+    if (!piece || piece->getColor() != m_currentTurnColor) {
+        return false;
+    }
+
+    if (piece->getType() == PieceType::KING && std::abs(move.to.col - move.from.col) == 2) {
+        return canCastle(move.from, move.to);
+    }
+
+    MoveManager mm(m_enPassantSquare);
+    return mm.isValidMove(move.from, move.to, m_board, *piece) &&
+           !wouldMoveExposeKingToCheck(move.from, move.to, piece->getColor());
+}
+
 bool GameManager::isStalemate(PieceColor color) {
+    TRACE_SCOPE(TracePhase::STALEMATE);
     return !isKingInCheck(color) && !hasLegalMoves(color);
 }
@@ -1,6 +1,14 @@
 #include "classes.h"
 #include "factory.h"
 
+namespace
+{
+    size_t releasedSlot(PieceType type, PieceColor color)
+    {
+        return static_cast<size_t>(type) * 2 + (color == PieceColor::WHITE ? 0 : 1);
+    }
+}
+
 PieceFactory::PieceFactory()
 {
     m_creators[PieceType::PAWN] = [](const Position &pos, const PieceColor &color)
@@ -35,10 +43,33 @@ PieceFactory::~PieceFactory()
     {
         delete piece;
     }
+    for (const auto &released : m_released)
+    {
+        for (auto piece : released)
+            delete piece;
+    }
+}
+
+void PieceFactory::releasePieces()
+{
+    // the list nodes move along with the pieces, so neither side allocates
+    while (!m_pieces.empty())
+    {
+        auto &released = m_released[releasedSlot(m_pieces.front()->getType(), m_pieces.front()->getColor())];
+        released.splice(released.end(), m_pieces, m_pieces.begin());
+    }
 }
 
 PieceInterface *PieceFactory::createAndStorePiece(const PieceType &type, const Position &position, const PieceColor &color)
 {
+    auto &released = m_released[releasedSlot(type, color)];
+    if (!released.empty())
+    {
+        m_pieces.splice(m_pieces.end(), released, released.begin());
+        m_pieces.back()->move(position);
+        return m_pieces.back();
+    }
+
     auto it = m_creators.find(type);
     if (it != m_creators.end())
     {
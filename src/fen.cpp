@@ -0,0 +1,287 @@
+#include "classes.h"
+#include "fen.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+namespace
+{
+    constexpr char castlingSymbols[4] = {'K', 'Q', 'k', 'q'};
+
+    std::string_view nextField(std::string_view &text)
+    {
+        size_t start = 0;
+        while (start < text.size() && std::isspace(static_cast<unsigned char>(text[start])))
+            start++;
+        size_t end = start;
+        while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])))
+            end++;
+        std::string_view field = text.substr(start, end - start);
+        text.remove_prefix(end);
+        return field;
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+            text.remove_prefix(1);
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+            text.remove_suffix(1);
+        return text;
+    }
+
+    int parseCounter(std::string_view text, const char *name)
+    {
+        int value = 0;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc() || end != text.data() + text.size() || value < 0)
+            throw std::invalid_argument(std::string("invalid ") + name + " '" + std::string(text) + "'");
+        return value;
+    }
+
+    char pieceSymbol(const PieceInterface &piece)
+    {
+        char symbol = 'p';
+        switch (piece.getType())
+        {
+        case PieceType::KING:
+            symbol = 'k';
+            break;
+        case PieceType::QUEEN:
+            symbol = 'q';
+            break;
+        case PieceType::ROOK:
+            symbol = 'r';
+            break;
+        case PieceType::BISHOP:
+            symbol = 'b';
+            break;
+        case PieceType::KNIGHT:
+            symbol = 'n';
+            break;
+        default:
+            break;
+        }
+        return piece.getColor() == PieceColor::WHITE ? static_cast<char>(std::toupper(symbol)) : symbol;
+    }
+
+    PieceType pieceTypeFromSymbol(char symbol)
+    {
+        switch (std::tolower(static_cast<unsigned char>(symbol)))
+        {
+        case 'k':
+            return PieceType::KING;
+        case 'q':
+            return PieceType::QUEEN;
+        case 'r':
+            return PieceType::ROOK;
+        case 'b':
+            return PieceType::BISHOP;
+        case 'n':
+            return PieceType::KNIGHT;
+        case 'p':
+            return PieceType::PAWN;
+        default:
+            throw std::invalid_argument(std::string("invalid piece '") + symbol + "'");
+        }
+    }
+
+    /// @brief sets up the four position fields shared by FEN and EPD
+    void setPosition(GameManager &gm, std::string_view placement, std::string_view side, std::string_view castling,
+                     std::string_view enPassant, int halfmoveClock, int fullmove)
+    {
+        std::vector<PlacedPiece> pieces;
+        pieces.reserve(32);
+        int kings[2] = {0, 0};
+        int row = 8;
+        char col = 'a';
+        for (char c : placement)
+        {
+            if (c == '/')
+            {
+                if (col != 'a' + 8 || row == 1)
+                    throw std::invalid_argument("rank " + std::to_string(row) + " does not have 8 squares");
+                row--;
+                col = 'a';
+            }
+            else if (c >= '1' && c <= '8')
+                col += c - '0';
+            else
+            {
+                PieceType type = pieceTypeFromSymbol(c);
+                PieceColor color = std::isupper(static_cast<unsigned char>(c)) ? PieceColor::WHITE : PieceColor::BLACK;
+                if (col > 'h')
+                    throw std::invalid_argument("rank " + std::to_string(row) + " does not have 8 squares");
+                if (type == PieceType::PAWN && (row == 1 || row == 8))
+                    throw std::invalid_argument("pawn on the first or last rank");
+                if (type == PieceType::KING)
+                    kings[color == PieceColor::WHITE ? 0 : 1]++;
+                pieces.push_back({type, color, Position(col, row)});
+                col++;
+            }
+            if (col > 'a' + 8)
+                throw std::invalid_argument("rank " + std::to_string(row) + " does not have 8 squares");
+        }
+        if (row != 1 || col != 'a' + 8)
+            throw std::invalid_argument("placement does not have 8 ranks of 8 squares");
+        if (kings[0] != 1 || kings[1] != 1)
+            throw std::invalid_argument("each side needs exactly one king");
+
+        if (side != "w" && side != "b")
+            throw std::invalid_argument("side to move must be 'w' or 'b'");
+        PieceColor toMove = (side == "w") ? PieceColor::WHITE : PieceColor::BLACK;
+
+        int castlingRights = 0;
+        if (castling != "-")
+        {
+            for (char c : castling)
+            {
+                int right = 0;
+                while (right < 4 && castlingSymbols[right] != c)
+                    right++;
+                if (right == 4)
+                    throw std::invalid_argument("invalid castling rights '" + std::string(castling) + "'");
+                castlingRights |= 1 << right;
+            }
+        }
+
+        char enPassantFile = 0;
+        if (enPassant != "-")
+        {
+            char expectedRow = (toMove == PieceColor::WHITE) ? '6' : '3';
+            if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' || enPassant[1] != expectedRow)
+                throw std::invalid_argument("invalid en passant square '" + std::string(enPassant) + "'");
+            enPassantFile = enPassant[0];
+        }
+
+        // rights the board does not back up (king or rook missing) are dropped by GameManager itself
+        gm.setupPosition(pieces, toMove, castlingRights, enPassantFile, halfmoveClock, std::max(1, fullmove));
+
+        std::string fen = FenNotation::toFen(gm);
+        gm.setStartFen(fen == FenNotation::startPosition ? "" : fen);
+    }
+
+    std::string positionFields(const GameManager &gm)
+    {
+        std::string fields;
+        for (int row = 8; row >= 1; row--)
+        {
+            int empty = 0;
+            for (char col = 'a'; col <= 'h'; col++)
+            {
+                PieceInterface *piece = gm.getBoard().getPieceAt(Position(col, row));
+                if (!piece)
+                {
+                    empty++;
+                    continue;
+                }
+                if (empty)
+                    fields += static_cast<char>('0' + empty);
+                empty = 0;
+                fields += pieceSymbol(*piece);
+            }
+            if (empty)
+                fields += static_cast<char>('0' + empty);
+            if (row > 1)
+                fields += '/';
+        }
+
+        fields += (gm.getCurrentTurnColor() == PieceColor::WHITE) ? " w " : " b ";
+
+        int castlingRights = gm.getCastlingRights();
+        for (int right = 0; right < 4; right++)
+        {
+            if (castlingRights & (1 << right))
+                fields += castlingSymbols[right];
+        }
+        if (!castlingRights)
+            fields += '-';
+
+        if (char file = gm.getEnPassantFile())
+        {
+            fields += ' ';
+            fields += file;
+            fields += (gm.getCurrentTurnColor() == PieceColor::WHITE) ? '6' : '3';
+        }
+        else
+            fields += " -";
+        return fields;
+    }
+}
+
+std::string FenNotation::toFen(const GameManager &gm)
+{
+    return positionFields(gm) + " " + std::to_string(gm.getHalfmoveClock()) + " " + std::to_string(gm.getFullmoveNumber());
+}
+
+void FenNotation::fromFen(GameManager &gm, std::string_view fen)
+{
+    std::string_view fields[6];
+    for (std::string_view &field : fields)
+        field = nextField(fen);
+    if (fields[3].empty() || !trim(fen).empty())
+        throw std::invalid_argument("a FEN needs 4 to 6 fields");
+
+    int halfmoveClock = fields[4].empty() ? 0 : parseCounter(fields[4], "halfmove clock");
+    int fullmove = fields[5].empty() ? 1 : parseCounter(fields[5], "fullmove number");
+    setPosition(gm, fields[0], fields[1], fields[2], fields[3], halfmoveClock, fullmove);
+}
+
+std::string FenNotation::toEpd(const GameManager &gm, const EpdOperations &operations)
+{
+    std::string epd = positionFields(gm);
+    for (const auto &[opcode, operands] : operations)
+    {
+        epd += ' ' + opcode;
+        if (!operands.empty())
+            epd += ' ' + operands;
+        epd += ';';
+    }
+    return epd;
+}
+
+EpdOperations FenNotation::fromEpd(GameManager &gm, std::string_view epd)
+{
+    std::string_view fields[4];
+    for (std::string_view &field : fields)
+        field = nextField(epd);
+    if (fields[3].empty())
+        throw std::invalid_argument("an EPD needs 4 position fields");
+
+    // every operation runs up to a ';' that is not inside a quoted string
+    EpdOperations operations;
+    epd = trim(epd);
+    while (!epd.empty())
+    {
+        size_t end = 0;
+        bool quoted = false;
+        while (end < epd.size() && (quoted || epd[end] != ';'))
+        {
+            if (epd[end] == '"')
+                quoted = !quoted;
+            end++;
+        }
+        if (end == epd.size())
+            throw std::invalid_argument("EPD operation without terminating ';'");
+
+        std::string_view operation = epd.substr(0, end);
+        std::string_view opcode = nextField(operation);
+        if (!opcode.empty())
+            operations.emplace_back(std::string(opcode), std::string(trim(operation)));
+        epd = trim(epd.substr(end + 1));
+    }
+
+    int halfmoveClock = 0;
+    int fullmove = 1;
+    for (const auto &[opcode, operands] : operations)
+    {
+        if (opcode == "hmvc")
+            halfmoveClock = parseCounter(operands, "hmvc");
+        else if (opcode == "fmvn")
+            fullmove = parseCounter(operands, "fmvn");
+    }
+
+    setPosition(gm, fields[0], fields[1], fields[2], fields[3], halfmoveClock, fullmove);
+    return operations;
+}
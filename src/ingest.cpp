@@ -0,0 +1,223 @@
+#include "classes.h"
+#include "ingest.h"
+#include "archive.h"
+#include "fen.h"
+#include "pgnstream.h"
+#include "posindex.h"
+#include "queue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief a byte range of the mapped file that starts and ends on game boundaries
+    struct Chunk
+    {
+        size_t offset;
+        std::string_view text;
+    };
+
+    struct ParsedGame
+    {
+        size_t offset;
+        /// @brief the FEN tag, empty for a game from the initial position
+        std::string_view fen;
+        std::vector<std::string_view> moves;
+        std::string_view result;
+    };
+
+    using ParsedBatch = std::vector<ParsedGame>;
+}
+
+IngestPipeline::IngestPipeline(IngestOptions options) : m_options(std::move(options))
+{
+    m_options.readers = std::max(1u, m_options.readers);
+    m_options.parsers = std::max(1u, m_options.parsers);
+    m_options.replayers = std::max(1u, m_options.replayers);
+    m_options.chunkSize = std::max<size_t>(4096, m_options.chunkSize);
+}
+
+bool IngestPipeline::replayGame(GameManager &gm, std::string_view fen, const std::vector<std::string_view> &moves,
+                                uint32_t &plies, std::string &error)
+{
+    gm.resetGame();
+    plies = 0;
+    try
+    {
+        if (!fen.empty())
+            FenNotation::fromFen(gm, fen);
+    }
+    catch (const std::exception &e)
+    {
+        error = "FEN tag: " + std::string(e.what());
+        return false;
+    }
+
+    try
+    {
+        for (std::string_view san : moves)
+        {
+            std::optional<Move> move = SanNotation::fromSan(gm, san);
+            if (!move)
+            {
+                error = "ply " + std::to_string(plies + 1) + ": illegal or ambiguous move '" + std::string(san) + "'";
+                return false;
+            }
+            // fromSan only returns legal moves, so the move needs no second check
+            if (!gm.replayMove(*move))
+            {
+                error = "ply " + std::to_string(plies + 1) + ": failed to replay move '" + std::string(san) + "'";
+                return false;
+            }
+            plies++;
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        error = "ply " + std::to_string(plies + 1) + ": " + e.what();
+        return false;
+    }
+}
+
+IngestStats IngestPipeline::run()
+{
+    MappedFile file(m_options.path);
+    if (!file.isMapped())
+        throw std::runtime_error(m_options.path + " is not a regular, non-empty file");
+
+    const std::string_view data = file.getView();
+    const size_t chunkCount = (data.size() + m_options.chunkSize - 1) / m_options.chunkSize;
+    auto depth = [this](unsigned consumers)
+    { return m_options.queueDepth ? m_options.queueDepth : 2 * static_cast<size_t>(consumers); };
+
+    BoundedQueue<Chunk> chunks(depth(m_options.parsers), m_options.readers);
+    BoundedQueue<ParsedBatch> batches(depth(m_options.replayers), m_options.parsers);
+    std::atomic<size_t> nextChunk = 0;
+    std::atomic<size_t> chunksRead = 0;
+    m_records.clear();
+
+    auto start = std::chrono::steady_clock::now();
+
+    // stage 1: every reader claims nominal chunks and widens them to the next game boundaries,
+    // which needs no coordination because both ends are found the same way by neighbouring chunks
+    auto reader = [&]()
+    {
+        const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        for (size_t index = nextChunk++; index < chunkCount; index = nextChunk++)
+        {
+            size_t begin = findPgnGameStart(data, index * m_options.chunkSize);
+            size_t end = findPgnGameStart(data, std::min(data.size(), (index + 1) * m_options.chunkSize));
+            if (begin >= end)
+                continue;
+
+            // fault the pages in here so parsers never stall on disk
+            file.prefetch(begin, end - begin);
+            volatile char sink = 0;
+            for (size_t page = begin; page < end; page += pageSize)
+                sink = sink + data[page];
+
+            chunksRead++;
+            if (!chunks.push({begin, data.substr(begin, end - begin)}))
+                break;
+        }
+        chunks.producerDone();
+    };
+
+    // stage 2: tokenize whole chunks into batches of move lists that still point into the mapping
+    auto parser = [&]()
+    {
+        PgnGameView game;
+        while (auto chunk = chunks.pop())
+        {
+            ParsedBatch batch;
+            PgnTokenizer tokenizer(chunk->text);
+            bool complete = false;
+            size_t before = tokenizer.getPosition();
+            while (scanPgnGame(tokenizer, game, complete))
+            {
+                batch.push_back({chunk->offset + findPgnGameStart(chunk->text, before), game.getTag("FEN"), game.moves, game.result});
+                before = tokenizer.getPosition();
+            }
+            if (!batches.push(std::move(batch)))
+                break;
+        }
+        batches.producerDone();
+    };
+
+    // stage 3: every replayer owns its own game objects, records are merged once at the end
+    auto replayer = [&]()
+    {
+        PieceFactory factory;
+        GameManager gm(factory);
+        std::vector<IngestRecord> records;
+
+        while (auto batch = batches.pop())
+        {
+            for (const ParsedGame &parsed : *batch)
+            {
+                IngestRecord record;
+                record.offset = parsed.offset;
+                record.result = std::string(parsed.result.empty() ? "*" : parsed.result);
+                record.valid = replayGame(gm, parsed.fen, parsed.moves, record.plies, record.error);
+                if (record.valid && m_options.positionIndex)
+                    m_options.positionIndex->addGame(m_options.path + "@" + std::to_string(parsed.offset),
+                                                     GameArchive::parseResult(record.result), gm);
+                records.push_back(std::move(record));
+            }
+        }
+        gm.resetGame();
+
+        std::lock_guard lock(m_recordsMutex);
+        m_records.insert(m_records.end(), std::make_move_iterator(records.begin()), std::make_move_iterator(records.end()));
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < m_options.readers; i++)
+        threads.emplace_back(reader);
+    for (unsigned i = 0; i < m_options.parsers; i++)
+        threads.emplace_back(parser);
+    for (unsigned i = 0; i < m_options.replayers; i++)
+        threads.emplace_back(replayer);
+    for (auto &thread : threads)
+        thread.join();
+
+    std::sort(m_records.begin(), m_records.end(), [](const IngestRecord &a, const IngestRecord &b)
+              { return a.offset < b.offset; });
+
+    IngestStats stats;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.bytes = data.size();
+    stats.chunks = chunksRead;
+    stats.games = m_records.size();
+    for (const IngestRecord &record : m_records)
+    {
+        stats.plies += record.plies;
+        stats.validGames += record.valid ? 1 : 0;
+    }
+    stats.readerStalls = chunks.getFullWaits();
+    stats.parserStalls = batches.getFullWaits();
+    return stats;
+}
+
+/// @brief one line per game: offset, plies, result, status and the error for rejected games
+void IngestPipeline::writeIndex(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("failed to open " + path + " for writing");
+
+    for (const IngestRecord &record : m_records)
+    {
+        out << record.offset << '\t' << record.plies << '\t' << record.result << '\t'
+            << (record.valid ? "ok" : "invalid");
+        if (!record.valid)
+            out << '\t' << record.error;
+        out << '\n';
+    }
+}
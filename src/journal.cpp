@@ -0,0 +1,361 @@
+#include "journal.h"
+#include "alloc.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr size_t recordHeaderSize = 24;
+
+    uint64_t checksum(uint64_t offset, std::string_view name, std::string_view content)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        const std::string_view offsetBytes(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        for (std::string_view part : {offsetBytes, name, content})
+        {
+            for (unsigned char c : part)
+            {
+                hash ^= c;
+                hash *= 0x100000001b3ULL;
+            }
+        }
+        return hash;
+    }
+
+    void writeAll(int fd, const char *data, size_t size, const std::string &path)
+    {
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0)
+                throw std::runtime_error("failed to write " + path + ": " + std::strerror(errno));
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    void writeFile(const std::string &path, const std::string &content, bool sync)
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("failed to open " + path + " for writing");
+        try
+        {
+            writeAll(fd, content.data(), content.size(), path);
+            if (sync && ::fsync(fd) != 0)
+                throw std::runtime_error("failed to sync " + path);
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    /// @brief replaces path from offset on with content, leaving what comes before as it is
+    void writeTail(int fd, uint64_t offset, const std::string &content, const std::string &path)
+    {
+        size_t done = 0;
+        while (done < content.size())
+        {
+            ssize_t written = ::pwrite(fd, content.data() + done, content.size() - done, static_cast<off_t>(offset + done));
+            if (written < 0)
+                throw std::runtime_error("failed to write " + path + ": " + std::strerror(errno));
+            done += static_cast<size_t>(written);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(offset + content.size())) != 0)
+            throw std::runtime_error("failed to truncate " + path);
+    }
+
+    /// @return the file's content, empty when it does not exist
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        return buffer.str();
+    }
+
+    /// @brief syncs a file or directory that is already written
+    void syncPath(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    std::string parentDirectory(const std::string &path)
+    {
+        std::string parent = std::filesystem::path(path).parent_path().string();
+        return parent.empty() ? "." : parent;
+    }
+}
+
+GameJournal::GameJournal(JournalOptions options) : m_options(std::move(options))
+{
+    std::filesystem::create_directories(parentDirectory(m_options.path));
+    recover(m_options.path);
+
+    m_fd = ::open(m_options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_fd < 0)
+        throw std::runtime_error("failed to open " + m_options.path + " for writing");
+    m_committer = std::thread(&GameJournal::run, this);
+}
+
+GameJournal::~GameJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_pendingReady.notify_one();
+    m_committer.join();
+    ::close(m_fd);
+}
+
+uint64_t GameJournal::submit(const std::string &file, std::string content, uint64_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_error.empty())
+        throw std::runtime_error(m_error);
+    m_pending.push_back({file, offset, std::move(content)});
+    if (m_pending.size() == 1 || m_pending.size() >= m_options.maxBatch)
+        m_pendingReady.notify_one();
+    return m_nextTicket++;
+}
+
+void GameJournal::waitDurable(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_durableReady.wait(lock, [&]
+                        { return m_durableTicket >= ticket || !m_error.empty(); });
+    if (m_durableTicket < ticket)
+        throw std::runtime_error(m_error);
+}
+
+void GameJournal::checkpoint()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t target = m_checkpointsDone + 1;
+    m_checkpointRequested = true;
+    m_pendingReady.notify_one();
+    m_durableReady.wait(lock, [&]
+                        { return m_checkpointsDone >= target || !m_error.empty(); });
+    if (m_checkpointsDone < target)
+        throw std::runtime_error(m_error);
+}
+
+JournalStats GameJournal::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void GameJournal::run()
+{
+    ALLOC_SCOPE(AllocSubsystem::IO);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_pendingReady.wait(lock, [this]
+                            { return m_stop || m_checkpointRequested || !m_pending.empty(); });
+
+        // the first write of a batch opens the window, everything arriving within it shares the fsync
+        if (!m_pending.empty() && !m_stop)
+            m_pendingReady.wait_for(lock, m_options.interval, [this]
+                                    { return m_stop || m_pending.size() >= m_options.maxBatch; });
+
+        std::vector<PendingWrite> batch;
+        batch.swap(m_pending);
+        const uint64_t lastTicket = m_nextTicket - 1;
+        const bool checkpointRequested = m_checkpointRequested;
+        m_checkpointRequested = false;
+        const bool stopping = m_stop;
+        lock.unlock();
+
+        std::string error;
+        try
+        {
+            if (!batch.empty())
+                commit(batch);
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (error.empty())
+        {
+            m_durableTicket = lastTicket;
+            m_stats.records += batch.size();
+            m_stats.commits += batch.empty() ? 0 : 1;
+        }
+        else
+            m_error = error;
+        m_durableReady.notify_all();
+        lock.unlock();
+
+        // acknowledged writers do not wait for the game files, the journal already has their content
+        try
+        {
+            if (error.empty())
+            {
+                // in order, each file opened once per batch
+                std::unordered_map<std::string, int> files;
+                try
+                {
+                    for (const PendingWrite &write : batch)
+                    {
+                        auto [it, opened] = files.try_emplace(write.file, -1);
+                        if (opened)
+                            it->second = ::open(write.file.c_str(), O_WRONLY | O_CREAT, 0644);
+                        if (it->second < 0)
+                            throw std::runtime_error("failed to open " + write.file + " for writing");
+                        writeTail(it->second, write.offset, write.content, write.file);
+                    }
+                }
+                catch (...)
+                {
+                    for (const auto &[file, fd] : files)
+                        ::close(fd);
+                    throw;
+                }
+                for (const auto &[file, fd] : files)
+                    ::close(fd);
+
+                if (checkpointRequested || stopping || m_journalBytes >= m_options.checkpointBytes)
+                    checkpointFiles();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (!error.empty())
+            m_error = error;
+        if (checkpointRequested && error.empty())
+            m_checkpointsDone++;
+        m_durableReady.notify_all();
+        if (stopping && m_pending.empty())
+            break;
+    }
+}
+
+void GameJournal::commit(std::vector<PendingWrite> &batch)
+{
+    std::string buffer;
+    for (PendingWrite &write : batch)
+    {
+        // a file's first record since the checkpoint carries the synced file up to the write, which this thread
+        // alone has been writing, so recovery can start from the journal instead of a file a crash may have torn
+        if (m_unsyncedFiles.insert(write.file).second && write.offset > 0)
+        {
+            std::string whole = readFile(write.file);
+            if (whole.size() < write.offset)
+                throw std::runtime_error("write past the end of " + write.file);
+            whole.resize(write.offset);
+            write.content.insert(0, whole);
+            write.offset = 0;
+        }
+
+        uint32_t lengths[2] = {static_cast<uint32_t>(write.file.size()), static_cast<uint32_t>(write.content.size())};
+        uint64_t sum = checksum(write.offset, write.file, write.content);
+        buffer.append(reinterpret_cast<const char *>(lengths), sizeof(lengths));
+        buffer.append(reinterpret_cast<const char *>(&write.offset), sizeof(write.offset));
+        buffer.append(reinterpret_cast<const char *>(&sum), sizeof(sum));
+        buffer += write.file;
+        buffer += write.content;
+    }
+
+    writeAll(m_fd, buffer.data(), buffer.size(), m_options.path);
+    if (::fdatasync(m_fd) != 0)
+        throw std::runtime_error("failed to sync " + m_options.path);
+    m_journalBytes += buffer.size();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.bytes += buffer.size();
+}
+
+void GameJournal::checkpointFiles()
+{
+    std::set<std::string> directories;
+    for (const std::string &file : m_unsyncedFiles)
+    {
+        syncPath(file);
+        directories.insert(parentDirectory(file));
+    }
+    for (const std::string &directory : directories)
+        syncPath(directory);
+
+    // only now that every game file is on disk can the journal let go of them
+    if (::ftruncate(m_fd, 0) != 0 || ::fsync(m_fd) != 0)
+        throw std::runtime_error("failed to reset " + m_options.path);
+    m_journalBytes = 0;
+    m_unsyncedFiles.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.checkpoints++;
+}
+
+size_t GameJournal::recover(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return 0;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    const std::string data = buffer.str();
+    in.close();
+
+    // every file's first record is whole, later ones are replayed onto it in journal order
+    std::unordered_map<std::string, std::string> latest;
+    size_t pos = 0;
+    while (data.size() - pos >= recordHeaderSize)
+    {
+        uint32_t lengths[2];
+        uint64_t offset;
+        uint64_t sum;
+        std::memcpy(lengths, data.data() + pos, sizeof(lengths));
+        std::memcpy(&offset, data.data() + pos + sizeof(lengths), sizeof(offset));
+        std::memcpy(&sum, data.data() + pos + sizeof(lengths) + sizeof(offset), sizeof(sum));
+        if (data.size() - pos - recordHeaderSize < static_cast<size_t>(lengths[0]) + lengths[1])
+            break;
+
+        std::string_view file(data.data() + pos + recordHeaderSize, lengths[0]);
+        std::string_view content(data.data() + pos + recordHeaderSize + lengths[0], lengths[1]);
+        if (checksum(offset, file, content) != sum)
+            break;
+        auto it = latest.find(std::string(file));
+        if (it == latest.end() ? offset != 0 : it->second.size() < offset)
+            break;
+        if (it == latest.end())
+            it = latest.emplace(file, std::string()).first;
+        it->second.resize(offset);
+        it->second += content;
+        pos += recordHeaderSize + lengths[0] + lengths[1];
+    }
+
+    std::set<std::string> directories;
+    for (const auto &[file, content] : latest)
+    {
+        writeFile(file, content, true);
+        directories.insert(parentDirectory(file));
+    }
+    for (const std::string &directory : directories)
+        syncPath(directory);
+
+    writeFile(path, "", true);
+    return latest.size();
+}
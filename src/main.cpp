@@ -1,14 +1,33 @@
 #include <iostream>
 #include "classes.h"
+#include "trace.h"
+#include "alloc.h"
+#include "spectate.h"
+#include <memory>
 #include <print>
+#include <string>
 
-int main()
+int main(int argc, char **argv)
 {
     try
     {
+        // everything the game allocates from here on is charged to it
+        ALLOC_GAME("game");
         PieceFactory factory;
         Chess game(factory);
+        std::unique_ptr<SpectatorServer> spectators;
+        if (argc == 3 && std::string(argv[1]) == "--spectate")
+        {
+            spectators = std::make_unique<SpectatorServer>(SpectatorOptions{argv[2]});
+            game.setSpectators(spectators.get(), 1);
+            std::println("spectators can watch this game as game 1 on {0}", argv[2]);
+        }
         game.run();
+        if constexpr (Tracer::enabled)
+        {
+            Tracer::writeFiles("games/trace");
+            std::println("move timings written to games/trace.metrics.txt and games/trace.trace.json");
+        }
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,257 @@
+#include "match.h"
+#include "chess.h"
+#include "factory.h"
+#include "fen.h"
+#include "alloc.h"
+#include "san.h"
+#include "spectate.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    double expectedScore(double elo)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+}
+
+void SideStats::add(const SideStats &other)
+{
+    moves += other.moves;
+    nodes += other.nodes;
+    time += other.time;
+    maxMoveTime = std::max(maxMoveTime, other.maxMoveTime);
+}
+
+double MatchStats::eloDifference() const
+{
+    if (games == 0)
+        return 0.0;
+    double score = (wins + draws / 2.0) / games;
+    score = std::clamp(score, 1e-3, 1.0 - 1e-3);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+MatchRunner::MatchRunner(MatchOptions options) : m_options(std::move(options))
+{
+    if (m_options.openings.empty())
+        m_options.openings = defaultOpenings();
+    if (m_options.sprt.alpha <= 0 || m_options.sprt.beta <= 0 || m_options.sprt.alpha >= 1 || m_options.sprt.beta >= 1)
+        throw std::invalid_argument("SPRT alpha and beta have to lie between 0 and 1");
+}
+
+double MatchRunner::computeLlr(size_t wins, size_t draws, size_t losses, double elo0, double elo1)
+{
+    const double games = static_cast<double>(wins + draws + losses);
+    if (games == 0)
+        return 0.0;
+    const double score = (wins + draws / 2.0) / games;
+    const double variance = (wins * std::pow(1.0 - score, 2) + draws * std::pow(0.5 - score, 2) + losses * score * score) / games;
+    if (variance <= 0)
+        return 0.0;
+    const double s0 = expectedScore(elo0);
+    const double s1 = expectedScore(elo1);
+    return (s1 - s0) * (2 * score - s0 - s1) / (2 * variance / games);
+}
+
+std::vector<AnalysisJob> MatchRunner::defaultOpenings()
+{
+    static const char *const lines[] = {
+        "e4 e5 Nf3 Nc6 Bb5 a6", "e4 e5 Nf3 Nc6 Bc4 Bc5", "e4 c5 Nf3 d6 d4 cxd4", "e4 c5 Nc3 Nc6 g3 g6",
+        "e4 e6 d4 d5 Nc3 Bb4", "e4 c6 d4 d5 Nc3 dxe4", "e4 d5 exd5 Qxd5 Nc3 Qa5", "d4 d5 c4 e6 Nc3 Nf6",
+        "d4 d5 c4 c6 Nf3 Nf6", "d4 Nf6 c4 g6 Nc3 Bg7", "d4 Nf6 c4 e6 Nf3 b6", "c4 e5 Nc3 Nf6 Nf3 Nc6",
+        "Nf3 d5 g3 Nf6 Bg2 c6", "d4 f5 g3 Nf6 Bg2 e6", "e4 Nf6 e5 Nd5 d4 d6", "c4 c5 Nf3 Nf6 Nc3 Nc6"};
+
+    std::vector<AnalysisJob> openings;
+    for (const char *line : lines)
+    {
+        AnalysisJob job;
+        job.name = line;
+        std::istringstream moves(line);
+        std::string san;
+        while (moves >> san)
+            job.game.moves.push_back({san, "", {}});
+        openings.push_back(std::move(job));
+    }
+    return openings;
+}
+
+std::vector<AnalysisJob> MatchRunner::loadOpenings(const std::string &path, size_t plies)
+{
+    if (!path.ends_with(".epd") && !path.ends_with(".fen"))
+    {
+        std::vector<AnalysisJob> openings = GameAnalyzer::loadJobs(path);
+        for (AnalysisJob &job : openings)
+        {
+            if (job.moves.size() > plies)
+                job.moves.erase(job.moves.begin() + static_cast<std::ptrdiff_t>(plies), job.moves.end());
+            if (job.game.moves.size() > plies)
+                job.game.moves.resize(plies);
+        }
+        return openings;
+    }
+
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("failed to open " + path);
+    PieceFactory factory;
+    GameManager gm(factory);
+    std::vector<AnalysisJob> openings;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        if (path.ends_with(".epd"))
+            FenNotation::fromEpd(gm, line);
+        else
+            FenNotation::fromFen(gm, line);
+        AnalysisJob job;
+        job.name = path + ":" + std::to_string(openings.size() + 1);
+        job.game.setTag("FEN", FenNotation::toFen(gm));
+        openings.push_back(std::move(job));
+    }
+    return openings;
+}
+
+MatchGame MatchRunner::playGame(size_t index, GameManager &gm, SearchEngine &engineA, SearchEngine &engineB, const std::atomic<bool> &stop)
+{
+    ALLOC_GAME("match game " + std::to_string(index + 1));
+    MatchGame game;
+    game.opening = (index / 2) % m_options.openings.size();
+    game.bIsWhite = index % 2 == 1;
+
+    const AnalysisJob &opening = m_options.openings[game.opening];
+    GameAnalyzer::setupJob(opening, gm);
+    const size_t openingPlies = opening.moves.empty() ? opening.game.moves.size() : opening.moves.size();
+    for (size_t ply = 0; ply < openingPlies; ply++)
+    {
+        if (!gm.replayMove(GameAnalyzer::resolveMove(opening, gm, ply)))
+            throw std::runtime_error("opening " + opening.name + " does not replay");
+    }
+    engineA.clearTable();
+    engineB.clearTable();
+
+    while ((game.status = gm.evaluateStatus()) == GameStatus::ONGOING && game.plies < m_options.maxPlies)
+    {
+        if (stop.load(std::memory_order_relaxed))
+            return game;
+
+        const bool bToMove = (gm.getCurrentTurnColor() == PieceColor::WHITE) == game.bIsWhite;
+        SearchEngine &engine = bToMove ? engineB : engineA;
+        SideStats &side = bToMove ? game.b : game.a;
+
+        auto start = std::chrono::steady_clock::now();
+        SearchResult result = engine.search(gm, bToMove ? m_options.b.limits : m_options.a.limits);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        // replayMove keeps no SAN, so it is only worked out for spectators
+        std::string san;
+        if (m_options.spectators && result.bestMove)
+            san = SanNotation::toSan(gm, *result.bestMove);
+        if (!result.bestMove || !gm.replayMove(*result.bestMove))
+            throw std::runtime_error("engine produced no legal move");
+        if (m_options.spectators)
+            m_options.spectators->publishMove(static_cast<uint32_t>(index + 1), gm, san + SanNotation::checkSuffix(gm));
+
+        side.moves++;
+        side.nodes += result.nodes;
+        side.time += elapsed;
+        side.maxMoveTime = std::max(side.maxMoveTime, elapsed);
+        game.plies++;
+    }
+
+    if (m_options.spectators)
+        m_options.spectators->endGame(static_cast<uint32_t>(index + 1));
+
+    // only checkmate decides a game; the side to move is the one that got mated
+    if (game.status == GameStatus::CHECKMATE)
+    {
+        const bool bMated = (gm.getCurrentTurnColor() == PieceColor::WHITE) == game.bIsWhite;
+        game.score = bMated ? -1 : 1;
+    }
+    return game;
+}
+
+void MatchRunner::updateSprt()
+{
+    const SprtOptions &sprt = m_options.sprt;
+    m_stats.llr = computeLlr(m_stats.wins, m_stats.draws, m_stats.losses, sprt.elo0, sprt.elo1);
+    m_stats.lowerBound = std::log(sprt.beta / (1 - sprt.alpha));
+    m_stats.upperBound = std::log((1 - sprt.beta) / sprt.alpha);
+    if (m_stats.llr >= m_stats.upperBound)
+        m_stats.verdict = 1;
+    else if (m_stats.llr <= m_stats.lowerBound)
+        m_stats.verdict = -1;
+}
+
+MatchStats MatchRunner::run()
+{
+    auto start = std::chrono::steady_clock::now();
+    m_stats = MatchStats{};
+    m_games.clear();
+    updateSprt();
+
+    std::atomic<size_t> nextGame{0};
+    std::atomic<bool> stop{false};
+    std::string error;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::max(1u, m_options.threads); t++)
+    {
+        workers.emplace_back([&]
+                             {
+            PieceFactory factory;
+            GameManager gm(factory);
+            SearchEngine engineA(m_options.a.tableMegabytes);
+            SearchEngine engineB(m_options.b.tableMegabytes);
+            // a verdict also cuts short the searches of games that will not be counted
+            engineA.setStopFlag(&stop);
+            engineB.setStopFlag(&stop);
+
+            for (size_t i = nextGame++; i < m_options.maxGames && !stop; i = nextGame++)
+            {
+                MatchGame game;
+                try
+                {
+                    game = playGame(i, gm, engineA, engineB, stop);
+                }
+                catch (const std::exception &e)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    error = e.what();
+                    stop = true;
+                    break;
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (stop)
+                    break;
+                m_stats.games++;
+                if (game.score > 0)
+                    m_stats.wins++;
+                else if (game.score < 0)
+                    m_stats.losses++;
+                else
+                    m_stats.draws++;
+                m_stats.a.add(game.a);
+                m_stats.b.add(game.b);
+                updateSprt();
+                m_games.push_back(game);
+                if (m_options.onGame)
+                    m_options.onGame(game, m_stats);
+                if (m_stats.verdict != 0)
+                    stop = true;
+            } });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return m_stats;
+}
@@ -1,6 +1,5 @@
 #include "classes.h"
 #include "move.h"
-#include "pgn.h"
 #include <stdlib.h>
 #include <iostream>
 
@@ -72,47 +71,11 @@ bool MoveManager::isPawnMoveValid(const Position &from, const Position &to, cons
             return targetPiece->getColor() != piece.getColor();
         }
 
-        // En passant capture
-        int enPassantRow = (piece.getColor() == PieceColor::WHITE) ? 5 : 4;
-        if (from.row == enPassantRow)
-        {
-            const MoveInfo& lastMove = m_pgn->getLastMove();
-
-            Position enemyPawnPos(to.col, from.row);
-            PieceInterface* enemyPawn = board.getPieceAt(enemyPawnPos);
-            
-            if (enemyPawn) {
-                return (lastMove.type == PieceType::PAWN && 
-                        std::abs(lastMove.fromRow - lastMove.toRow) == 2 &&
-                        lastMove.toCol == to.col &&
-                        enemyPawn->getType() == PieceType::PAWN && 
-                        enemyPawn->getColor() != piece.getColor());
-            }
-        }
-    }
-
-    // en passant capture
-    if (piece.getType() == PieceType::PAWN)
-    {
-        int enPassantRow = (piece.getColor() == PieceColor::WHITE) ? 5 : 4;
-        if (from.row == enPassantRow &&
-            std::abs(to.col - from.col) == 1 && 
-            to.row == from.row + direction)
-        {
-            const MoveInfo& lastMove = m_pgn->getLastMove();
-            
-            Position enemyPawnPos(to.col, from.row);
-            PieceInterface* enemyPawn = board.getPieceAt(enemyPawnPos);
-            
-            bool isValid = lastMove.type == PieceType::PAWN && 
-                          std::abs(lastMove.fromRow - lastMove.toRow) == 2 &&
-                          lastMove.toCol == to.col && 
-                          lastMove.toRow == from.row &&
-                          enemyPawn && 
-                          enemyPawn->getColor() != piece.getColor();
-            
-            return isValid;
-        }
+        // en passant: the target square is the one the last double pawn push passed over
+        Position enemyPawnPos(to.col, from.row);
+        PieceInterface *enemyPawn = board.getPieceAt(enemyPawnPos);
+        return squareIndex(to) == m_enPassantSquare && enemyPawn &&
+               enemyPawn->getType() == PieceType::PAWN && enemyPawn->getColor() != piece.getColor();
     }
     return false;
 }
@@ -193,10 +156,7 @@ bool MoveManager::isEnPassant(const PieceInterface &piece, const Position &from,
         std::abs(to.col - from.col) != 1)
         return false;
 
-    const MoveInfo& lastMove = m_pgn->getLastMove();
-    if (lastMove.type != PieceType::PAWN || 
-        lastMove.toCol != to.col || 
-        lastMove.toRow != from.row)
+    if (squareIndex(to) != m_enPassantSquare)
         return false;
 
     Position enemyPawnPos(to.col, from.row);
@@ -1,9 +1,21 @@
 #include "classes.h"
+#include <algorithm>
 #include <ctime>
 #include <sstream>
 #include <set>
 #include "pgn.h"
+#include "writer.h"
+#include "trace.h"
+#include "alloc.h"
 #include <filesystem>
+#include <charconv>
+#include <string_view>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
 
 PgnNotation::PgnNotation() : m_savedTurn(1), m_whiteHasMoved(false)
 {
@@ -21,10 +33,39 @@ PgnNotation::PgnNotation() : m_savedTurn(1), m_whiteHasMoved(false)
 void PgnNotation::initNewGame()
 {
     m_fileName = assignFileName();
+    if (m_writer)
+    {
+        m_originalContent = "[Date \"" + getCurrentDateString() + "\"]\n\n";
+        m_written.clear();
+        queueWrite(m_originalContent);
+        return;
+    }
     openFile(m_fileName);
     fileHeader();
 }
 
+/// @brief replaces the file with content; with a writer set this only queues it
+void PgnNotation::rewriteFile(const std::string &content)
+{
+    if (m_writer)
+    {
+        queueWrite(content);
+        return;
+    }
+    m_outFile.close();
+    m_outFile.open(m_fileName, std::ios::out | std::ios::trunc);
+    m_outFile << content;
+    m_outFile.flush();
+}
+
+void PgnNotation::queueWrite(const std::string &content)
+{
+    const size_t common = std::mismatch(m_written.begin(), m_written.begin() + std::min(m_written.size(), content.size()),
+                                        content.begin()).first - m_written.begin();
+    m_lastWrite = m_writer->write(m_fileName, content.substr(common), common);
+    m_written = content;
+}
+
 PgnNotation::~PgnNotation()
 {
     m_outFile.close();
@@ -33,11 +74,25 @@ PgnNotation::~PgnNotation()
 std::string PgnNotation::assignFileName()
 {
     std::time_t currentTime = std::time(nullptr);
-    std::tm *localTime = std::localtime(&currentTime);
+    std::tm localTime{};
+    localtime_r(&currentTime, &localTime);
     std::ostringstream dateStream;
-    dateStream << std::put_time(localTime, "%Y.%m.%d-%H:%M:%S");
-    std::string fileName = "games/" + dateStream.str() + ".txt";
-    return fileName;
+    dateStream << std::put_time(&localTime, "%Y.%m.%d-%H:%M:%S");
+
+    // games started in the same second get a numbered name; creating the file claims it, even between processes
+    static std::atomic<unsigned> collisions{0};
+    for (bool first = true;; first = false)
+    {
+        std::string fileName = "games/" + dateStream.str() + (first ? "" : "-" + std::to_string(++collisions)) + ".txt";
+        int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0)
+        {
+            ::close(fd);
+            return fileName;
+        }
+        if (errno != EEXIST)
+            throw std::runtime_error("failed to create " + fileName + ": " + std::strerror(errno));
+    }
 }
 
 void PgnNotation::openFile(const std::string &fileName)
@@ -62,13 +117,18 @@ void PgnNotation::fileHeader()
         m_outFile << "[Date \"" << gameDate << "\"]\n";
 }
 
-int PgnNotation::getCurrentTurn()
-{
-    return GameManager::turn;
-}
-
 void PgnNotation::appendToFile(const std::string &line)
 {
+    ALLOC_SCOPE(AllocSubsystem::PGN);
+    if (m_writer)
+    {
+        if (!m_originalContent.empty() && line[0] != '[' && m_originalContent.back() != '\n' && std::isdigit(line[0]))
+            m_originalContent += '\n';
+        m_originalContent += line;
+        rewriteFile(m_originalContent);
+        return;
+    }
+
     if (!m_outFile.is_open())
     {
         throw std::runtime_error("file is not open for writing.");
@@ -88,9 +148,11 @@ void PgnNotation::appendToFile(const std::string &line)
     m_originalContent += line;
 }
 
-void PgnNotation::writeTurn(const PieceColor &color, const PieceType &type, const char &fromCol,
+void PgnNotation::writeTurn(int fullmove, const PieceColor &color, const PieceType &type, const char &fromCol,
                             const int &fromRow, const char &toCol, const int &toRow, const std::string &specialMove)
 {
+    TRACE_SCOPE(TracePhase::PGN_WRITE);
+    ALLOC_SCOPE(AllocSubsystem::PGN);
     try
     {
         if (m_originalContent.empty())
@@ -99,13 +161,12 @@ void PgnNotation::writeTurn(const PieceColor &color, const PieceType &type, cons
             m_originalContent = "[Date \"" + getCurrentDateString() + "\"]\n\n";
         }
 
-        std::string pieceSymbol = getPieceSymbol(type);
-        std::string move = specialMove.empty() ? pieceSymbol + std::string(1, fromCol) + std::to_string(fromRow) + " -> " + pieceSymbol + std::string(1, toCol) + std::to_string(toRow) : specialMove;
+        std::string move = specialMove.empty() ? formatMove(type, {Position(fromCol, fromRow), Position(toCol, toRow)}) : specialMove;
 
         std::string output;
         if (color == PieceColor::WHITE)
         {
-            output = std::to_string(getCurrentTurn()) + ". " + move + " | ";
+            output = std::to_string(fullmove) + ". " + move + " | ";
         }
         else
         {
@@ -115,11 +176,8 @@ void PgnNotation::writeTurn(const PieceColor &color, const PieceType &type, cons
                 m_originalContent[lastPipePos + 1] != ' ')
             {
                 m_originalContent.insert(lastPipePos + 1, " ");
-
-                m_outFile.close();
-                m_outFile.open(m_fileName, std::ios::out | std::ios::trunc);
-                m_outFile << m_originalContent;
-                m_outFile.flush();
+                if (!m_writer)
+                    rewriteFile(m_originalContent);
             }
             output = move + "\n";
         }
@@ -154,11 +212,11 @@ void PgnNotation::writeTurn(const PieceColor &color, const PieceType &type, cons
 
         if (color == PieceColor::WHITE)
         {
-            turns[getCurrentTurn()] = output.substr(0, output.length() - 1); 
+            turns[fullmove] = output.substr(0, output.length() - 1); 
         }
         else
         {
-            auto it = turns.find(getCurrentTurn());
+            auto it = turns.find(fullmove);
             if (it != turns.end())
             {
                 it->second += output;
@@ -171,13 +229,8 @@ void PgnNotation::writeTurn(const PieceColor &color, const PieceType &type, cons
             newContent += moveLine + (moveLine.back() != '\n' ? "\n" : "");
         }
 
-        m_outFile.close();
-        m_outFile.open(m_fileName, std::ios::out | std::ios::trunc);
-        m_outFile << newContent;
-        m_outFile.flush();
-
+        rewriteFile(newContent);
         m_originalContent = newContent;
-        m_lastMove = {type, fromRow, toRow, fromCol, toCol, color};
     }
     catch (const std::exception &e)
     {
@@ -194,22 +247,6 @@ std::string PgnNotation::getCurrentDateString() const
     return dateStream.str();
 }
 
-MoveInfo PgnNotation::getLastMove() const
-{
-    return m_lastMove;
-}
-
-bool PgnNotation::hasPieceMoved(const PieceType &type, const PieceColor &color, const char &col) const
-{
-    if (type != PieceType::KING && type != PieceType::ROOK)
-    {
-        return false;
-    }
-
-    std::string key = std::string(1, col) + std::to_string(color == PieceColor::WHITE ? 0 : 1);
-    return m_pieceMoved.count(key) > 0 && m_pieceMoved.at(key);
-}
-
 std::string PgnNotation::promotionTypeToString(PieceType type) const
 {
     switch (type)
@@ -227,7 +264,7 @@ std::string PgnNotation::promotionTypeToString(PieceType type) const
     }
 }
 
-std::vector<std::string> PgnNotation::listSavedGames()
+std::vector<std::string> PgnNotation::listSavedGames(const std::string &extension)
 {
     namespace fs = std::filesystem;
     std::vector<std::string> gameFiles;
@@ -235,7 +272,7 @@ std::vector<std::string> PgnNotation::listSavedGames()
 
     for (const auto &entry : fs::directory_iterator(folderName))
     {
-        if (entry.path().extension() == ".txt")
+        if (entry.path().extension() == extension)
         {
             gameFiles.push_back(entry.path().filename().string());
         }
@@ -245,25 +282,38 @@ std::vector<std::string> PgnNotation::listSavedGames()
 
 bool PgnNotation::loadGame(const std::string &filename)
 {
+    ALLOC_SCOPE(AllocSubsystem::PGN);
     if (m_outFile.is_open())
         m_outFile.close();
-    if (m_inFile.is_open())
-        m_inFile.close();
 
     m_fileName = "games/" + filename;
+    // the cleaned content kept below need not match the file byte for byte, so the next write is whole
+    m_written.clear();
 
-    std::ifstream inFile(m_fileName);
+    std::ifstream inFile(m_fileName, std::ios::binary);
     if (!inFile)
     {
         throw std::runtime_error("Failed to open " + filename + " for reading");
     }
 
-    std::string line;
-    std::string header;
-    std::map<int, std::string> moveLines;
+    // one read for the whole file, lines are then sliced out of it without copies
+    std::ostringstream buffer;
+    buffer << inFile.rdbuf();
+    inFile.close();
+    const std::string content = buffer.str();
 
-    while (std::getline(inFile, line))
+    std::string_view header;
+    std::map<int, std::string_view> moveLines;
+    std::string_view rest(content);
+
+    while (!rest.empty())
     {
+        size_t newline = rest.find('\n');
+        std::string_view line = rest.substr(0, newline);
+        rest.remove_prefix(newline == std::string_view::npos ? rest.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
         if (line.empty())
             continue;
 
@@ -278,71 +328,41 @@ bool PgnNotation::loadGame(const std::string &filename)
             continue;
         }
 
-        if (std::isdigit(line[0]))
+        if (std::isdigit(static_cast<unsigned char>(line[0])))
         {
-            size_t turnNumber = std::stoul(line.substr(0, line.find('.')));
+            int turnNumber = 0;
+            std::from_chars(line.data(), line.data() + line.size(), turnNumber);
             moveLines[turnNumber] = line;
         }
     }
-    inFile.close();
 
-    std::string cleanContent = header + "\n";
+    std::string cleanContent;
+    cleanContent.reserve(content.size());
+    cleanContent += header;
+    cleanContent += '\n';
     for (const auto &[turn, moveLine] : moveLines)
     {
-        cleanContent += moveLine + "\n";
+        cleanContent += moveLine;
+        cleanContent += '\n';
     }
 
-    m_originalContent = cleanContent;
+    m_originalContent = std::move(cleanContent);
+    m_readOffset = 0;
 
-    m_outFile.open(m_fileName, std::ios::out | std::ios::trunc);
+    // writeTurn and saveTurnState rewrite the whole file from m_originalContent,
+    // so the file is left as it is until the next move instead of being rewritten here
+    m_outFile.open(m_fileName, std::ios::app);
     if (!m_outFile)
     {
         throw std::runtime_error("failed to open " + filename + " for writing");
     }
-    m_outFile << cleanContent;
-    m_outFile.flush();
-
-    m_inFile.open(m_fileName);
-    if (!m_inFile)
-    {
-        throw std::runtime_error("failed to open " + filename + " for reading");
-    }
-
-    std::string movedPiecesLine;
-    while (std::getline(inFile, line))
-    {
-        if (line.starts_with("[MovedPieces \""))
-        {
-            movedPiecesLine = line;
-            break;
-        }
-    }
-
-    if (!movedPiecesLine.empty())
-    {
-        size_t start = movedPiecesLine.find("\"") + 1;
-        size_t end = movedPiecesLine.rfind("\"");
-        if (start != std::string::npos && end != std::string::npos)
-        {
-            std::string pieces = movedPiecesLine.substr(start, end - start);
-            std::stringstream ss(pieces);
-            std::string piece;
-            while (std::getline(ss, piece, ','))
-            {
-                m_pieceMoved[piece] = true;
-            }
-        }
-    }
-
-    m_pieceMoved.clear();
-    m_originalPositions.clear();
 
     return true;
 }
 
-std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const std::string &line)
+std::vector<Move> PgnNotation::parseMovesFromFile(const std::string &line)
 { 
-    std::vector<std::pair<Position, Position>> moves;
+    std::vector<Move> moves;
 
     if (line.empty() || line[0] == '[' || line[0] == '#')
     {
@@ -357,9 +377,9 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
 
     std::string movesStr = line.substr(dotPos + 1);
 
-    auto processCastling = [](const std::string &moveStr, PieceColor color) -> std::vector<std::pair<Position, Position>>
+    auto processCastling = [](const std::string &moveStr, PieceColor color) -> std::vector<Move>
     {
-        std::vector<std::pair<Position, Position>> castleMoves;
+        std::vector<Move> castleMoves;
         int row = (color == PieceColor::WHITE) ? 1 : 8;
 
         if (moveStr.find("O-O-O") != std::string::npos)
@@ -371,7 +391,6 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
         }
         else if (moveStr.find("O-O") != std::string::npos)
         {
-            std::cout << "DEBUG: Processing short castling\n";
             castleMoves.push_back({
                 Position('e', row), 
                 Position('g', row)  
@@ -380,18 +399,19 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
         return castleMoves;
     };
 
-    auto processMove = [](const std::string &moveStr) -> std::pair<Position, Position>
+    auto processMove = [](const std::string &moveStr) -> Move
     {
+        Move none{Position('\0', 0), Position('\0', 0)};
 
         if (moveStr.empty() || moveStr.find("O-O") != std::string::npos)
         {
-            return std::make_pair(Position('\0', 0), Position('\0', 0));
+            return none;
         }
 
         size_t arrowPos = moveStr.find("->");
         if (arrowPos == std::string::npos)
         {
-            return std::make_pair(Position('\0', 0), Position('\0', 0));
+            return none;
         }
 
         std::string fromStr = moveStr.substr(0, arrowPos);
@@ -413,12 +433,33 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
 
         if (fromStr.length() >= 2 && toStr.length() >= 2)
         {
-            return std::make_pair(
-                Position(fromStr[0], fromStr[1] - '0'),
-                Position(toStr[0], toStr[1] - '0'));
+            // promotions are written as e7 -> e8=Q
+            PieceType promotion = PieceType::PAWN;
+            size_t eqPos = toStr.find('=');
+            if (eqPos != std::string::npos && eqPos + 1 < toStr.length())
+            {
+                switch (toStr[eqPos + 1])
+                {
+                case 'Q':
+                    promotion = PieceType::QUEEN;
+                    break;
+                case 'R':
+                    promotion = PieceType::ROOK;
+                    break;
+                case 'B':
+                    promotion = PieceType::BISHOP;
+                    break;
+                case 'N':
+                    promotion = PieceType::KNIGHT;
+                    break;
+                default:
+                    break;
+                }
+            }
+            return Move{Position(fromStr[0], fromStr[1] - '0'), Position(toStr[0], toStr[1] - '0'), promotion};
         }
 
-        return std::make_pair(Position('\0', 0), Position('\0', 0));
+        return none;
     };
 
     size_t pipePos = movesStr.find('|');
@@ -434,7 +475,7 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
         else
         {
             auto whiteRegularMove = processMove(whiteMove);
-            if (whiteRegularMove.first.col != '\0')
+            if (whiteRegularMove.from.col != '\0')
             {
                 moves.push_back(whiteRegularMove);
             }
@@ -452,7 +493,7 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
             else
             {
                 auto blackRegularMove = processMove(blackMove);
-                if (blackRegularMove.first.col != '\0')
+                if (blackRegularMove.from.col != '\0')
                 {
                     moves.push_back(blackRegularMove);
                 }
@@ -465,17 +506,32 @@ std::vector<std::pair<Position, Position>> PgnNotation::parseMovesFromFile(const
 
 bool PgnNotation::readNextLine(std::string &line)
 {
-    return std::getline(m_inFile, line).good();
+    if (m_readOffset >= m_originalContent.size())
+        return false;
+
+    size_t newline = m_originalContent.find('\n', m_readOffset);
+    size_t end = (newline == std::string::npos) ? m_originalContent.size() : newline;
+    line.assign(m_originalContent, m_readOffset, end - m_readOffset);
+    m_readOffset = end + 1;
+    return true;
 }
 
 void PgnNotation::skipLine()
 {
     std::string dummy;
-    std::getline(m_inFile, dummy);
+    readNextLine(dummy);
 }
 
 void PgnNotation::writeResult(const std::string &result)
 {
+    m_result = result;
+    if (m_writer)
+    {
+        m_originalContent += "\nResult: " + result + "\n";
+        queueWrite(m_originalContent);
+        m_writer->flush();
+        return;
+    }
     if (m_outFile.is_open())
     {
         m_outFile << "\nResult: " << result << "\n";
@@ -483,7 +539,7 @@ void PgnNotation::writeResult(const std::string &result)
     }
 }
 
-void PgnNotation::saveTurnState(int turn, bool whiteHasMoved) 
+void PgnNotation::saveTurnState(int turn, bool whiteHasMoved, int castlingRights)
 {
     try
     {
@@ -491,31 +547,34 @@ void PgnNotation::saveTurnState(int turn, bool whiteHasMoved)
         {
             m_outFile.close();
         }
-        if (m_inFile.is_open())
-        {
-            m_inFile.close();
-        }
 
         std::string content = m_originalContent;
         content += "\n[TurnState \"" + std::to_string(turn) + "," + (whiteHasMoved ? "1" : "0") + "\"]";
 
-        if (!m_pieceMoved.empty())
+        // a lost right is recorded as its rook having moved, as a FEN without that right sets it up
+        static constexpr const char *rookKeys[4] = {"h0", "a0", "h1", "a1"};
+        std::string pieces;
+        for (int right = 0; right < 4; right++)
         {
-            std::string pieces;
-            for (const auto &[key, value] : m_pieceMoved)
+            if (!(castlingRights & (1 << right)))
             {
-                if (value)
-                {
-                    if (!pieces.empty())
-                        pieces += ",";
-                    pieces += key;
-                }
-            }
-            if (!pieces.empty())
-            {
-                content += "\n[MovedPieces \"" + pieces + "\"]";
+                if (!pieces.empty())
+                    pieces += ",";
+                pieces += rookKeys[right];
             }
         }
+        if (!pieces.empty())
+        {
+            content += "\n[MovedPieces \"" + pieces + "\"]";
+        }
+
+        if (m_writer)
+        {
+            queueWrite(content);
+            m_writer->flush();
+            m_originalContent = content;
+            return;
+        }
 
         std::string tempFile = m_fileName + ".tmp";
         std::ofstream tempOut(tempFile);
@@ -614,6 +673,24 @@ bool PgnNotation::hasIncompleteTurn() const
     }
 }
 
+/// @brief one move in the saved-game format: Ng1 -> Nf3, e7 -> e8=Q or O-O
+std::string PgnNotation::formatMove(PieceType type, const Move &move)
+{
+    if (type == PieceType::KING && std::abs(move.to.col - move.from.col) == 2)
+    {
+        return (move.to.col > move.from.col) ? "O-O" : "O-O-O";
+    }
+
+    std::string pieceSymbol = getPieceSymbol(type);
+    std::string text = pieceSymbol + std::string(1, move.from.col) + std::to_string(move.from.row) + " -> " +
+                       pieceSymbol + std::string(1, move.to.col) + std::to_string(move.to.row);
+    if (move.promotion != PieceType::PAWN)
+    {
+        text += "=" + getPieceSymbol(move.promotion);
+    }
+    return text;
+}
+
 std::string PgnNotation::getPieceSymbol(PieceType type)
 {
     switch (type)
@@ -634,24 +711,3 @@ std::string PgnNotation::getPieceSymbol(PieceType type)
         return "";
     }
 }
-
-void PgnNotation::markPieceMoved(PieceType type, PieceColor color, char col, bool /* isReplay */)
-{
-    if (type != PieceType::KING && type != PieceType::ROOK)
-    {
-        return;
-    }
-
-    std::string key = std::string(1, col) + std::to_string(color == PieceColor::WHITE ? 0 : 1);
-
-    if ((type == PieceType::KING && col == 'e') ||
-        (type == PieceType::ROOK && (col == 'a' || col == 'h')))
-    {
-        m_pieceMoved[key] = true;
-    }
-}
-
-void PgnNotation::clearPieceMovementHistory()
-{
-    m_pieceMoved.clear();
-}
\ No newline at end of file
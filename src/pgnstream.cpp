@@ -0,0 +1,339 @@
+#include "pgnstream.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    bool isSeparator(char c)
+    {
+        return std::isspace(static_cast<unsigned char>(c)) || c == '{' || c == '}' || c == '(' ||
+               c == ')' || c == '[' || c == ']' || c == ';' || c == '$';
+    }
+
+    bool isResultToken(std::string_view token)
+    {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+    }
+
+    /// @brief pages behind the read position are handed back to the kernel in steps of this size
+    constexpr size_t releaseStep = 64 << 20;
+}
+
+bool PgnTokenizer::next(PgnToken &token)
+{
+    const size_t size = m_text.size();
+
+    while (m_pos < size)
+    {
+        char c = m_text[m_pos];
+
+        if (std::isspace(static_cast<unsigned char>(c)) || c == ')' || c == ']' || c == '}' || c == '.')
+        {
+            m_pos++;
+            continue;
+        }
+
+        if (c == '%')
+        {
+            // escape line, ignored by definition
+            size_t close = m_text.find('\n', m_pos);
+            m_pos = (close == std::string_view::npos) ? size : close + 1;
+            continue;
+        }
+
+        if (c == '[')
+        {
+            size_t nameStart = m_pos + 1;
+            while (nameStart < size && std::isspace(static_cast<unsigned char>(m_text[nameStart])))
+                nameStart++;
+            size_t nameEnd = nameStart;
+            while (nameEnd < size && !std::isspace(static_cast<unsigned char>(m_text[nameEnd])) &&
+                   m_text[nameEnd] != '"' && m_text[nameEnd] != ']')
+                nameEnd++;
+
+            size_t valueStart = m_text.find('"', nameEnd);
+            size_t valueEnd = valueStart;
+            if (valueStart != std::string_view::npos)
+            {
+                valueStart++;
+                valueEnd = valueStart;
+                while (valueEnd < size && m_text[valueEnd] != '"')
+                    valueEnd += (m_text[valueEnd] == '\\') ? 2 : 1;
+                valueEnd = std::min(valueEnd, size);
+            }
+
+            size_t close = m_text.find(']', valueStart == std::string_view::npos ? nameEnd : valueEnd);
+            token.type = PgnTokenType::TAG;
+            token.text = m_text.substr(nameStart, nameEnd - nameStart);
+            token.value = (valueStart == std::string_view::npos) ? std::string_view() : m_text.substr(valueStart, valueEnd - valueStart);
+            m_pos = (close == std::string_view::npos) ? size : close + 1;
+            return true;
+        }
+
+        if (c == '{' || c == ';')
+        {
+            size_t close = m_text.find(c == '{' ? '}' : '\n', m_pos + 1);
+            size_t end = (close == std::string_view::npos) ? size : close;
+            token.type = PgnTokenType::COMMENT;
+            token.text = m_text.substr(m_pos + 1, end - m_pos - 1);
+            token.value = {};
+            m_pos = (close == std::string_view::npos) ? size : close + 1;
+            return true;
+        }
+
+        if (c == '(')
+        {
+            int depth = 0;
+            size_t i = m_pos;
+            for (; i < size; i++)
+            {
+                if (m_text[i] == '{')
+                {
+                    size_t close = m_text.find('}', i);
+                    i = (close == std::string_view::npos) ? size - 1 : close;
+                }
+                else if (m_text[i] == '(')
+                    depth++;
+                else if (m_text[i] == ')' && --depth == 0)
+                    break;
+            }
+            token.type = PgnTokenType::VARIATION;
+            token.text = m_text.substr(m_pos + 1, std::min(i, size) - m_pos - 1);
+            token.value = {};
+            m_pos = (i < size) ? i + 1 : size;
+            return true;
+        }
+
+        size_t end = m_pos + 1;
+        bool numeric = std::isdigit(static_cast<unsigned char>(c));
+        while (end < size && !isSeparator(m_text[end]) && !(numeric && m_text[end] == '.'))
+            end++;
+
+        token.text = m_text.substr(m_pos, end - m_pos);
+        token.value = {};
+        m_pos = end;
+
+        if (isResultToken(token.text))
+            token.type = PgnTokenType::RESULT;
+        else if (c == '$')
+        {
+            while (m_pos < size && std::isdigit(static_cast<unsigned char>(m_text[m_pos])))
+                m_pos++;
+            token.type = PgnTokenType::NAG;
+            token.text = m_text.substr(end - 1, m_pos - end + 1);
+        }
+        else if (numeric)
+            token.type = PgnTokenType::MOVE_NUMBER;
+        else
+            token.type = PgnTokenType::SAN;
+        return true;
+    }
+
+    token.type = PgnTokenType::END;
+    token.text = {};
+    token.value = {};
+    return false;
+}
+
+void PgnGameView::clear()
+{
+    tags.clear();
+    moves.clear();
+    result = {};
+    text = {};
+}
+
+std::string_view PgnGameView::getTag(std::string_view name) const
+{
+    for (const auto &[key, value] : tags)
+    {
+        if (key == name)
+            return value;
+    }
+    return {};
+}
+
+bool scanPgnGame(PgnTokenizer &tokenizer, PgnGameView &game, bool &complete)
+{
+    game.clear();
+    complete = false;
+
+    PgnToken token;
+    size_t before = tokenizer.getPosition();
+    bool found = false;
+
+    while (tokenizer.next(token))
+    {
+        found = true;
+        switch (token.type)
+        {
+        case PgnTokenType::TAG:
+            // a tag after movetext belongs to the next game
+            if (!game.moves.empty())
+            {
+                tokenizer.setPosition(before);
+                complete = true;
+                return true;
+            }
+            game.tags.emplace_back(token.text, token.value);
+            break;
+        case PgnTokenType::SAN:
+            game.moves.push_back(token.text);
+            break;
+        case PgnTokenType::RESULT:
+            game.result = token.text;
+            complete = true;
+            return true;
+        default:
+            break;
+        }
+        before = tokenizer.getPosition();
+    }
+    return found;
+}
+
+size_t findPgnGameStart(std::string_view data, size_t pos)
+{
+    if (pos == 0)
+        return 0;
+
+    while (pos < data.size())
+    {
+        size_t tag = data.find("\n[", pos - 1);
+        if (tag == std::string_view::npos)
+            return data.size();
+
+        // the line before the tag has to be blank, otherwise it is the second tag of a game
+        size_t lineEnd = tag;
+        if (lineEnd > 0 && data[lineEnd - 1] == '\r')
+            lineEnd--;
+        if (lineEnd == 0 || data[lineEnd - 1] == '\n')
+            return tag + 1;
+        pos = tag + 2;
+    }
+    return data.size();
+}
+
+MappedFile::MappedFile(const std::string &path)
+{
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        throw std::runtime_error("failed to open " + path + " for reading");
+
+    struct stat info;
+    if (::fstat(m_fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            m_data = static_cast<const char *>(mapped);
+            m_size = static_cast<size_t>(info.st_size);
+        }
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        ::munmap(const_cast<char *>(m_data), m_size);
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+void MappedFile::adviseSequential() const
+{
+    if (m_data)
+        ::madvise(const_cast<char *>(m_data), m_size, MADV_SEQUENTIAL);
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (!m_data || offset >= m_size)
+        return;
+    size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t start = offset - (offset % pageSize);
+    ::madvise(const_cast<char *>(m_data) + start, std::min(length + offset - start, m_size - start), MADV_WILLNEED);
+}
+
+void MappedFile::release(size_t offset, size_t length) const
+{
+    if (!m_data || length == 0)
+        return;
+    ::madvise(const_cast<char *>(m_data) + offset, length, MADV_DONTNEED);
+}
+
+PgnStreamReader::PgnStreamReader(const std::string &path) : m_file(path)
+{
+    if (m_file.isMapped())
+    {
+        m_eof = true;
+        m_file.adviseSequential();
+    }
+}
+
+std::string_view PgnStreamReader::window() const
+{
+    return m_file.isMapped() ? m_file.getView() : std::string_view(m_buffer);
+}
+
+bool PgnStreamReader::refill()
+{
+    // drop what has been consumed, then grow by one chunk; a game longer than a chunk just grows the buffer
+    m_buffer.erase(0, m_offset);
+    m_offset = 0;
+
+    size_t used = m_buffer.size();
+    m_buffer.resize(used + chunkSize);
+    ssize_t bytesRead = ::read(m_file.getDescriptor(), m_buffer.data() + used, chunkSize);
+    m_buffer.resize(used + (bytesRead > 0 ? static_cast<size_t>(bytesRead) : 0));
+
+    if (bytesRead <= 0)
+        m_eof = true;
+    return bytesRead > 0;
+}
+
+void PgnStreamReader::releaseConsumedPages()
+{
+    if (!m_file.isMapped() || m_offset - m_releasedUpTo < releaseStep)
+        return;
+
+    size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t end = m_offset - (m_offset % pageSize);
+    m_file.release(m_releasedUpTo, end - m_releasedUpTo);
+    m_releasedUpTo = end;
+}
+
+bool PgnStreamReader::nextGame(PgnGameView &game)
+{
+    while (true)
+    {
+        std::string_view rest = window().substr(m_offset);
+        PgnTokenizer tokenizer(rest);
+        bool complete = false;
+        bool found = scanPgnGame(tokenizer, game, complete);
+
+        if (found && (complete || m_eof))
+        {
+            game.text = rest.substr(0, tokenizer.getPosition());
+            m_offset += tokenizer.getPosition();
+            m_bytesConsumed += tokenizer.getPosition();
+            m_gamesRead++;
+            releaseConsumedPages();
+            return true;
+        }
+
+        if (m_eof)
+        {
+            m_bytesConsumed += rest.size();
+            m_offset += rest.size();
+            return false;
+        }
+
+        refill();
+    }
+}
@@ -0,0 +1,398 @@
+#include "classes.h"
+#include "posindex.h"
+#include "archive.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    bool entryLess(const PositionEntry &a, const PositionEntry &b)
+    {
+        if (a.hash != b.hash)
+            return a.hash < b.hash;
+        if (a.gameId != b.gameId)
+            return a.gameId < b.gameId;
+        return a.ply < b.ply;
+    }
+
+    bool sameEntry(const PositionEntry &a, const PositionEntry &b)
+    {
+        return a.hash == b.hash && a.gameId == b.gameId && a.ply == b.ply;
+    }
+
+    bool hashLess(const PositionEntry &entry, uint64_t hash) { return entry.hash < hash; }
+    bool hashGreater(uint64_t hash, const PositionEntry &entry) { return hash < entry.hash; }
+
+    Position squareAt(int index) { return Position(static_cast<char>('a' + index % 8), index / 8 + 1); }
+
+    constexpr PieceType promotionPieces[4] = {PieceType::QUEEN, PieceType::ROOK, PieceType::BISHOP, PieceType::KNIGHT};
+}
+
+PositionIndex::PositionIndex(const std::string &directory) : m_directory(directory)
+{
+    std::filesystem::create_directories(m_directory);
+    load();
+}
+
+void PositionIndex::load()
+{
+    std::ifstream gameList(path("games.tsv"));
+    std::string line;
+    while (std::getline(gameList, line))
+    {
+        std::istringstream fields(line);
+        std::string id, result, name;
+        if (!std::getline(fields, id, '\t') || !std::getline(fields, result, '\t') || !std::getline(fields, name))
+            continue;
+
+        uint32_t gameId = static_cast<uint32_t>(std::stoul(id));
+        if (gameId >= m_games.size())
+            m_games.resize(gameId + 1);
+        m_games[gameId] = {name, GameArchive::parseResult(result), true};
+
+        auto [it, inserted] = m_gameIds.try_emplace(name, gameId);
+        if (!inserted)
+        {
+            m_games[it->second].live = false;
+            it->second = gameId;
+        }
+    }
+
+    // positions.idx is the single run of an index written before there were several
+    for (const auto &file : std::filesystem::directory_iterator(m_directory))
+    {
+        std::string name = file.path().filename().string();
+        uint64_t id = 0;
+        if (name != "positions.idx")
+        {
+            if (!name.starts_with("positions.") || !name.ends_with(".idx") || name.size() <= 14)
+                continue;
+            std::string digits = name.substr(10, name.size() - 14);
+            if (!std::all_of(digits.begin(), digits.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+                continue;
+            id = std::stoull(digits);
+        }
+
+        SortedRun run{id, std::make_unique<MappedFile>(file.path().string())};
+        std::string_view data = run.file->getView();
+        if (!run.file->isMapped() || data.size() < headerSize || std::memcmp(data.data(), magic, 4) != 0 ||
+            (data.size() - headerSize) % sizeof(PositionEntry) != 0)
+            throw std::runtime_error(file.path().string() + " is not a position index");
+        m_nextRun = std::max(m_nextRun, id + 1);
+        m_runs.push_back(std::move(run));
+    }
+    std::sort(m_runs.begin(), m_runs.end(), [](const SortedRun &a, const SortedRun &b) { return a.id < b.id; });
+
+    // a crash can leave a partial record at the end of the log, which is simply ignored
+    std::ifstream log(path("positions.log"), std::ios::binary);
+    PositionEntry entry;
+    while (log.read(reinterpret_cast<char *>(&entry), sizeof(entry)))
+        m_pending.push_back(entry);
+
+    m_log.open(path("positions.log"), std::ios::out | std::ios::app | std::ios::binary);
+    m_gameList.open(path("games.tsv"), std::ios::out | std::ios::app);
+    if (!m_log || !m_gameList)
+        throw std::runtime_error("failed to open position index in " + m_directory);
+}
+
+std::span<const PositionEntry> PositionIndex::SortedRun::entries() const
+{
+    if (!file || !file->isMapped())
+        return {};
+
+    std::string_view data = file->getView();
+    return std::span<const PositionEntry>(reinterpret_cast<const PositionEntry *>(data.data() + headerSize),
+                                          (data.size() - headerSize) / sizeof(PositionEntry));
+}
+
+std::string PositionIndex::runPath(uint64_t id) const
+{
+    return m_directory + "/positions." + std::to_string(id) + ".idx";
+}
+
+void PositionIndex::sortPendingLocked() const
+{
+    if (m_sortedPending == m_pending.size())
+        return;
+    auto middle = m_pending.begin() + static_cast<std::ptrdiff_t>(m_sortedPending);
+    std::sort(middle, m_pending.end(), entryLess);
+    std::inplace_merge(m_pending.begin(), middle, m_pending.end(), entryLess);
+    m_sortedPending = m_pending.size();
+}
+
+uint32_t PositionIndex::addGame(const std::string &name, GameResult result, const GameManager &gm)
+{
+    const std::vector<uint64_t> &hashes = gm.getHashHistory();
+    const std::vector<Move> &moves = gm.getMoveHistory();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t gameId = static_cast<uint32_t>(m_games.size());
+
+    // the game line goes first, so log entries never point at an id a later game could reuse
+    m_gameList << gameId << '\t' << GameArchive::resultToString(result) << '\t' << name << '\n';
+    m_gameList.flush();
+
+    std::vector<PositionEntry> entries;
+    size_t plies = std::min<size_t>(hashes.size(), noMove);
+    entries.reserve(plies);
+    for (size_t ply = 0; ply < plies; ply++)
+        entries.push_back({hashes[ply], gameId, static_cast<uint16_t>(ply), ply < moves.size() ? packMove(moves[ply]) : noMove});
+
+    m_log.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PositionEntry));
+    m_log.flush();
+    if (!m_gameList || !m_log)
+        throw std::runtime_error("failed to write position index in " + m_directory);
+
+    m_pending.insert(m_pending.end(), entries.begin(), entries.end());
+
+    m_games.push_back({name, result, true});
+    auto [it, inserted] = m_gameIds.try_emplace(name, gameId);
+    if (!inserted)
+    {
+        m_games[it->second].live = false;
+        it->second = gameId;
+    }
+
+    if (m_pending.size() >= compactThreshold)
+        flushPendingLocked();
+    return gameId;
+}
+
+std::vector<PositionEntry> PositionIndex::findLocked(uint64_t hash) const
+{
+    std::vector<PositionEntry> hits;
+    auto collect = [&](auto first, auto last)
+    {
+        for (; first != last; ++first)
+        {
+            if (first->gameId < m_games.size() && m_games[first->gameId].live)
+                hits.push_back(*first);
+        }
+    };
+
+    for (const SortedRun &run : m_runs)
+    {
+        std::span<const PositionEntry> sorted = run.entries();
+        auto low = std::lower_bound(sorted.begin(), sorted.end(), hash, hashLess);
+        collect(low, std::upper_bound(low, sorted.end(), hash, hashGreater));
+    }
+    sortPendingLocked();
+    auto pendingLow = std::lower_bound(m_pending.begin(), m_pending.end(), hash, hashLess);
+    collect(pendingLow, std::upper_bound(pendingLow, m_pending.end(), hash, hashGreater));
+
+    // an interrupted compaction or merge leaves the same entries in two places
+    std::sort(hits.begin(), hits.end(), entryLess);
+    hits.erase(std::unique(hits.begin(), hits.end(), sameEntry), hits.end());
+    return hits;
+}
+
+std::vector<PositionEntry> PositionIndex::find(uint64_t hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return findLocked(hash);
+}
+
+std::vector<ExplorerLine> PositionIndex::explore(uint64_t hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<uint16_t, ExplorerLine> lines;
+    uint32_t lastGame = UINT32_MAX;
+    std::vector<uint16_t> seen;
+    for (const PositionEntry &entry : findLocked(hash))
+    {
+        if (entry.nextMove == noMove)
+            continue;
+
+        // a game that repeats the position counts once per move played from it
+        if (entry.gameId != lastGame)
+        {
+            lastGame = entry.gameId;
+            seen.clear();
+        }
+        if (std::find(seen.begin(), seen.end(), entry.nextMove) != seen.end())
+            continue;
+        seen.push_back(entry.nextMove);
+
+        ExplorerLine &line = lines[entry.nextMove];
+        line.move = entry.nextMove;
+        line.games++;
+        switch (m_games[entry.gameId].result)
+        {
+        case GameResult::WHITE_WINS:
+            line.whiteWins++;
+            break;
+        case GameResult::BLACK_WINS:
+            line.blackWins++;
+            break;
+        case GameResult::DRAW:
+            line.draws++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::vector<ExplorerLine> result;
+    for (const auto &[move, line] : lines)
+        result.push_back(line);
+    std::stable_sort(result.begin(), result.end(), [](const ExplorerLine &a, const ExplorerLine &b)
+                     { return a.games > b.games; });
+    return result;
+}
+
+std::optional<IndexedGame> PositionIndex::getGame(uint32_t id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_games.size())
+        return std::nullopt;
+    return m_games[id];
+}
+
+size_t PositionIndex::getGameCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_games.size();
+}
+
+size_t PositionIndex::getEntryCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_pending.size();
+    for (const SortedRun &run : m_runs)
+        count += run.entries().size();
+    return count;
+}
+
+void PositionIndex::compact()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_runs.empty() && m_pending.empty())
+        return;
+
+    sortPendingLocked();
+    std::vector<std::span<const PositionEntry>> sources;
+    for (const SortedRun &run : m_runs)
+        sources.push_back(run.entries());
+    sources.push_back(m_pending);
+
+    SortedRun merged = writeRun(m_nextRun++, sources);
+    for (const SortedRun &run : m_runs)
+        std::filesystem::remove(run.id ? runPath(run.id) : path("positions.idx"));
+    m_runs.clear();
+    m_runs.push_back(std::move(merged));
+    resetLogLocked();
+}
+
+void PositionIndex::flushPendingLocked()
+{
+    sortPendingLocked();
+    m_runs.push_back(writeRun(m_nextRun++, {m_pending}));
+    resetLogLocked();
+
+    while (m_runs.size() >= 2 && 2 * m_runs.back().entries().size() >= m_runs[m_runs.size() - 2].entries().size())
+        mergeRunsLocked(m_runs.size() - 2);
+}
+
+void PositionIndex::mergeRunsLocked(size_t first)
+{
+    std::vector<std::span<const PositionEntry>> sources;
+    for (size_t i = first; i < m_runs.size(); i++)
+        sources.push_back(m_runs[i].entries());
+
+    // the merge takes the place of the newest run, so a crash before the older ones are removed only duplicates
+    SortedRun merged = writeRun(m_runs.back().id, sources);
+    for (size_t i = first; i + 1 < m_runs.size(); i++)
+        std::filesystem::remove(m_runs[i].id ? runPath(m_runs[i].id) : path("positions.idx"));
+    m_runs.erase(m_runs.begin() + static_cast<std::ptrdiff_t>(first), m_runs.end());
+    m_runs.push_back(std::move(merged));
+}
+
+PositionIndex::SortedRun PositionIndex::writeRun(uint64_t id, const std::vector<std::span<const PositionEntry>> &sources) const
+{
+    const std::string runFile = runPath(id);
+    const std::string tmpPath = runFile + ".tmp";
+    std::ofstream out(tmpPath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!out)
+        throw std::runtime_error("failed to open " + tmpPath + " for writing");
+
+    char header[headerSize] = {};
+    std::memcpy(header, magic, 4);
+    out.write(header, headerSize);
+
+    std::vector<PositionEntry> block;
+    block.reserve(4096);
+    PositionEntry last{};
+    bool hasLast = false;
+    auto emit = [&](const PositionEntry &entry)
+    {
+        if (entry.gameId >= m_games.size() || !m_games[entry.gameId].live)
+            return;
+        if (hasLast && sameEntry(last, entry))
+            return;
+        last = entry;
+        hasLast = true;
+        block.push_back(entry);
+        if (block.size() == block.capacity())
+        {
+            out.write(reinterpret_cast<const char *>(block.data()), block.size() * sizeof(PositionEntry));
+            block.clear();
+        }
+    };
+
+    // a handful of sources at most, so the smallest head is simply searched for
+    std::vector<size_t> next(sources.size(), 0);
+    while (true)
+    {
+        size_t best = sources.size();
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            if (next[i] < sources[i].size() && (best == sources.size() || entryLess(sources[i][next[i]], sources[best][next[best]])))
+                best = i;
+        }
+        if (best == sources.size())
+            break;
+        emit(sources[best][next[best]++]);
+    }
+    out.write(reinterpret_cast<const char *>(block.data()), block.size() * sizeof(PositionEntry));
+    out.close();
+    if (!out)
+        throw std::runtime_error("failed to write " + tmpPath);
+
+    std::filesystem::rename(tmpPath, runFile);
+    return {id, std::make_unique<MappedFile>(runFile)};
+}
+
+void PositionIndex::resetLogLocked()
+{
+    m_pending.clear();
+    m_sortedPending = 0;
+    m_log.close();
+    m_log.open(path("positions.log"), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_log)
+        throw std::runtime_error("failed to reset " + path("positions.log"));
+}
+
+uint16_t PositionIndex::packMove(const Move &move)
+{
+    uint16_t packed = static_cast<uint16_t>(squareIndex(move.from) | (squareIndex(move.to) << 6));
+    for (int i = 0; i < 4; i++)
+    {
+        if (move.promotion == promotionPieces[i])
+            packed |= static_cast<uint16_t>((1 << 14) | (i << 12));
+    }
+    return packed;
+}
+
+Move PositionIndex::unpackMove(uint16_t packed)
+{
+    Move move{squareAt(packed & 63), squareAt((packed >> 6) & 63)};
+    if (packed & (1 << 14))
+        move.promotion = promotionPieces[(packed >> 12) & 3];
+    return move;
+}
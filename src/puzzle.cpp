@@ -0,0 +1,164 @@
+#include "puzzle.h"
+#include "chess.h"
+#include "factory.h"
+#include "fen.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+bool PuzzleMiner::claim(uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_seen.insert(hash).second;
+}
+
+std::optional<Puzzle> PuzzleMiner::verify(GameManager &gm, const SearchBoard &board, SearchEngine &engine, uint64_t &nodes) const
+{
+    SearchResult best = engine.search(board, m_options.verify);
+    nodes += best.nodes;
+    if (!best.bestMove || best.score < m_options.win)
+        return std::nullopt;
+
+    // the second line is the best the position offers without the first move; a puzzle allows no other way to win
+    SearchResult second = engine.search(board, m_options.verify, {SearchBoard::fromMove(*best.bestMove)});
+    nodes += second.nodes;
+    if (second.bestMove && (second.score >= m_options.win / 2 || best.score - second.score < m_options.uniqueGap))
+        return std::nullopt;
+
+    Puzzle puzzle;
+    puzzle.hash = board.getHash();
+    puzzle.score = best.score;
+    puzzle.secondScore = second.bestMove ? second.score : -SearchEngine::infinity;
+
+    // the line ends on a move of the solver, the reply after it is not part of the answer
+    size_t length = std::min(best.pv.size(), m_options.maxSolution);
+    if (length % 2 == 0)
+        length--;
+    PieceFactory factory;
+    GameManager line(factory);
+    FenNotation::fromFen(line, FenNotation::toFen(gm));
+    for (size_t i = 0; i < length; i++)
+    {
+        std::string san = SanNotation::toSan(line, best.pv[i]);
+        if (!line.replayMove(best.pv[i]))
+            break;
+        puzzle.solution.push_back(san + SanNotation::checkSuffix(line));
+    }
+
+    std::string pv;
+    for (const std::string &san : puzzle.solution)
+        pv += (pv.empty() ? "" : " ") + san;
+    EpdOperations operations = {{"bm", puzzle.solution.front()}, {"pv", pv}};
+    if (SearchEngine::isMateScore(best.score))
+        operations.emplace_back("dm", std::to_string((SearchEngine::mateScore - best.score + 1) / 2));
+    else
+        operations.emplace_back("ce", std::to_string(best.score));
+    puzzle.epd = FenNotation::toEpd(gm, operations);
+    return puzzle;
+}
+
+void PuzzleMiner::mineGame(const AnalysisJob &job, size_t gameIndex, SearchEngine &engine, GameManager &gm, PuzzleStats &stats)
+{
+    const size_t plies = job.moves.empty() ? job.game.moves.size() : job.moves.size();
+    GameAnalyzer::setupJob(job, gm);
+    engine.clearTable();
+    SearchBoard board(gm);
+    SearchResult previous = engine.search(board, m_options.filter);
+    stats.nodes += previous.nodes;
+    stats.positions++;
+
+    for (size_t ply = 0; ply < plies; ply++)
+    {
+        const Move move = GameAnalyzer::resolveMove(job, gm, ply);
+        if (!gm.replayMove(move) || !board.makeMove(SearchBoard::fromMove(move)))
+            throw std::runtime_error("failed to replay move " + std::to_string(ply + 1));
+
+        SearchResult current = engine.search(board, m_options.filter);
+        stats.nodes += current.nodes;
+        stats.positions++;
+
+        // previous.score is the opponent's view before its move, so this is how much its move gave away
+        const int gain = current.score + previous.score;
+        previous = current;
+        if (gain < m_options.swing || current.score <= 0 || !current.bestMove)
+            continue;
+
+        stats.candidates++;
+        if (!claim(board.getHash()))
+        {
+            stats.duplicates++;
+            continue;
+        }
+        std::optional<Puzzle> puzzle = verify(gm, board, engine, stats.nodes);
+        if (!puzzle)
+            continue;
+
+        puzzle->game = job.name;
+        puzzle->gameIndex = gameIndex;
+        puzzle->ply = ply + 1;
+        puzzle->epd += " id \"" + job.name + " ply " + std::to_string(ply + 1) + "\";";
+        stats.puzzles++;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_puzzles.push_back(std::move(*puzzle));
+    }
+}
+
+PuzzleStats PuzzleMiner::run(const std::vector<AnalysisJob> &jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_puzzles.clear();
+    m_seen.clear();
+    std::atomic<size_t> nextGame{0};
+    PuzzleStats total;
+    total.games = jobs.size();
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::max(1u, m_options.threads); t++)
+    {
+        workers.emplace_back([&]
+                             {
+            PieceFactory factory;
+            GameManager gm(factory);
+            SearchEngine engine(m_options.tableMegabytes);
+            PuzzleStats stats;
+            for (size_t i = nextGame++; i < jobs.size(); i = nextGame++)
+            {
+                try
+                {
+                    mineGame(jobs[i], i, engine, gm, stats);
+                }
+                catch (const std::exception &)
+                {
+                    // a game that does not replay still gave its puzzles up to the bad move
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            total.positions += stats.positions;
+            total.candidates += stats.candidates;
+            total.duplicates += stats.duplicates;
+            total.puzzles += stats.puzzles;
+            total.nodes += stats.nodes; });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+
+    std::sort(m_puzzles.begin(), m_puzzles.end(), [](const Puzzle &a, const Puzzle &b)
+              { return a.gameIndex != b.gameIndex ? a.gameIndex < b.gameIndex : a.ply < b.ply; });
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+void PuzzleMiner::writeEpd(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("failed to open " + path);
+    for (const Puzzle &puzzle : m_puzzles)
+        out << puzzle.epd << '\n';
+    if (!out.flush())
+        throw std::runtime_error("failed to write " + path);
+}
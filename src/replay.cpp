@@ -0,0 +1,41 @@
+#include "classes.h"
+#include "replay.h"
+
+bool GameReplayer::play(const Move &move)
+{
+    if (!m_outcome.ok)
+        return false;
+
+    if (m_mode == ReplayMode::VALIDATED && !m_gm.isLegalMove(move))
+    {
+        m_outcome.ok = false;
+        m_outcome.error = "ply " + std::to_string(m_outcome.plies + 1) + ": illegal move";
+        return false;
+    }
+    if (!m_gm.replayMove(move))
+    {
+        m_outcome.ok = false;
+        m_outcome.error = "ply " + std::to_string(m_outcome.plies + 1) + ": move does not fit the position";
+        return false;
+    }
+
+    m_outcome.plies++;
+    return true;
+}
+
+const ReplayOutcome &GameReplayer::finish()
+{
+    m_outcome.status = m_gm.evaluateStatus();
+    return m_outcome;
+}
+
+ReplayOutcome GameReplayer::replay(GameManager &gm, const std::vector<Move> &moves, ReplayMode mode)
+{
+    GameReplayer replayer(gm, mode);
+    for (const Move &move : moves)
+    {
+        if (!replayer.play(move))
+            break;
+    }
+    return replayer.finish();
+}
@@ -0,0 +1,490 @@
+#include "rules.h"
+#include "fen.h"
+#include "alloc.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    bool onBoard(const Position &position)
+    {
+        return position.col >= 'a' && position.col <= 'h' && position.row >= 1 && position.row <= 8;
+    }
+
+    /// @brief squares past h8 decode to positions off the board, which the service answers as BAD_REQUEST
+    Position fromSquare(uint8_t square)
+    {
+        return Position(static_cast<char>('a' + square % 8), square / 8 + 1);
+    }
+
+    uint8_t toSquare(const Position &position)
+    {
+        return onBoard(position) ? squareIndex(position) : noSquare;
+    }
+
+    char promotionCode(PieceType type)
+    {
+        switch (type)
+        {
+        case PieceType::QUEEN:
+            return 'q';
+        case PieceType::ROOK:
+            return 'r';
+        case PieceType::BISHOP:
+            return 'b';
+        case PieceType::KNIGHT:
+            return 'n';
+        case PieceType::PAWN:
+            return 0;
+        default:
+            return '?';
+        }
+    }
+
+    /// @brief KING stands for a code that is no promotion piece
+    PieceType promotionType(char code)
+    {
+        switch (code)
+        {
+        case 'q':
+            return PieceType::QUEEN;
+        case 'r':
+            return PieceType::ROOK;
+        case 'b':
+            return PieceType::BISHOP;
+        case 'n':
+            return PieceType::KNIGHT;
+        case 0:
+            return PieceType::PAWN;
+        default:
+            return PieceType::KING;
+        }
+    }
+
+    bool hasMove(RulesQuery query)
+    {
+        return query == RulesQuery::VALIDATE || query == RulesQuery::PLAY;
+    }
+
+    void putByte(std::string &out, uint8_t value)
+    {
+        out += static_cast<char>(value);
+    }
+
+    template <typename T>
+    void putValue(std::string &out, T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void putMove(std::string &out, const Move &move)
+    {
+        putByte(out, toSquare(move.from));
+        putByte(out, toSquare(move.to));
+        putByte(out, static_cast<uint8_t>(promotionCode(move.promotion)));
+    }
+
+    /// @brief bounds-checked cursor over a payload
+    struct Reader
+    {
+        std::string_view data;
+
+        void need(size_t bytes) const
+        {
+            if (data.size() < bytes)
+                throw std::invalid_argument("truncated rules payload");
+        }
+        uint8_t byte()
+        {
+            need(1);
+            uint8_t value = static_cast<uint8_t>(data[0]);
+            data.remove_prefix(1);
+            return value;
+        }
+        template <typename T>
+        T value()
+        {
+            need(sizeof(T));
+            T result;
+            std::memcpy(&result, data.data(), sizeof(T));
+            data.remove_prefix(sizeof(T));
+            return result;
+        }
+        std::string_view bytes(size_t count)
+        {
+            need(count);
+            std::string_view result = data.substr(0, count);
+            data.remove_prefix(count);
+            return result;
+        }
+        Move move()
+        {
+            need(3);
+            Position from = fromSquare(byte());
+            Position to = fromSquare(byte());
+            return {from, to, promotionType(static_cast<char>(byte()))};
+        }
+    };
+
+    bool readAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t received = recv(fd, data, size, 0);
+            if (received <= 0)
+            {
+                if (received < 0 && errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    bool writeAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            // a peer that went away must not take the process down with SIGPIPE
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    /// @brief reads one length-prefixed frame into payload
+    bool readFrame(int fd, std::string &payload)
+    {
+        uint32_t size;
+        if (!readAll(fd, reinterpret_cast<char *>(&size), sizeof(size)) || size > RulesServer::maxPayload)
+            return false;
+        payload.resize(size);
+        return readAll(fd, payload.data(), size);
+    }
+
+    sockaddr_un socketAddress(const std::string &path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("socket path is too long: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+}
+
+bool RulesService::load(std::string_view fen)
+{
+    if (!m_position.empty() && fen == m_position)
+        return true;
+    m_position.clear();
+    try
+    {
+        FenNotation::fromFen(m_gm, fen);
+    }
+    catch (const std::exception &)
+    {
+        // fromFen also refuses positions without exactly one king a side, which have no status to ask about
+        return false;
+    }
+    m_position = fen;
+    return true;
+}
+
+void RulesService::answer(const RulesRequest &request, RulesResponse &response)
+{
+    response.error = RulesError::NONE;
+    response.legal = false;
+    response.status = GameStatus::ONGOING;
+    response.inCheck = false;
+    response.moves.clear();
+    response.fen.clear();
+
+    if (request.query > RulesQuery::LEGAL_MOVES)
+    {
+        response.error = RulesError::BAD_REQUEST;
+        return;
+    }
+    if (hasMove(request.query) &&
+        (!onBoard(request.move.from) || !onBoard(request.move.to) || request.move.promotion == PieceType::KING))
+    {
+        response.error = RulesError::BAD_REQUEST;
+        return;
+    }
+    if (!load(request.fen))
+    {
+        response.error = RulesError::BAD_FEN;
+        return;
+    }
+
+    switch (request.query)
+    {
+    case RulesQuery::VALIDATE:
+    case RulesQuery::PLAY:
+    {
+        const Move &move = request.move;
+        const PieceInterface *piece = m_gm.getBoard().getPieceAt(move.from);
+        // the promotion piece is part of the move: required on the last rank, wrong anywhere else
+        const bool promotes = piece && piece->getType() == PieceType::PAWN && (move.to.row == 1 || move.to.row == 8);
+        response.legal = promotes == (move.promotion != PieceType::PAWN) && m_gm.isLegalMove(move);
+        if (request.query == RulesQuery::PLAY && response.legal)
+        {
+            m_gm.replayMove(move);
+            m_position.clear();
+            response.status = m_gm.evaluateStatus();
+            response.inCheck = m_gm.isInCheck();
+            response.fen = FenNotation::toFen(m_gm);
+        }
+        break;
+    }
+    case RulesQuery::STATUS:
+        response.status = m_gm.evaluateStatus();
+        response.inCheck = m_gm.isInCheck();
+        break;
+    case RulesQuery::LEGAL_MOVES:
+        response.moves = m_gm.generateLegalMoves(m_gm.getCurrentTurnColor());
+        response.status = m_gm.evaluateStatus();
+        response.inCheck = m_gm.isInCheck();
+        break;
+    }
+}
+
+void RulesService::evaluate(const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses)
+{
+    responses.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); i++)
+        answer(requests[i], responses[i]);
+}
+
+std::vector<RulesResponse> RulesService::evaluate(const std::vector<RulesRequest> &requests)
+{
+    std::vector<RulesResponse> responses;
+    evaluate(requests, responses);
+    return responses;
+}
+
+void RulesService::evaluate(std::string_view requestPayload, std::string &responsePayload)
+{
+    decodeRequests(requestPayload, m_requests);
+    evaluate(m_requests, m_responses);
+    encodeResponses(m_requests, m_responses, responsePayload);
+}
+
+void RulesService::encodeRequests(const std::vector<RulesRequest> &requests, std::string &payload)
+{
+    payload.clear();
+    putValue<uint32_t>(payload, static_cast<uint32_t>(requests.size()));
+    for (const RulesRequest &request : requests)
+    {
+        if (request.fen.size() > 255)
+            throw std::invalid_argument("FEN longer than 255 characters: " + request.fen);
+        putByte(payload, static_cast<uint8_t>(request.query));
+        putByte(payload, static_cast<uint8_t>(request.fen.size()));
+        payload += request.fen;
+        if (hasMove(request.query))
+            putMove(payload, request.move);
+    }
+}
+
+void RulesService::decodeRequests(std::string_view payload, std::vector<RulesRequest> &requests)
+{
+    Reader reader{payload};
+    const uint32_t count = reader.value<uint32_t>();
+    // every request takes at least two bytes, so a count beyond that is a broken frame and not an allocation
+    reader.need(std::min<size_t>(count, payload.size()) * 2);
+    requests.resize(count);
+    for (RulesRequest &request : requests)
+    {
+        request.query = static_cast<RulesQuery>(reader.byte());
+        request.fen.assign(reader.bytes(reader.byte()));
+        if (hasMove(request.query))
+            request.move = reader.move();
+    }
+}
+
+void RulesService::encodeResponses(const std::vector<RulesRequest> &requests, const std::vector<RulesResponse> &responses, std::string &payload)
+{
+    payload.clear();
+    putValue<uint32_t>(payload, static_cast<uint32_t>(responses.size()));
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        const RulesResponse &response = responses[i];
+        putByte(payload, static_cast<uint8_t>(response.error));
+        putByte(payload, response.legal);
+        putByte(payload, static_cast<uint8_t>(response.status));
+        putByte(payload, response.inCheck);
+        if (response.error != RulesError::NONE)
+            continue;
+        if (requests[i].query == RulesQuery::LEGAL_MOVES)
+        {
+            putValue<uint16_t>(payload, static_cast<uint16_t>(response.moves.size()));
+            for (const Move &move : response.moves)
+                putMove(payload, move);
+        }
+        else if (requests[i].query == RulesQuery::PLAY && response.legal)
+        {
+            putByte(payload, static_cast<uint8_t>(response.fen.size()));
+            payload += response.fen;
+        }
+    }
+}
+
+void RulesService::decodeResponses(std::string_view payload, const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses)
+{
+    Reader reader{payload};
+    if (reader.value<uint32_t>() != requests.size())
+        throw std::invalid_argument("rules response does not match its requests");
+    responses.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        RulesResponse &response = responses[i];
+        response.error = static_cast<RulesError>(reader.byte());
+        response.legal = reader.byte() != 0;
+        response.status = static_cast<GameStatus>(reader.byte());
+        response.inCheck = reader.byte() != 0;
+        response.moves.clear();
+        response.fen.clear();
+        if (response.error != RulesError::NONE)
+            continue;
+        if (requests[i].query == RulesQuery::LEGAL_MOVES)
+        {
+            const uint16_t count = reader.value<uint16_t>();
+            for (uint16_t m = 0; m < count; m++)
+                response.moves.push_back(reader.move());
+        }
+        else if (requests[i].query == RulesQuery::PLAY && response.legal)
+            response.fen.assign(reader.bytes(reader.byte()));
+    }
+}
+
+RulesServer::RulesServer(std::string path) : m_path(std::move(path))
+{
+    sockaddr_un address = socketAddress(m_path);
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // a socket file left behind by a server that did not shut down would make bind fail
+    unlink(m_path.c_str());
+    if (m_listenFd < 0 || bind(m_listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(m_listenFd, 128) < 0)
+    {
+        std::string error = std::strerror(errno);
+        if (m_listenFd >= 0)
+            close(m_listenFd);
+        throw std::runtime_error("failed to listen on " + m_path + ": " + error);
+    }
+    m_acceptor = std::thread(&RulesServer::acceptLoop, this);
+}
+
+RulesServer::~RulesServer()
+{
+    m_stop = true;
+    // wakes the acceptor out of accept, and every connection out of its read
+    shutdown(m_listenFd, SHUT_RDWR);
+    m_acceptor.join();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &connection : m_connections)
+            shutdown(connection->fd, SHUT_RDWR);
+    }
+    for (const auto &connection : m_connections)
+    {
+        connection->thread.join();
+        close(connection->fd);
+    }
+    close(m_listenFd);
+    unlink(m_path.c_str());
+}
+
+void RulesServer::acceptLoop()
+{
+    while (!m_stop)
+    {
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        Connection *served = connection.get();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // connections that have ended are reaped here, so a long-running server does not collect them
+        std::erase_if(m_connections, [](const std::unique_ptr<Connection> &c)
+                      {
+                          if (!c->done)
+                              return false;
+                          c->thread.join();
+                          close(c->fd);
+                          return true; });
+        served->thread = std::thread([served]
+                                     {
+                                         serve(served->fd);
+                                         served->done = true; });
+        m_connections.push_back(std::move(connection));
+    }
+}
+
+void RulesServer::serve(int fd)
+{
+    ALLOC_SCOPE(AllocSubsystem::IO);
+    RulesService service;
+    std::string request;
+    std::string response;
+    while (readFrame(fd, request))
+    {
+        try
+        {
+            service.evaluate(request, response);
+        }
+        catch (const std::exception &)
+        {
+            // nothing can be answered on a frame that does not decode
+            return;
+        }
+        const uint32_t size = static_cast<uint32_t>(response.size());
+        if (!writeAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) || !writeAll(fd, response.data(), response.size()))
+            return;
+    }
+}
+
+RulesClient::RulesClient(const std::string &path)
+{
+    sockaddr_un address = socketAddress(path);
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0 || connect(m_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+    {
+        std::string error = std::strerror(errno);
+        if (m_fd >= 0)
+            close(m_fd);
+        throw std::runtime_error("failed to connect to " + path + ": " + error);
+    }
+}
+
+RulesClient::~RulesClient()
+{
+    close(m_fd);
+}
+
+void RulesClient::call(const std::vector<RulesRequest> &requests, std::vector<RulesResponse> &responses)
+{
+    RulesService::encodeRequests(requests, m_buffer);
+    const uint32_t size = static_cast<uint32_t>(m_buffer.size());
+    if (!writeAll(m_fd, reinterpret_cast<const char *>(&size), sizeof(size)) || !writeAll(m_fd, m_buffer.data(), m_buffer.size()) ||
+        !readFrame(m_fd, m_buffer))
+        throw std::runtime_error("rules server closed the connection");
+    RulesService::decodeResponses(m_buffer, requests, responses);
+}
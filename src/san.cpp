@@ -0,0 +1,497 @@
+#include "classes.h"
+#include "san.h"
+#include "pgnstream.h"
+#include "fen.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    /// @brief tags every exported game carries, in this order
+    const std::array<std::pair<const char *, const char *>, 7> sevenTagRoster = {{
+        {"Event", "?"},
+        {"Site", "?"},
+        {"Date", "????.??.??"},
+        {"Round", "?"},
+        {"White", "?"},
+        {"Black", "?"},
+        {"Result", "*"},
+    }};
+
+    PieceType pieceTypeFromSymbol(char symbol)
+    {
+        switch (symbol)
+        {
+        case 'K':
+            return PieceType::KING;
+        case 'Q':
+            return PieceType::QUEEN;
+        case 'R':
+            return PieceType::ROOK;
+        case 'B':
+            return PieceType::BISHOP;
+        case 'N':
+            return PieceType::KNIGHT;
+        default:
+            return PieceType::PAWN;
+        }
+    }
+
+    void appendComment(std::string &target, std::string_view comment)
+    {
+        while (!comment.empty() && std::isspace(static_cast<unsigned char>(comment.front())))
+            comment.remove_prefix(1);
+        while (!comment.empty() && std::isspace(static_cast<unsigned char>(comment.back())))
+            comment.remove_suffix(1);
+        if (comment.empty())
+            return;
+        if (!target.empty())
+            target += ' ';
+        target += comment;
+    }
+
+    std::string escapeTagValue(const std::string &value)
+    {
+        std::string escaped;
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+std::string PgnGame::getTag(const std::string &name) const
+{
+    for (const auto &[key, value] : tags)
+    {
+        if (key == name)
+            return value;
+    }
+    return "";
+}
+
+void PgnGame::setTag(const std::string &name, const std::string &value)
+{
+    for (auto &[key, existing] : tags)
+    {
+        if (key == name)
+        {
+            existing = value;
+            return;
+        }
+    }
+    tags.emplace_back(name, value);
+}
+
+std::string SanNotation::toSan(GameManager &gm, const Move &move)
+{
+    const Board &board = gm.getBoard();
+    PieceInterface *piece = board.getPieceAt(move.from);
+    if (!piece)
+        throw std::runtime_error("no piece at source square");
+
+    if (piece->getType() == PieceType::KING && std::abs(move.to.col - move.from.col) == 2)
+        return (move.to.col > move.from.col) ? "O-O" : "O-O-O";
+
+    std::string san;
+    bool isPawn = piece->getType() == PieceType::PAWN;
+    bool isCapture = board.getPieceAt(move.to) != nullptr || (isPawn && move.from.col != move.to.col);
+
+    if (isPawn)
+    {
+        if (isCapture)
+            san += move.from.col;
+    }
+    else
+    {
+        san += piece->getSymbol();
+
+        // another piece of the same kind that can legally reach the square needs disambiguation
+        bool ambiguous = false;
+        bool sharesCol = false;
+        bool sharesRow = false;
+        for (int row = 1; row <= 8; row++)
+        {
+            for (char col = 'a'; col <= 'h'; col++)
+            {
+                if (col == move.from.col && row == move.from.row)
+                    continue;
+                PieceInterface *other = board.getPieceAt(Position(col, row));
+                if (!other || other->getType() != piece->getType() || other->getColor() != piece->getColor())
+                    continue;
+                if (!gm.isLegalMove({Position(col, row), move.to}))
+                    continue;
+                ambiguous = true;
+                sharesCol = sharesCol || col == move.from.col;
+                sharesRow = sharesRow || row == move.from.row;
+            }
+        }
+
+        if (ambiguous)
+        {
+            if (!sharesCol)
+                san += move.from.col;
+            else if (!sharesRow)
+                san += std::to_string(move.from.row);
+            else
+                san += std::string(1, move.from.col) + std::to_string(move.from.row);
+        }
+    }
+
+    if (isCapture)
+        san += 'x';
+    san += move.to.col;
+    san += std::to_string(move.to.row);
+
+    if (move.promotion != PieceType::PAWN)
+        san += "=" + gm.promotionTypeToString(move.promotion);
+
+    return san;
+}
+
+std::string SanNotation::checkSuffix(GameManager &gm)
+{
+    if (!gm.isInCheck())
+        return "";
+    return gm.evaluateStatus() == GameStatus::CHECKMATE ? "#" : "+";
+}
+
+std::optional<Move> SanNotation::fromSan(GameManager &gm, std::string_view san)
+{
+    // check markers and annotation glyphs carry no information for resolving the move
+    while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos)
+        san.remove_suffix(1);
+    if (san.empty())
+        return std::nullopt;
+
+    PieceColor color = gm.getCurrentTurnColor();
+    int homeRow = (color == PieceColor::WHITE) ? 1 : 8;
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
+    {
+        Move castle{Position('e', homeRow), Position(san.size() == 3 ? 'g' : 'c', homeRow)};
+        PieceInterface *king = gm.getBoard().getPieceAt(castle.from);
+        if (king && king->getType() == PieceType::KING && gm.isLegalMove(castle))
+            return castle;
+        return std::nullopt;
+    }
+
+    PieceType type = pieceTypeFromSymbol(san.front());
+    if (type != PieceType::PAWN)
+        san.remove_prefix(1);
+
+    PieceType promotion = PieceType::PAWN;
+    size_t eq = san.find('=');
+    if (eq != std::string_view::npos)
+    {
+        if (eq + 1 >= san.size())
+            return std::nullopt;
+        promotion = pieceTypeFromSymbol(static_cast<char>(std::toupper(san[eq + 1])));
+        san = san.substr(0, eq);
+    }
+    else if (type == PieceType::PAWN && !san.empty() && std::string_view("QRBN").find(san.back()) != std::string_view::npos)
+    {
+        // some tools write promotions without the '=' sign, e.g. e8Q
+        promotion = pieceTypeFromSymbol(san.back());
+        san.remove_suffix(1);
+    }
+
+    if (san.size() < 2)
+        return std::nullopt;
+
+    char toCol = san[san.size() - 2];
+    int toRow = san[san.size() - 1] - '0';
+    if (toCol < 'a' || toCol > 'h' || toRow < 1 || toRow > 8)
+        return std::nullopt;
+    Position to(toCol, toRow);
+
+    char fromCol = '\0';
+    int fromRow = 0;
+    for (char c : san.substr(0, san.size() - 2))
+    {
+        if (c >= 'a' && c <= 'h')
+            fromCol = c;
+        else if (c >= '1' && c <= '8')
+            fromRow = c - '0';
+        else if (c != 'x' && c != ':' && c != '-')
+            return std::nullopt;
+    }
+
+    bool reachesLastRank = type == PieceType::PAWN && (toRow == 1 || toRow == 8);
+    if (reachesLastRank != (promotion != PieceType::PAWN))
+        return std::nullopt;
+
+    std::optional<Move> found;
+    const Board &board = gm.getBoard();
+    for (int row = 1; row <= 8; row++)
+    {
+        if (fromRow && row != fromRow)
+            continue;
+        for (char col = 'a'; col <= 'h'; col++)
+        {
+            if (fromCol && col != fromCol)
+                continue;
+            PieceInterface *piece = board.getPieceAt(Position(col, row));
+            if (!piece || piece->getColor() != color || piece->getType() != type)
+                continue;
+
+            Move candidate{Position(col, row), to, promotion};
+            if (!gm.isLegalMove(candidate))
+                continue;
+            if (found)
+                return std::nullopt; // ambiguous
+            found = candidate;
+        }
+    }
+    return found;
+}
+
+bool SanNotation::parseGame(std::string_view &text, PgnGame &game)
+{
+    game = PgnGame();
+    PgnTokenizer tokenizer(text);
+    PgnToken token;
+    size_t before = 0;
+    bool found = false;
+
+    while (tokenizer.next(token))
+    {
+        found = true;
+        switch (token.type)
+        {
+        case PgnTokenType::TAG:
+        {
+            // a tag after movetext belongs to the next game
+            if (!game.moves.empty())
+            {
+                tokenizer.setPosition(before);
+                text.remove_prefix(before);
+                return true;
+            }
+            std::string value;
+            for (size_t i = 0; i < token.value.size(); i++)
+            {
+                if (token.value[i] == '\\' && i + 1 < token.value.size())
+                    i++;
+                value += token.value[i];
+            }
+            game.tags.emplace_back(std::string(token.text), value);
+            break;
+        }
+        case PgnTokenType::COMMENT:
+            appendComment(game.moves.empty() ? game.comment : game.moves.back().comment, token.text);
+            break;
+        case PgnTokenType::VARIATION:
+            if (!game.moves.empty())
+            {
+                std::string variation;
+                appendComment(variation, token.text);
+                game.moves.back().variations.push_back(variation);
+            }
+            break;
+        case PgnTokenType::SAN:
+            game.moves.push_back({std::string(token.text), "", {}});
+            break;
+        case PgnTokenType::RESULT:
+            game.result = std::string(token.text);
+            text.remove_prefix(tokenizer.getPosition());
+            return true;
+        default:
+            break;
+        }
+        before = tokenizer.getPosition();
+    }
+
+    text.remove_prefix(text.size());
+    return found;
+}
+
+std::string SanNotation::writeGame(const PgnGame &game)
+{
+    std::string out;
+
+    auto writeTag = [&out](const std::string &name, const std::string &value)
+    {
+        out += "[" + name + " \"" + escapeTagValue(value) + "\"]\n";
+    };
+
+    for (const auto &[name, fallback] : sevenTagRoster)
+    {
+        std::string value = (std::string(name) == "Result") ? game.result : game.getTag(name);
+        writeTag(name, value.empty() ? fallback : value);
+    }
+    for (const auto &[name, value] : game.tags)
+    {
+        bool inRoster = false;
+        for (const auto &[rosterName, fallback] : sevenTagRoster)
+            inRoster = inRoster || name == rosterName;
+        if (!inRoster)
+            writeTag(name, value);
+    }
+    out += "\n";
+
+    // movetext is wrapped below 80 columns as the export format requires
+    std::string line;
+    auto emit = [&out, &line](const std::string &token)
+    {
+        if (!line.empty() && line.size() + 1 + token.size() > 79)
+        {
+            out += line + "\n";
+            line.clear();
+        }
+        if (!line.empty())
+            line += ' ';
+        line += token;
+    };
+
+    if (!game.comment.empty())
+        emit("{" + game.comment + "}");
+
+    // a game set up from a FEN starts counting at that position's move number and side
+    size_t firstPly = 0;
+    if (std::string fen = game.getTag("FEN"); !fen.empty())
+    {
+        std::istringstream fields(fen);
+        std::string placement, side, castling, enPassant;
+        size_t halfmoveClock = 0, fullmove = 1;
+        fields >> placement >> side >> castling >> enPassant >> halfmoveClock >> fullmove;
+        firstPly = (std::max<size_t>(fullmove, 1) - 1) * 2 + (side == "b" ? 1 : 0);
+    }
+
+    bool needsNumber = true;
+    for (size_t index = 0; index < game.moves.size(); index++)
+    {
+        const PgnMove &move = game.moves[index];
+        size_t ply = index + firstPly;
+        size_t moveNumber = ply / 2 + 1;
+        if (ply % 2 == 0)
+            emit(std::to_string(moveNumber) + ". " + move.san);
+        else if (needsNumber)
+            emit(std::to_string(moveNumber) + "... " + move.san);
+        else
+            emit(move.san);
+
+        needsNumber = false;
+        if (!move.comment.empty())
+        {
+            emit("{" + move.comment + "}");
+            needsNumber = true;
+        }
+        for (const std::string &variation : move.variations)
+        {
+            emit("(" + variation + ")");
+            needsNumber = true;
+        }
+    }
+    emit(game.result);
+    out += line + "\n\n";
+    return out;
+}
+
+void SanNotation::importGame(GameManager &gm, const PgnGame &game, bool isReplay)
+{
+    if (std::string fen = game.getTag("FEN"); !fen.empty())
+        FenNotation::fromFen(gm, fen);
+
+    std::vector<std::string_view> moves;
+    moves.reserve(game.moves.size());
+    for (const PgnMove &pgnMove : game.moves)
+        moves.push_back(pgnMove.san);
+    importMoves(gm, moves, isReplay);
+
+    // kept so an export gives the game back under its own roster; the movetext result is the one that counts
+    PgnGame source;
+    source.tags = game.tags;
+    source.setTag("Result", game.result);
+    gm.setTags(std::move(source.tags));
+}
+
+void SanNotation::importMoves(GameManager &gm, const std::vector<std::string_view> &moves, bool isReplay)
+{
+    for (std::string_view san : moves)
+    {
+        std::optional<Move> move = fromSan(gm, san);
+        if (!move)
+            throw std::runtime_error("illegal or ambiguous move '" + std::string(san) + "'");
+
+        // a replay skips the interactive path: the move was just resolved against the legal moves
+        if (isReplay ? !gm.replayMove(*move) : !gm.applyMove(*move))
+            throw std::runtime_error("failed to replay move '" + std::string(san) + "'");
+    }
+}
+
+PgnGame SanNotation::exportGame(GameManager &gm)
+{
+    PgnGame game;
+    game.tags = gm.getTags();
+    if (game.tags.empty())
+    {
+        game.setTag("Event", "Casual game");
+        game.setTag("Site", "chess_backend");
+        game.setTag("Date", gm.getPgn().getCurrentDateString());
+        game.setTag("Round", "-");
+    }
+
+    if (!gm.getStartFen().empty())
+    {
+        game.setTag("SetUp", "1");
+        game.setTag("FEN", gm.getStartFen());
+    }
+
+    // a result reached here wins over the imported one, and the board decides when neither says
+    std::string result = gm.getPgn().getResult();
+    if (result.empty())
+        result = game.getTag("Result");
+    game.result = "*";
+    for (const char *token : {"1-0", "0-1", "1/2-1/2"})
+    {
+        if (result.starts_with(token))
+            game.result = token;
+    }
+    if (game.result == "*")
+    {
+        switch (gm.evaluateStatus())
+        {
+        case GameStatus::CHECKMATE:
+            game.result = gm.getCurrentTurnColor() == PieceColor::WHITE ? "0-1" : "1-0";
+            break;
+        case GameStatus::ONGOING:
+            break;
+        default:
+            game.result = "1/2-1/2";
+            break;
+        }
+    }
+
+    for (const std::string &san : gm.getSanHistory())
+        game.moves.push_back({san, "", {}});
+    return game;
+}
+
+bool SanNotation::readPgnFile(const std::string &path, PgnGame &game)
+{
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile)
+        throw std::runtime_error("failed to open " + path + " for reading");
+
+    std::ostringstream content;
+    content << inFile.rdbuf();
+    std::string text = content.str();
+    std::string_view view(text);
+    return parseGame(view, game);
+}
+
+void SanNotation::writePgnFile(const std::string &path, const PgnGame &game)
+{
+    std::ofstream outFile(path, std::ios::out | std::ios::trunc);
+    if (!outFile)
+        throw std::runtime_error("failed to open " + path + " for writing");
+    outFile << writeGame(game);
+}
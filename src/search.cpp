@@ -0,0 +1,533 @@
+#include "search.h"
+#include "chess.h"
+#include "trace.h"
+#include "alloc.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <format>
+
+namespace
+{
+    constexpr int pieceValues[7] = {0, 100, 320, 330, 500, 900, 0};
+
+    // piece-square tables from white's point of view, rank 8 first as on a diagram
+    constexpr int pawnTable[64] = {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+        5, 5, 10, 25, 25, 10, 5, 5,
+        0, 0, 0, 20, 20, 0, 0, 0,
+        5, -5, -10, 0, 0, -10, -5, 5,
+        5, 10, 10, -20, -20, 10, 10, 5,
+        0, 0, 0, 0, 0, 0, 0, 0};
+    constexpr int knightTable[64] = {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20, 0, 0, 0, 0, -20, -40,
+        -30, 0, 10, 15, 15, 10, 0, -30,
+        -30, 5, 15, 20, 20, 15, 5, -30,
+        -30, 0, 15, 20, 20, 15, 0, -30,
+        -30, 5, 10, 15, 15, 10, 5, -30,
+        -40, -20, 0, 5, 5, 0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50};
+    constexpr int bishopTable[64] = {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 10, 10, 5, 0, -10,
+        -10, 5, 5, 10, 10, 5, 5, -10,
+        -10, 0, 10, 10, 10, 10, 0, -10,
+        -10, 10, 10, 10, 10, 10, 10, -10,
+        -10, 5, 0, 0, 0, 0, 5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20};
+    constexpr int rookTable[64] = {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        5, 10, 10, 10, 10, 10, 10, 5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        0, 0, 0, 5, 5, 0, 0, 0};
+    constexpr int queenTable[64] = {
+        -20, -10, -10, -5, -5, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 5, 5, 5, 0, -10,
+        -5, 0, 5, 5, 5, 5, 0, -5,
+        0, 0, 5, 5, 5, 5, 0, -5,
+        -10, 5, 5, 5, 5, 5, 0, -10,
+        -10, 0, 5, 0, 0, 0, 0, -10,
+        -20, -10, -10, -5, -5, -10, -10, -20};
+    constexpr int kingMiddleTable[64] = {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+        20, 20, 0, 0, 0, 0, 20, 20,
+        20, 30, 10, 0, 0, 10, 30, 20};
+    constexpr int kingEndTable[64] = {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10, 0, 0, -10, -20, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -30, 0, 0, 0, 0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50};
+
+    constexpr const int *pieceTables[7] = {nullptr, pawnTable, knightTable, bishopTable, rookTable, queenTable, kingMiddleTable};
+
+    /// @brief non-pawn material of both sides below which kings should come forward
+    constexpr int endgameMaterial = 1300;
+
+    /// @brief mate scores are stored relative to the node, not the root, so they stay right wherever the entry is hit
+    int toTable(int score, int ply)
+    {
+        if (score > SearchEngine::mateScore - SearchEngine::maxPly)
+            return score + ply;
+        if (score < -SearchEngine::mateScore + SearchEngine::maxPly)
+            return score - ply;
+        return score;
+    }
+
+    int fromTable(int score, int ply)
+    {
+        if (score > SearchEngine::mateScore - SearchEngine::maxPly)
+            return score - ply;
+        if (score < -SearchEngine::mateScore + SearchEngine::maxPly)
+            return score + ply;
+        return score;
+    }
+
+    bool isCapture(const SearchBoard &board, SearchMove move)
+    {
+        int from = SearchBoard::moveFrom(move);
+        int to = SearchBoard::moveTo(move);
+        return board.pieceAt(to) != SearchBoard::EMPTY ||
+               (std::abs(board.pieceAt(from)) == SearchBoard::PAWN && from % 8 != to % 8);
+    }
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes)
+{
+    size_t entries = std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Entry), 1024);
+    m_entries.resize(std::bit_floor(entries));
+}
+
+void TranspositionTable::clear()
+{
+    std::fill(m_entries.begin(), m_entries.end(), Entry{});
+    m_age = 0;
+}
+
+const TranspositionTable::Entry *TranspositionTable::probe(uint64_t key) const
+{
+    const Entry &entry = m_entries[key & (m_entries.size() - 1)];
+    return (entry.bound != NONE && entry.key == key) ? &entry : nullptr;
+}
+
+void TranspositionTable::store(uint64_t key, SearchMove move, int score, int depth, Bound bound)
+{
+    Entry &entry = m_entries[key & (m_entries.size() - 1)];
+    // deeper results of the current search stay, anything from an older search can go
+    if (entry.key != key && entry.age == m_age && entry.depth > depth)
+        return;
+    if (entry.key == key && move == SearchBoard::noMove)
+        move = entry.move;
+    entry = {key, move, static_cast<int16_t>(score), static_cast<int8_t>(depth), bound, m_age};
+}
+
+void SearchEngine::clearTable()
+{
+    m_table.clear();
+    std::fill(&m_history[0][0][0], &m_history[0][0][0] + sizeof(m_history) / sizeof(int), 0);
+}
+
+int SearchEngine::evaluate(const SearchBoard &board)
+{
+    int score = 0;
+    int material = 0;
+    int kings[2] = {0, 0};
+    for (int square = 0; square < 64; square++)
+    {
+        int piece = board.pieceAt(square);
+        if (piece == SearchBoard::EMPTY)
+            continue;
+        int type = std::abs(piece);
+        // tables are drawn rank 8 first, so white squares are mirrored and black squares read as they are
+        int index = piece > 0 ? (7 - square / 8) * 8 + square % 8 : square;
+        if (type == SearchBoard::KING)
+        {
+            kings[piece > 0 ? 0 : 1] = index;
+            continue;
+        }
+        if (type != SearchBoard::PAWN)
+            material += pieceValues[type];
+        int value = pieceValues[type] + pieceTables[type][index];
+        score += piece > 0 ? value : -value;
+    }
+
+    const int *kingTable = material <= endgameMaterial ? kingEndTable : kingMiddleTable;
+    score += kingTable[kings[0]] - kingTable[kings[1]];
+    return score * board.getSide();
+}
+
+std::string SearchEngine::formatScore(int score)
+{
+    if (score > mateScore - maxPly)
+        return std::format("#{0}", (mateScore - score + 1) / 2);
+    if (score < -mateScore + maxPly)
+        return std::format("#-{0}", (mateScore + score + 1) / 2);
+    return std::format("{0:+.2f}", score / 100.0);
+}
+
+bool SearchEngine::shouldStop()
+{
+    // depth 1 always finishes, so there is a move to return
+    if (m_completedDepth == 0)
+        return false;
+    if (m_limits.nodes && m_nodes >= m_limits.nodes)
+        m_stopped = true;
+    else if ((m_nodes & 1023) == 0)
+    {
+        if (m_stopFlag && m_stopFlag->load(std::memory_order_relaxed))
+            m_stopped = true;
+        else if (m_limits.time.count() && std::chrono::steady_clock::now() - m_start >= m_limits.time)
+            m_stopped = true;
+    }
+    return m_stopped;
+}
+
+int SearchEngine::scoreMove(SearchMove move, SearchMove hashMove, int ply) const
+{
+    if (move == hashMove)
+        return 1 << 30;
+    int from = SearchBoard::moveFrom(move);
+    int to = SearchBoard::moveTo(move);
+    int promotion = SearchBoard::movePromotion(move);
+    if (isCapture(m_board, move) || promotion == SearchBoard::QUEEN)
+    {
+        // most valuable victim first, then least valuable attacker
+        int victim = std::abs(m_board.pieceAt(to));
+        if (victim == SearchBoard::EMPTY && promotion != SearchBoard::QUEEN)
+            victim = SearchBoard::PAWN;
+        return (1 << 24) + pieceValues[victim] * 16 + pieceValues[promotion] - std::abs(m_board.pieceAt(from));
+    }
+    if (move == m_killers[ply][0])
+        return (1 << 22) + 1;
+    if (move == m_killers[ply][1])
+        return 1 << 22;
+    return m_history[m_board.getSide() > 0 ? 0 : 1][from][to];
+}
+
+void SearchEngine::orderMoves(std::vector<SearchMove> &moves, SearchMove hashMove, int ply) const
+{
+    // no position has more than 218 moves; insertion sort, the lists are short and the order mostly settled
+    int scores[256];
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        int score = scoreMove(moves[i], hashMove, ply);
+        SearchMove move = moves[i];
+        size_t j = i;
+        for (; j > 0 && scores[j - 1] < score; j--)
+        {
+            scores[j] = scores[j - 1];
+            moves[j] = moves[j - 1];
+        }
+        scores[j] = score;
+        moves[j] = move;
+    }
+}
+
+int SearchEngine::quiescence(int alpha, int beta, int ply)
+{
+    m_nodes++;
+    m_pvLength[ply] = ply;
+    if (shouldStop())
+        return 0;
+    if (ply >= maxPly - 1)
+        return evaluate(m_board);
+
+    int standPat = evaluate(m_board);
+    if (standPat >= beta)
+        return standPat;
+    alpha = std::max(alpha, standPat);
+
+    std::vector<SearchMove> &moves = m_moves[ply];
+    m_board.generateCaptures(moves);
+    orderMoves(moves, SearchBoard::noMove, ply);
+    for (SearchMove move : moves)
+    {
+        if (!m_board.makeMove(move))
+            continue;
+        int score = -quiescence(-beta, -alpha, ply + 1);
+        m_board.unmakeMove();
+        if (m_stopped)
+            return 0;
+        if (score > alpha)
+        {
+            alpha = score;
+            if (score >= beta)
+                break;
+        }
+    }
+    return alpha;
+}
+
+int SearchEngine::search(int depth, int alpha, int beta, int ply)
+{
+    m_pvLength[ply] = ply;
+    if (ply > 0 && (m_board.isRepetition() || m_board.isRuleDraw()))
+        return 0;
+
+    const bool inCheck = m_board.inCheck();
+    if (inCheck && ply < maxPly / 2)
+        depth++;
+    if (depth <= 0)
+        return quiescence(alpha, beta, ply);
+    if (ply >= maxPly - 1)
+        return evaluate(m_board);
+
+    m_nodes++;
+    if (shouldStop())
+        return 0;
+
+    const bool pvNode = beta - alpha > 1;
+    SearchMove hashMove = SearchBoard::noMove;
+    if (const TranspositionTable::Entry *entry = m_table.probe(m_board.getHash()))
+    {
+        hashMove = entry->move;
+        int score = fromTable(entry->score, ply);
+        if (!pvNode && ply > 0 && entry->depth >= depth &&
+            (entry->bound == TranspositionTable::EXACT ||
+             (entry->bound == TranspositionTable::LOWER && score >= beta) ||
+             (entry->bound == TranspositionTable::UPPER && score <= alpha)))
+            return score;
+    }
+
+    // if passing the turn still fails high, a real move will too
+    if (!pvNode && !inCheck && ply > 0 && depth >= 3 && m_board.hasPieces() && evaluate(m_board) >= beta)
+    {
+        m_board.makeNullMove();
+        int score = -search(depth - 3 - depth / 4, -beta, -beta + 1, ply + 1);
+        m_board.unmakeNullMove();
+        if (m_stopped)
+            return 0;
+        if (score >= beta && score < mateScore - maxPly)
+            return beta;
+    }
+
+    std::vector<SearchMove> &moves = m_moves[ply];
+    m_board.generateMoves(moves);
+    orderMoves(moves, hashMove, ply);
+
+    const int originalAlpha = alpha;
+    int bestScore = -infinity;
+    SearchMove bestMove = SearchBoard::noMove;
+    int legalMoves = 0;
+    // iterating by index: the recursion reuses the lists of deeper plies, never this one
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        const SearchMove move = moves[i];
+        const bool quiet = !isCapture(m_board, move) && !SearchBoard::movePromotion(move);
+        if (!m_board.makeMove(move))
+            continue;
+        legalMoves++;
+
+        int score;
+        if (legalMoves == 1)
+            score = -search(depth - 1, -beta, -alpha, ply + 1);
+        else
+        {
+            // late quiet moves are searched shallower first and only re-searched when they surprise
+            int reduction = (quiet && !inCheck && depth >= 3 && legalMoves > 3 && !m_board.inCheck()) ? 1 + (legalMoves > 8) : 0;
+            score = -search(depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && reduction)
+                score = -search(depth - 1, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && score < beta)
+                score = -search(depth - 1, -beta, -alpha, ply + 1);
+        }
+        m_board.unmakeMove();
+        if (m_stopped)
+            return 0;
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = move;
+        }
+        if (score > alpha)
+        {
+            alpha = score;
+            m_pv[ply][ply] = move;
+            for (int next = ply + 1; next < m_pvLength[ply + 1]; next++)
+                m_pv[ply][next] = m_pv[ply + 1][next];
+            m_pvLength[ply] = std::max(m_pvLength[ply + 1], ply + 1);
+        }
+        if (alpha >= beta)
+        {
+            if (quiet)
+            {
+                if (m_killers[ply][0] != move)
+                {
+                    m_killers[ply][1] = m_killers[ply][0];
+                    m_killers[ply][0] = move;
+                }
+                int &history = m_history[m_board.getSide() > 0 ? 0 : 1][SearchBoard::moveFrom(move)][SearchBoard::moveTo(move)];
+                history = std::min(history + depth * depth, 1 << 20);
+            }
+            break;
+        }
+    }
+
+    if (legalMoves == 0)
+        return inCheck ? -mateScore + ply : 0;
+
+    TranspositionTable::Bound bound = bestScore >= beta            ? TranspositionTable::LOWER
+                                      : bestScore > originalAlpha ? TranspositionTable::EXACT
+                                                                  : TranspositionTable::UPPER;
+    m_table.store(m_board.getHash(), bestMove, toTable(bestScore, ply), depth, bound);
+    return bestScore;
+}
+
+SearchResult SearchEngine::search(const GameManager &gm, const SearchLimits &limits)
+{
+    return search(SearchBoard(gm), limits);
+}
+
+SearchResult SearchEngine::search(const SearchBoard &board, const SearchLimits &limits)
+{
+    return search(board, limits, {});
+}
+
+SearchResult SearchEngine::search(const SearchBoard &board, const SearchLimits &limits, const std::vector<SearchMove> &excluded)
+{
+    return searchLines(board, limits, 1, excluded).front();
+}
+
+std::vector<SearchResult> SearchEngine::searchMultiPv(const GameManager &gm, const SearchLimits &limits, size_t lines)
+{
+    return searchLines(SearchBoard(gm), limits, lines, {});
+}
+
+std::vector<SearchResult> SearchEngine::searchMultiPv(const SearchBoard &board, const SearchLimits &limits, size_t lines)
+{
+    return searchLines(board, limits, lines, {});
+}
+
+std::vector<SearchResult> SearchEngine::searchLines(const SearchBoard &board, const SearchLimits &limits, size_t lines,
+                                                    const std::vector<SearchMove> &excluded)
+{
+    ALLOC_SCOPE(AllocSubsystem::SEARCH);
+    m_board = board;
+    m_limits = limits;
+    m_start = std::chrono::steady_clock::now();
+    m_nodes = 0;
+    m_completedDepth = 0;
+    m_stopped = false;
+    m_table.newSearch();
+    std::fill(&m_killers[0][0], &m_killers[0][0] + maxPly * 2, SearchBoard::noMove);
+    for (auto &side : m_history)
+        for (auto &from : side)
+            for (int &value : from)
+                value /= 8;
+
+    std::vector<SearchMove> legal;
+    m_board.generateLegalMoves(legal);
+    if (legal.empty())
+    {
+        SearchResult result;
+        result.score = m_board.inCheck() ? -mateScore : 0;
+        return {result};
+    }
+    std::erase_if(legal, [&excluded](SearchMove move)
+                  { return std::find(excluded.begin(), excluded.end(), move) != excluded.end(); });
+    if (legal.empty())
+        return {SearchResult{}};
+
+    const TranspositionTable::Entry *entry = m_table.probe(m_board.getHash());
+    orderMoves(legal, entry ? entry->move : SearchBoard::noMove, 0);
+    std::vector<RootMove> rootMoves;
+    for (SearchMove move : legal)
+        rootMoves.push_back({move, -infinity, false, {}, 0});
+    lines = std::clamp<size_t>(lines, 1, rootMoves.size());
+
+    std::vector<SearchResult> results;
+    const int maxDepth = limits.depth > 0 ? std::min(limits.depth, maxPly / 2) : maxPly / 2;
+    for (int depth = 1; depth <= maxDepth; depth++)
+    {
+        // all lines share one pass over the root moves: a move only needs an exact score while it can still
+        // make the top lines, every other one is refuted against the score of the last of them
+        std::vector<int> top;
+        for (RootMove &root : rootMoves)
+        {
+            const int alpha = top.size() < lines ? -infinity : top.back();
+            const uint64_t nodesBefore = m_nodes;
+            m_board.makeMove(root.move);
+            int score;
+            if (alpha == -infinity)
+                score = -search(depth - 1, -infinity, infinity, 1);
+            else
+            {
+                score = -search(depth - 1, -alpha - 1, -alpha, 1);
+                if (score > alpha && !m_stopped)
+                    score = -search(depth - 1, -infinity, -alpha, 1);
+            }
+            m_board.unmakeMove();
+            root.nodes += m_nodes - nodesBefore;
+            if (m_stopped)
+                break;
+
+            root.score = score;
+            root.exact = score > alpha;
+            if (!root.exact)
+                continue;
+            root.pv.assign(1, root.move);
+            root.pv.insert(root.pv.end(), &m_pv[1][1], &m_pv[1][0] + std::max(m_pvLength[1], 1));
+            top.insert(std::upper_bound(top.begin(), top.end(), score, std::greater<int>()), score);
+            if (top.size() > lines)
+                top.pop_back();
+        }
+        if (m_stopped)
+            break;
+
+        // exact scores first, best first; the next depth searches in this order
+        std::stable_sort(rootMoves.begin(), rootMoves.end(), [](const RootMove &a, const RootMove &b)
+                         { return a.exact != b.exact ? a.exact : a.score > b.score; });
+        m_completedDepth = depth;
+        m_table.store(m_board.getHash(), rootMoves.front().move, rootMoves.front().score, depth, TranspositionTable::EXACT);
+
+        results.assign(lines, SearchResult{});
+        for (size_t line = 0; line < lines; line++)
+        {
+            const RootMove &root = rootMoves[line];
+            results[line].bestMove = SearchBoard::toMove(root.move);
+            results[line].score = root.score;
+            results[line].depth = depth;
+            for (SearchMove move : root.pv)
+                results[line].pv.push_back(SearchBoard::toMove(move));
+        }
+
+        const int best = results.front().score;
+        if (lines == 1 && isMateScore(best) && mateScore - std::abs(best) <= depth)
+            break;
+        // the next depth takes several times as long as this one, it would not finish anyway
+        if (limits.time.count() && std::chrono::steady_clock::now() - m_start >= limits.time / 2)
+            break;
+        if (limits.nodes && m_nodes >= limits.nodes)
+            break;
+    }
+
+    // a line is charged with the nodes spent below its move; everything refuted is shared by all lines
+    uint64_t shared = m_nodes;
+    for (size_t line = 0; line < results.size(); line++)
+    {
+        results[line].nodes = rootMoves[line].nodes;
+        shared -= rootMoves[line].nodes;
+    }
+    results.front().nodes += shared;
+    TRACE_RECORD(TracePhase::SEARCH, m_start, m_nodes);
+    TRACE_COUNT(TraceCounter::SEARCH_NODES, m_nodes);
+    return results;
+}
@@ -0,0 +1,557 @@
+#include "classes.h"
+#include "searchboard.h"
+#include "chess.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    constexpr int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    constexpr int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+    struct Tables
+    {
+        /// @brief target squares per square, ended by -1
+        std::array<std::array<int8_t, 9>, 64> knight;
+        std::array<std::array<int8_t, 9>, 64> king;
+        /// @brief squares along each of the 8 directions of kingSteps, nearest first, ended by -1
+        std::array<std::array<std::array<int8_t, 8>, 8>, 64> rays;
+        /// @brief [color][piece code][square]
+        uint64_t pieceKeys[2][7][64];
+        /// @brief castling rights left after something moves from or onto the square
+        uint8_t castlingMask[64];
+
+        Tables()
+        {
+            for (int square = 0; square < 64; square++)
+            {
+                int file = square % 8;
+                int rank = square / 8;
+                auto fill = [&](const int (*steps)[2], std::array<int8_t, 9> &targets)
+                {
+                    int count = 0;
+                    for (int i = 0; i < 8; i++)
+                    {
+                        int f = file + steps[i][0];
+                        int r = rank + steps[i][1];
+                        if (f >= 0 && f < 8 && r >= 0 && r < 8)
+                            targets[count++] = static_cast<int8_t>(r * 8 + f);
+                    }
+                    targets[count] = -1;
+                };
+                fill(knightSteps, knight[square]);
+                fill(kingSteps, king[square]);
+
+                for (int direction = 0; direction < 8; direction++)
+                {
+                    int count = 0;
+                    int f = file + kingSteps[direction][0];
+                    int r = rank + kingSteps[direction][1];
+                    while (f >= 0 && f < 8 && r >= 0 && r < 8)
+                    {
+                        rays[square][direction][count++] = static_cast<int8_t>(r * 8 + f);
+                        f += kingSteps[direction][0];
+                        r += kingSteps[direction][1];
+                    }
+                    if (count < 8)
+                        rays[square][direction][count] = -1;
+                }
+
+                for (int color = 0; color < 2; color++)
+                {
+                    pieceKeys[color][0][square] = 0;
+                    for (int piece = SearchBoard::PAWN; piece <= SearchBoard::KING; piece++)
+                    {
+                        pieceKeys[color][piece][square] = Zobrist::piece(color == 0 ? PieceColor::WHITE : PieceColor::BLACK,
+                                                                         SearchBoard::toPieceType(piece),
+                                                                         Position(static_cast<char>('a' + file), rank + 1));
+                    }
+                }
+                castlingMask[square] = 0b1111;
+            }
+
+            // same rights and bit order as GameManager and Zobrist::castling
+            castlingMask[4] = static_cast<uint8_t>(~0b0011 & 0b1111);
+            castlingMask[7] = static_cast<uint8_t>(~0b0001 & 0b1111);
+            castlingMask[0] = static_cast<uint8_t>(~0b0010 & 0b1111);
+            castlingMask[60] = static_cast<uint8_t>(~0b1100 & 0b1111);
+            castlingMask[63] = static_cast<uint8_t>(~0b0100 & 0b1111);
+            castlingMask[56] = static_cast<uint8_t>(~0b1000 & 0b1111);
+        }
+    };
+
+    const Tables &tables()
+    {
+        static const Tables instance;
+        return instance;
+    }
+
+    uint64_t pieceKey(int piece, int square)
+    {
+        return tables().pieceKeys[piece > 0 ? 0 : 1][std::abs(piece)][square];
+    }
+
+    uint64_t castlingKeys(int rights)
+    {
+        uint64_t key = 0;
+        for (int right = 0; right < 4; right++)
+        {
+            if (rights & (1 << right))
+                key ^= Zobrist::castling(right);
+        }
+        return key;
+    }
+}
+
+PieceType SearchBoard::toPieceType(int piece)
+{
+    switch (std::abs(piece))
+    {
+    case KNIGHT:
+        return PieceType::KNIGHT;
+    case BISHOP:
+        return PieceType::BISHOP;
+    case ROOK:
+        return PieceType::ROOK;
+    case QUEEN:
+        return PieceType::QUEEN;
+    case KING:
+        return PieceType::KING;
+    default:
+        return PieceType::PAWN;
+    }
+}
+
+Move SearchBoard::toMove(SearchMove move)
+{
+    int from = moveFrom(move);
+    int to = moveTo(move);
+    return {Position(static_cast<char>('a' + from % 8), from / 8 + 1), Position(static_cast<char>('a' + to % 8), to / 8 + 1),
+            movePromotion(move) ? toPieceType(movePromotion(move)) : PieceType::PAWN};
+}
+
+SearchMove SearchBoard::fromMove(const Move &move)
+{
+    int promotion = EMPTY;
+    switch (move.promotion)
+    {
+    case PieceType::KNIGHT:
+        promotion = KNIGHT;
+        break;
+    case PieceType::BISHOP:
+        promotion = BISHOP;
+        break;
+    case PieceType::ROOK:
+        promotion = ROOK;
+        break;
+    case PieceType::QUEEN:
+        promotion = QUEEN;
+        break;
+    default:
+        break;
+    }
+    return packMove(squareIndex(move.from), squareIndex(move.to), promotion);
+}
+
+void SearchBoard::load(const GameManager &gm)
+{
+    m_squares.fill(EMPTY);
+    for (int square = 0; square < 64; square++)
+    {
+        PieceInterface *piece = gm.getBoard().getPieceAt(Position(static_cast<char>('a' + square % 8), square / 8 + 1));
+        if (!piece)
+            continue;
+
+        int code = PAWN;
+        switch (piece->getType())
+        {
+        case PieceType::KNIGHT:
+            code = KNIGHT;
+            break;
+        case PieceType::BISHOP:
+            code = BISHOP;
+            break;
+        case PieceType::ROOK:
+            code = ROOK;
+            break;
+        case PieceType::QUEEN:
+            code = QUEEN;
+            break;
+        case PieceType::KING:
+            code = KING;
+            m_kings[piece->getColor() == PieceColor::WHITE ? 0 : 1] = static_cast<uint8_t>(square);
+            break;
+        default:
+            break;
+        }
+        m_squares[square] = static_cast<int8_t>(piece->getColor() == PieceColor::WHITE ? code : -code);
+    }
+
+    m_side = gm.getCurrentTurnColor() == PieceColor::WHITE ? 1 : -1;
+    m_castlingRights = static_cast<uint8_t>(gm.getCastlingRights());
+    m_enPassantSquare = gm.getEnPassantSquare();
+    m_halfmoveClock = gm.getHalfmoveClock();
+    m_hash = computeHash();
+    m_undo.clear();
+
+    const std::vector<uint64_t> &history = gm.getHashHistory();
+    size_t keep = std::min(history.size(), static_cast<size_t>(m_halfmoveClock) + 1);
+    m_history.assign(history.end() - static_cast<std::ptrdiff_t>(keep), history.end());
+    if (m_history.empty() || m_history.back() != m_hash)
+        m_history.assign(1, m_hash);
+}
+
+uint64_t SearchBoard::enPassantKey() const
+{
+    // like GameManager, the file only counts when a pawn of the side to move stands next to the pushed pawn
+    if (m_enPassantSquare == noSquare)
+        return 0;
+    int pawnSquare = m_enPassantSquare - 8 * m_side;
+    int file = pawnSquare % 8;
+    for (int side : {-1, 1})
+    {
+        if (file + side >= 0 && file + side < 8 && m_squares[pawnSquare + side] == PAWN * m_side)
+            return Zobrist::enPassant(static_cast<char>('a' + file));
+    }
+    return 0;
+}
+
+uint64_t SearchBoard::computeHash() const
+{
+    uint64_t hash = 0;
+    for (int square = 0; square < 64; square++)
+        hash ^= pieceKey(m_squares[square], square);
+    if (m_side < 0)
+        hash ^= Zobrist::blackToMove();
+    return hash ^ castlingKeys(m_castlingRights) ^ enPassantKey();
+}
+
+bool SearchBoard::isAttacked(int square, int side) const
+{
+    const Tables &t = tables();
+
+    // a pawn of side attacks square from one rank behind it, as seen from side
+    int pawnRank = square / 8 - side;
+    if (pawnRank >= 0 && pawnRank < 8)
+    {
+        int file = square % 8;
+        for (int df : {-1, 1})
+        {
+            if (file + df >= 0 && file + df < 8 && m_squares[pawnRank * 8 + file + df] == PAWN * side)
+                return true;
+        }
+    }
+
+    for (int8_t target : t.knight[square])
+    {
+        if (target < 0)
+            break;
+        if (m_squares[target] == KNIGHT * side)
+            return true;
+    }
+    for (int8_t target : t.king[square])
+    {
+        if (target < 0)
+            break;
+        if (m_squares[target] == KING * side)
+            return true;
+    }
+
+    for (int direction = 0; direction < 8; direction++)
+    {
+        const int slider = (direction % 2 == 0) ? ROOK : BISHOP;
+        for (int8_t target : t.rays[square][direction])
+        {
+            if (target < 0)
+                break;
+            int piece = m_squares[target];
+            if (piece == EMPTY)
+                continue;
+            if (piece == slider * side || piece == QUEEN * side)
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
+void SearchBoard::generate(std::vector<SearchMove> &moves, bool capturesOnly) const
+{
+    const Tables &t = tables();
+    moves.clear();
+
+    for (int from = 0; from < 64; from++)
+    {
+        const int piece = m_squares[from] * m_side;
+        if (piece <= 0)
+            continue;
+
+        if (piece == PAWN)
+        {
+            const int rank = from / 8;
+            const int file = from % 8;
+            const int lastRank = m_side > 0 ? 7 : 0;
+            const int startRank = m_side > 0 ? 1 : 6;
+            const int forward = from + 8 * m_side;
+            auto addPawnMove = [&](int to, bool capture)
+            {
+                if (to / 8 == lastRank)
+                {
+                    moves.push_back(packMove(from, to, QUEEN));
+                    if (capturesOnly)
+                        return;
+                    for (int promotion : {KNIGHT, ROOK, BISHOP})
+                        moves.push_back(packMove(from, to, promotion));
+                }
+                else if (capture || !capturesOnly)
+                    moves.push_back(packMove(from, to));
+            };
+
+            if (m_squares[forward] == EMPTY)
+            {
+                addPawnMove(forward, false);
+                if (!capturesOnly && rank == startRank && m_squares[forward + 8 * m_side] == EMPTY)
+                    moves.push_back(packMove(from, forward + 8 * m_side));
+            }
+            for (int df : {-1, 1})
+            {
+                if (file + df < 0 || file + df > 7)
+                    continue;
+                int to = forward + df;
+                if (m_squares[to] * m_side < 0 || to == m_enPassantSquare)
+                    addPawnMove(to, true);
+            }
+            continue;
+        }
+
+        if (piece == KNIGHT || piece == KING)
+        {
+            for (int8_t to : (piece == KNIGHT ? t.knight[from] : t.king[from]))
+            {
+                if (to < 0)
+                    break;
+                int target = m_squares[to] * m_side;
+                if (target > 0 || (capturesOnly && target == EMPTY))
+                    continue;
+                moves.push_back(packMove(from, to));
+            }
+
+            if (piece == KING && !capturesOnly)
+            {
+                // rights are only kept while king and rook are home, so only the path needs checking here
+                const int home = m_side > 0 ? 4 : 60;
+                const int shift = m_side > 0 ? 0 : 2;
+                if (from == home && (m_castlingRights & (1 << shift)) && m_squares[home + 1] == EMPTY &&
+                    m_squares[home + 2] == EMPTY && !isAttacked(home, -m_side) && !isAttacked(home + 1, -m_side))
+                    moves.push_back(packMove(home, home + 2));
+                if (from == home && (m_castlingRights & (2 << shift)) && m_squares[home - 1] == EMPTY &&
+                    m_squares[home - 2] == EMPTY && m_squares[home - 3] == EMPTY && !isAttacked(home, -m_side) &&
+                    !isAttacked(home - 1, -m_side))
+                    moves.push_back(packMove(home, home - 2));
+            }
+            continue;
+        }
+
+        // sliders: rooks use the straight directions, bishops the diagonal ones, queens both
+        for (int direction = 0; direction < 8; direction++)
+        {
+            bool straight = direction % 2 == 0;
+            if ((piece == ROOK && !straight) || (piece == BISHOP && straight))
+                continue;
+            for (int8_t to : t.rays[from][direction])
+            {
+                if (to < 0)
+                    break;
+                int target = m_squares[to] * m_side;
+                if (target > 0)
+                    break;
+                if (target < 0 || !capturesOnly)
+                    moves.push_back(packMove(from, to));
+                if (target < 0)
+                    break;
+            }
+        }
+    }
+}
+
+void SearchBoard::generateLegalMoves(std::vector<SearchMove> &moves)
+{
+    // filtered in place, in generation order, so a reused vector costs no allocation
+    generateMoves(moves);
+    size_t legal = 0;
+    for (SearchMove move : moves)
+    {
+        if (makeMove(move))
+        {
+            unmakeMove();
+            moves[legal++] = move;
+        }
+    }
+    moves.resize(legal);
+}
+
+bool SearchBoard::makeMove(SearchMove move)
+{
+    const int from = moveFrom(move);
+    const int to = moveTo(move);
+    const int promotion = movePromotion(move);
+    const int piece = m_squares[from];
+    const int type = std::abs(piece);
+
+    Undo undo{move, m_squares[to], static_cast<uint8_t>(to), m_castlingRights, m_enPassantSquare, m_halfmoveClock, m_hash};
+    uint64_t hash = m_hash ^ enPassantKey() ^ castlingKeys(m_castlingRights) ^ pieceKey(piece, from);
+
+    if (type == PAWN && to == m_enPassantSquare && undo.captured == EMPTY)
+    {
+        undo.capturedSquare = static_cast<uint8_t>(to - 8 * m_side);
+        undo.captured = m_squares[undo.capturedSquare];
+        m_squares[undo.capturedSquare] = EMPTY;
+    }
+    hash ^= pieceKey(undo.captured, undo.capturedSquare);
+
+    if (type == KING && std::abs(to - from) == 2)
+    {
+        int rookFrom = to > from ? from + 3 : from - 4;
+        int rookTo = to > from ? from + 1 : from - 1;
+        m_squares[rookTo] = m_squares[rookFrom];
+        m_squares[rookFrom] = EMPTY;
+        hash ^= pieceKey(m_squares[rookTo], rookFrom) ^ pieceKey(m_squares[rookTo], rookTo);
+    }
+
+    m_squares[to] = static_cast<int8_t>(promotion ? promotion * m_side : piece);
+    m_squares[from] = EMPTY;
+    hash ^= pieceKey(m_squares[to], to);
+    if (type == KING)
+        m_kings[m_side > 0 ? 0 : 1] = static_cast<uint8_t>(to);
+
+    m_castlingRights &= tables().castlingMask[from] & tables().castlingMask[to];
+    m_enPassantSquare = (type == PAWN && std::abs(to - from) == 16) ? static_cast<uint8_t>((from + to) / 2) : noSquare;
+    m_halfmoveClock = (type == PAWN || undo.captured != EMPTY) ? 0 : m_halfmoveClock + 1;
+    m_side = -m_side;
+    m_hash = hash ^ Zobrist::blackToMove() ^ castlingKeys(m_castlingRights) ^ enPassantKey();
+
+    m_undo.push_back(undo);
+    m_history.push_back(m_hash);
+
+    if (isAttacked(m_kings[m_side > 0 ? 1 : 0], m_side))
+    {
+        unmakeMove();
+        return false;
+    }
+    return true;
+}
+
+void SearchBoard::makeNullMove()
+{
+    Undo undo{noMove, EMPTY, 0, m_castlingRights, m_enPassantSquare, m_halfmoveClock, m_hash};
+    uint64_t hash = m_hash ^ enPassantKey();
+    m_enPassantSquare = noSquare;
+    // no repetition can reach back across a passed turn
+    m_halfmoveClock = 0;
+    m_side = -m_side;
+    m_hash = hash ^ Zobrist::blackToMove();
+    m_undo.push_back(undo);
+    m_history.push_back(m_hash);
+}
+
+void SearchBoard::unmakeMove()
+{
+    const Undo undo = m_undo.back();
+    m_undo.pop_back();
+    m_history.pop_back();
+    m_side = -m_side;
+
+    if (undo.move == noMove)
+    {
+        m_enPassantSquare = undo.enPassantSquare;
+        m_halfmoveClock = undo.halfmoveClock;
+        m_hash = undo.hash;
+        return;
+    }
+
+    const int from = moveFrom(undo.move);
+    const int to = moveTo(undo.move);
+    int piece = m_squares[to];
+    if (movePromotion(undo.move))
+        piece = PAWN * m_side;
+
+    m_squares[from] = static_cast<int8_t>(piece);
+    m_squares[to] = EMPTY;
+    m_squares[undo.capturedSquare] = undo.captured;
+
+    if (std::abs(piece) == KING)
+    {
+        m_kings[m_side > 0 ? 0 : 1] = static_cast<uint8_t>(from);
+        if (std::abs(to - from) == 2)
+        {
+            int rookFrom = to > from ? from + 3 : from - 4;
+            int rookTo = to > from ? from + 1 : from - 1;
+            m_squares[rookFrom] = m_squares[rookTo];
+            m_squares[rookTo] = EMPTY;
+        }
+    }
+
+    m_castlingRights = undo.castlingRights;
+    m_enPassantSquare = undo.enPassantSquare;
+    m_halfmoveClock = undo.halfmoveClock;
+    m_hash = undo.hash;
+}
+
+bool SearchBoard::isRepetition() const
+{
+    // only positions with the same side to move and no irreversible move in between can repeat
+    const size_t window = std::min(static_cast<size_t>(m_halfmoveClock), m_history.size() - 1);
+    for (size_t back = 4; back <= window; back += 2)
+    {
+        if (m_history[m_history.size() - 1 - back] == m_hash)
+            return true;
+    }
+    return false;
+}
+
+bool SearchBoard::hasPieces() const
+{
+    for (int8_t piece : m_squares)
+    {
+        int own = piece * m_side;
+        if (own > PAWN && own < KING)
+            return true;
+    }
+    return false;
+}
+
+bool SearchBoard::isRuleDraw() const
+{
+    if (m_halfmoveClock >= 100)
+        return true;
+
+    int minors = 0;
+    for (int8_t piece : m_squares)
+    {
+        int type = std::abs(piece);
+        if (type == PAWN || type == ROOK || type == QUEEN)
+            return false;
+        if (type == KNIGHT || type == BISHOP)
+            minors++;
+    }
+    return minors <= 1;
+}
+
+uint64_t SearchBoard::perft(int depth)
+{
+    if (depth == 0)
+        return 1;
+
+    std::vector<SearchMove> moves;
+    generateMoves(moves);
+    uint64_t nodes = 0;
+    for (SearchMove move : moves)
+    {
+        if (!makeMove(move))
+            continue;
+        nodes += perft(depth - 1);
+        unmakeMove();
+    }
+    return nodes;
+}
@@ -0,0 +1,341 @@
+#include "spectate.h"
+#include "chess.h"
+#include "fen.h"
+#include "alloc.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief frames handed to one sendmsg
+    constexpr size_t maxIovecs = 64;
+
+    const char *statusName(GameStatus status)
+    {
+        switch (status)
+        {
+        case GameStatus::CHECKMATE:
+            return "checkmate";
+        case GameStatus::STALEMATE:
+            return "stalemate";
+        case GameStatus::INSUFFICIENT_MATERIAL:
+            return "insufficient material";
+        case GameStatus::FIFTY_MOVE_RULE:
+            return "fifty-move rule";
+        case GameStatus::THREEFOLD_REPETITION:
+            return "threefold repetition";
+        default:
+            return "ongoing";
+        }
+    }
+
+    void setNonBlocking(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            throw std::runtime_error(std::string("failed to make a socket non-blocking: ") + std::strerror(errno));
+    }
+}
+
+SpectatorServer::SpectatorServer(SpectatorOptions options) : m_options(std::move(options))
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_options.path.size() >= sizeof(address.sun_path))
+        throw std::invalid_argument("spectator socket path is too long: " + m_options.path);
+    std::memcpy(address.sun_path, m_options.path.c_str(), m_options.path.size() + 1);
+
+    if (pipe2(m_wakeFds, O_NONBLOCK) < 0)
+        throw std::runtime_error(std::string("failed to create the spectator wake pipe: ") + std::strerror(errno));
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // a socket file left behind by a server that did not shut down would make bind fail
+    unlink(m_options.path.c_str());
+    if (m_listenFd < 0 || bind(m_listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(m_listenFd, 128) < 0)
+    {
+        std::string error = std::strerror(errno);
+        for (int fd : {m_listenFd, m_wakeFds[0], m_wakeFds[1]})
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+        throw std::runtime_error("failed to listen on " + m_options.path + ": " + error);
+    }
+    setNonBlocking(m_listenFd);
+    m_loop = std::thread(&SpectatorServer::run, this);
+}
+
+SpectatorServer::~SpectatorServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    wake();
+    m_loop.join();
+    for (auto &[fd, spectator] : m_spectators)
+        ::close(fd);
+    ::close(m_listenFd);
+    ::close(m_wakeFds[0]);
+    ::close(m_wakeFds[1]);
+    unlink(m_options.path.c_str());
+}
+
+std::string SpectatorServer::serialize(uint32_t game, GameManager &gm, std::string_view san)
+{
+    const Move &move = gm.getMoveHistory().back();
+    std::string coordinates{move.from.col, static_cast<char>('0' + move.from.row), move.to.col, static_cast<char>('0' + move.to.row)};
+    if (move.promotion != PieceType::PAWN)
+        coordinates += static_cast<char>(std::tolower(gm.promotionTypeToString(move.promotion)[0]));
+
+    std::string frame = "{\"game\":" + std::to_string(game) + ",\"ply\":" + std::to_string(gm.getMoveHistory().size()) +
+                        ",\"move\":\"" + coordinates + "\",\"san\":\"";
+    frame += san;
+    frame += "\",\"fen\":\"" + FenNotation::toFen(gm) + "\",\"status\":\"" + statusName(gm.evaluateStatus()) + "\"}\n";
+    return frame;
+}
+
+void SpectatorServer::publishMove(uint32_t game, GameManager &gm, std::string_view san)
+{
+    publish(game, std::make_shared<const std::string>(serialize(game, gm, san)));
+}
+
+void SpectatorServer::publish(uint32_t game, SpectatorFrame frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.published++;
+        m_stats.serializedBytes += frame->size();
+        auto watchers = m_watchers.find(game);
+        if (watchers != m_watchers.end())
+        {
+            for (Spectator *spectator : watchers->second)
+                enqueue(*spectator, frame);
+        }
+        m_latest[game] = std::move(frame);
+    }
+    wake();
+}
+
+void SpectatorServer::endGame(uint32_t game)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latest.erase(game);
+}
+
+SpectatorStats SpectatorServer::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SpectatorStats stats = m_stats;
+    stats.spectators = m_spectators.size();
+    return stats;
+}
+
+void SpectatorServer::enqueue(Spectator &spectator, const SpectatorFrame &frame)
+{
+    if (spectator.closing)
+        return;
+    if (spectator.queue.size() - spectator.head >= m_options.maxQueuedFrames)
+    {
+        if (m_options.policy == SlowSpectatorPolicy::DROP)
+        {
+            spectator.closing = true;
+            m_stats.dropped++;
+            return;
+        }
+        // a frame already partly on the socket has to be finished, or the stream would be cut mid-line
+        const size_t keep = spectator.head + (spectator.offset > 0 ? 1 : 0);
+        m_stats.coalesced += spectator.queue.size() - keep;
+        spectator.queue.resize(keep);
+    }
+    spectator.queue.push_back(frame);
+    m_stats.queued++;
+}
+
+void SpectatorServer::wake()
+{
+    char byte = 0;
+    // a full pipe already has the loop awake
+    [[maybe_unused]] ssize_t written = ::write(m_wakeFds[1], &byte, 1);
+}
+
+void SpectatorServer::run()
+{
+    ALLOC_SCOPE(AllocSubsystem::IO);
+    std::vector<pollfd> fds;
+    std::vector<Spectator *> polled;
+    while (true)
+    {
+        fds.clear();
+        polled.clear();
+        fds.push_back({m_wakeFds[0], POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop)
+                return;
+            for (auto it = m_spectators.begin(); it != m_spectators.end();)
+            {
+                Spectator &spectator = *(it++)->second;
+                if (spectator.closing)
+                {
+                    close(spectator);
+                    continue;
+                }
+                const short events = POLLIN | (spectator.head < spectator.queue.size() ? POLLOUT : 0);
+                fds.push_back({spectator.fd, events, 0});
+                polled.push_back(&spectator);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // nothing but a broken descriptor set gets here; spectators simply stop getting moves
+            return;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            char buffer[256];
+            while (::read(m_wakeFds[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            accept();
+        }
+        // only this thread removes spectators, so the pointers polled above are still valid; the lock is taken
+        // per spectator so a publisher waits for at most one send
+        for (size_t i = 0; i < polled.size(); i++)
+        {
+            const short revents = fds[i + 2].revents;
+            if (!revents)
+                continue;
+            Spectator &spectator = *polled[i];
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ((revents & (POLLERR | POLLNVAL)) || ((revents & (POLLIN | POLLHUP)) && !read(spectator)) ||
+                ((revents & POLLOUT) && !write(spectator)))
+                spectator.closing = true;
+        }
+    }
+}
+
+void SpectatorServer::accept()
+{
+    while (true)
+    {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0)
+            return;
+        auto spectator = std::make_unique<Spectator>();
+        spectator->fd = fd;
+        m_spectators.emplace(fd, std::move(spectator));
+    }
+}
+
+bool SpectatorServer::read(Spectator &spectator)
+{
+    char buffer[512];
+    ssize_t received;
+    while ((received = ::read(spectator.fd, buffer, sizeof(buffer))) > 0)
+        spectator.input.append(buffer, static_cast<size_t>(received));
+    if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        return false;
+
+    size_t end;
+    while ((end = spectator.input.find('\n')) != std::string::npos)
+    {
+        std::string line = spectator.input.substr(0, end);
+        spectator.input.erase(0, end + 1);
+        if (!line.starts_with("watch "))
+            return false;
+        uint32_t game;
+        try
+        {
+            game = static_cast<uint32_t>(std::stoul(line.substr(6)));
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+        if (std::find(spectator.games.begin(), spectator.games.end(), game) != spectator.games.end())
+            continue;
+        spectator.games.push_back(game);
+        m_watchers[game].push_back(&spectator);
+        auto latest = m_latest.find(game);
+        if (latest != m_latest.end())
+            enqueue(spectator, latest->second);
+    }
+    // a request line is a few bytes, anything longer is not a spectator
+    return spectator.input.size() < 64;
+}
+
+bool SpectatorServer::write(Spectator &spectator)
+{
+    while (spectator.head < spectator.queue.size())
+    {
+        iovec iov[maxIovecs];
+        size_t count = 0;
+        for (size_t i = spectator.head; i < spectator.queue.size() && count < maxIovecs; i++, count++)
+        {
+            const std::string &frame = *spectator.queue[i];
+            const size_t skip = i == spectator.head ? spectator.offset : 0;
+            iov[count] = {const_cast<char *>(frame.data()) + skip, frame.size() - skip};
+        }
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        // a spectator that went away must not take the process down with SIGPIPE
+        ssize_t sent = sendmsg(spectator.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+
+        size_t remaining = static_cast<size_t>(sent);
+        while (remaining > 0)
+        {
+            const size_t left = spectator.queue[spectator.head]->size() - spectator.offset;
+            if (remaining < left)
+            {
+                spectator.offset += remaining;
+                break;
+            }
+            remaining -= left;
+            spectator.offset = 0;
+            spectator.head++;
+            m_stats.sent++;
+        }
+        if (spectator.offset > 0)
+            break;
+    }
+    spectator.queue.erase(spectator.queue.begin(), spectator.queue.begin() + static_cast<ptrdiff_t>(spectator.head));
+    spectator.head = 0;
+    return true;
+}
+
+void SpectatorServer::close(Spectator &spectator)
+{
+    for (uint32_t game : spectator.games)
+    {
+        std::vector<Spectator *> &watchers = m_watchers[game];
+        std::erase(watchers, &spectator);
+        if (watchers.empty())
+            m_watchers.erase(game);
+    }
+    ::close(spectator.fd);
+    m_spectators.erase(spectator.fd);
+}
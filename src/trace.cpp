@@ -0,0 +1,255 @@
+#include "trace.h"
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    struct TraceEvent
+    {
+        TracePhase phase;
+        /// @brief since the trace epoch
+        uint64_t startNs;
+        uint64_t durationNs;
+        uint64_t value;
+    };
+
+    struct ThreadBuffer
+    {
+        size_t thread = 0;
+        TraceMetrics metrics;
+        std::vector<TraceEvent> events;
+    };
+
+    /// @brief every buffer ever handed out; never shrinks, so the thread_local pointers stay valid
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    /// @brief trace timestamps count from program start, so spans begun before a thread's first record still fit
+    const Tracer::Clock::time_point traceEpoch = Tracer::Clock::now();
+
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadBuffer &localBuffer()
+    {
+        thread_local ThreadBuffer *buffer = []
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.buffers.push_back(std::make_unique<ThreadBuffer>());
+            r.buffers.back()->thread = r.buffers.size();
+            r.buffers.back()->events.reserve(1024);
+            return r.buffers.back().get();
+        }();
+        return *buffer;
+    }
+
+    /// @brief trace-event times are in microseconds, the fraction keeps the nanoseconds
+    void writeMicroseconds(std::ostream &out, uint64_t ns)
+    {
+        out << ns / 1000 << '.' << std::to_string(1000 + ns % 1000).substr(1);
+    }
+
+    uint64_t nanoseconds(Tracer::Clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+}
+
+void PhaseMetrics::add(uint64_t ns)
+{
+    calls++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+    histogram[std::min<size_t>(std::bit_width(ns), buckets - 1)]++;
+}
+
+void PhaseMetrics::add(const PhaseMetrics &other)
+{
+    calls += other.calls;
+    totalNs += other.totalNs;
+    maxNs = std::max(maxNs, other.maxNs);
+    for (size_t i = 0; i < buckets; i++)
+        histogram[i] += other.histogram[i];
+}
+
+uint64_t PhaseMetrics::percentile(double q) const
+{
+    const double target = q * static_cast<double>(calls);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; i++)
+    {
+        seen += histogram[i];
+        if (seen > 0 && static_cast<double>(seen) >= target)
+            return std::min(uint64_t{1} << i, maxNs);
+    }
+    return maxNs;
+}
+
+void Tracer::record(TracePhase phase, Clock::time_point start, Clock::time_point end, uint64_t value)
+{
+    ThreadBuffer &buffer = localBuffer();
+    const uint64_t duration = nanoseconds(end - start);
+    buffer.metrics.phases[static_cast<size_t>(phase)].add(duration);
+    if (buffer.events.size() < maxEvents)
+        buffer.events.push_back({phase, nanoseconds(start - traceEpoch), duration, value});
+    else
+        buffer.metrics.droppedEvents++;
+}
+
+void Tracer::count(TraceCounter counter, uint64_t amount)
+{
+    localBuffer().metrics.counters[static_cast<size_t>(counter)] += amount;
+}
+
+TraceMetrics Tracer::collect()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    TraceMetrics total;
+    for (const auto &buffer : r.buffers)
+    {
+        for (size_t i = 0; i < total.phases.size(); i++)
+            total.phases[i].add(buffer->metrics.phases[i]);
+        for (size_t i = 0; i < total.counters.size(); i++)
+            total.counters[i] += buffer->metrics.counters[i];
+        total.droppedEvents += buffer->metrics.droppedEvents;
+    }
+    return total;
+}
+
+void Tracer::reset()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &buffer : r.buffers)
+    {
+        buffer->metrics = TraceMetrics{};
+        buffer->events.clear();
+    }
+}
+
+const char *Tracer::phaseName(TracePhase phase)
+{
+    switch (phase)
+    {
+    case TracePhase::MOVE:
+        return "playMove";
+    case TracePhase::VALIDATE:
+        return "validate";
+    case TracePhase::KING_SAFETY:
+        return "kingSafety";
+    case TracePhase::NOTATION:
+        return "notation";
+    case TracePhase::PGN_WRITE:
+        return "writeTurn";
+    case TracePhase::STATUS:
+        return "evaluateStatus";
+    case TracePhase::CHECKMATE:
+        return "isCheckmate";
+    case TracePhase::STALEMATE:
+        return "isStalemate";
+    case TracePhase::SEARCH:
+        return "search";
+    default:
+        return "unknown";
+    }
+}
+
+void Tracer::writeMetrics(std::ostream &out)
+{
+    const TraceMetrics metrics = collect();
+    out << "phase            calls    total ms     mean ns      p50 ns      p90 ns      p99 ns      max ns\n";
+    for (size_t i = 0; i < metrics.phases.size(); i++)
+    {
+        const PhaseMetrics &phase = metrics.phases[i];
+        if (phase.calls == 0)
+            continue;
+        std::string name = phaseName(static_cast<TracePhase>(i));
+        name.resize(std::max<size_t>(name.size(), 14), ' ');
+        out << name << ' ' << std::string(8 - std::min<size_t>(8, std::to_string(phase.calls).size()), ' ') << phase.calls;
+        for (uint64_t value : {phase.totalNs / 1000000, phase.totalNs / phase.calls, phase.percentile(0.5), phase.percentile(0.9),
+                               phase.percentile(0.99), phase.maxNs})
+        {
+            std::string text = std::to_string(value);
+            out << std::string(12 - std::min<size_t>(12, text.size()), ' ') << text;
+        }
+        out << '\n';
+    }
+
+    out << "\nlatency histograms, calls per bucket of at most the given ns\n";
+    for (size_t i = 0; i < metrics.phases.size(); i++)
+    {
+        const PhaseMetrics &phase = metrics.phases[i];
+        if (phase.calls == 0)
+            continue;
+        out << phaseName(static_cast<TracePhase>(i)) << ':';
+        for (size_t bucket = 0; bucket < PhaseMetrics::buckets; bucket++)
+        {
+            if (phase.histogram[bucket])
+                out << ' ' << (uint64_t{1} << bucket) << '=' << phase.histogram[bucket];
+        }
+        out << '\n';
+    }
+
+    const PhaseMetrics &search = metrics[TracePhase::SEARCH];
+    const uint64_t nodes = metrics[TraceCounter::SEARCH_NODES];
+    if (search.calls)
+        out << "\nsearch: " << nodes << " nodes, " << static_cast<uint64_t>(nodes * 1e9 / static_cast<double>(std::max<uint64_t>(1, search.totalNs)))
+            << " nodes/s\n";
+    if (metrics.droppedEvents)
+        out << metrics.droppedEvents << " spans not in the trace, the per-thread buffer holds " << maxEvents << '\n';
+}
+
+void Tracer::writeChromeTrace(std::ostream &out)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &buffer : r.buffers)
+    {
+        for (const TraceEvent &event : buffer->events)
+        {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"" << phaseName(event.phase) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << buffer->thread << ",\"ts\":";
+            writeMicroseconds(out, event.startNs);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.durationNs);
+            if (event.phase == TracePhase::SEARCH)
+            {
+                const uint64_t nps = event.durationNs ? static_cast<uint64_t>(event.value * 1e9 / static_cast<double>(event.durationNs)) : 0;
+                out << ",\"args\":{\"nodes\":" << event.value << ",\"nps\":" << nps << "}}";
+                // a counter track of the search speed next to the spans
+                out << ",\n{\"name\":\"nodes/s\",\"ph\":\"C\",\"pid\":1,\"tid\":" << buffer->thread << ",\"ts\":";
+                writeMicroseconds(out, event.startNs);
+                out << ",\"args\":{\"nps\":" << nps << "}}";
+            }
+            else
+                out << '}';
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void Tracer::writeFiles(const std::string &prefix)
+{
+    std::ofstream metrics(prefix + ".metrics.txt", std::ios::trunc);
+    std::ofstream trace(prefix + ".trace.json", std::ios::trunc);
+    if (!metrics || !trace)
+        throw std::runtime_error("failed to open " + prefix + ".metrics.txt or " + prefix + ".trace.json for writing");
+    writeMetrics(metrics);
+    writeChromeTrace(trace);
+}
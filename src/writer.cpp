@@ -0,0 +1,163 @@
+#include "writer.h"
+#include "journal.h"
+#include "alloc.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    void raiseMax(std::atomic<int64_t> &max, int64_t value)
+    {
+        int64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            ;
+    }
+}
+
+GameWriter::GameWriter(GameJournal &journal, size_t capacity) : m_journal(journal), m_ring(capacity)
+{
+    m_thread = std::thread(&GameWriter::run, this);
+}
+
+GameWriter::~GameWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (const std::exception &)
+    {
+        // the error already failed every flush the game made, there is nobody left to tell
+    }
+    Record stop;
+    m_ring.push(std::move(stop));
+    m_thread.join();
+}
+
+uint64_t GameWriter::write(const std::string &file, std::string content, uint64_t offset)
+{
+    if (m_failed.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        throw std::runtime_error(m_error);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (m_ring.push({file, offset, std::move(content), start}))
+        m_stalls.fetch_add(1, std::memory_order_relaxed);
+    uint64_t sequence = m_pushed.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    size_t depth = m_ring.size();
+    if (depth > m_maxDepth.load(std::memory_order_relaxed))
+        m_maxDepth.store(depth, std::memory_order_relaxed);
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    m_totalPushNs.fetch_add(elapsed, std::memory_order_relaxed);
+    raiseMax(m_maxPushNs, elapsed);
+    return sequence;
+}
+
+void GameWriter::waitFor(uint64_t barrier)
+{
+    // a failure leaves m_durable as it is, so waiting on m_durable alone would never see it
+    uint32_t progress = m_progress.load(std::memory_order_acquire);
+    uint64_t durable = m_durable.load(std::memory_order_acquire);
+    while (durable < barrier && !m_failed.load(std::memory_order_acquire))
+    {
+        m_progress.wait(progress, std::memory_order_acquire);
+        progress = m_progress.load(std::memory_order_acquire);
+        durable = m_durable.load(std::memory_order_acquire);
+    }
+    if (durable < barrier)
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        throw std::runtime_error(m_error);
+    }
+}
+
+WriterStats GameWriter::getStats() const
+{
+    WriterStats stats;
+    stats.records = m_pushed.load(std::memory_order_relaxed);
+    stats.written = m_durable.load(std::memory_order_acquire);
+    stats.queueDepth = m_ring.size();
+    stats.maxQueueDepth = m_maxDepth.load(std::memory_order_relaxed);
+    stats.producerStalls = m_stalls.load(std::memory_order_relaxed);
+    stats.maxPushLatency = std::chrono::nanoseconds(m_maxPushNs.load(std::memory_order_relaxed));
+    stats.totalPushLatency = std::chrono::nanoseconds(m_totalPushNs.load(std::memory_order_relaxed));
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    stats.maxDurableLatency = m_maxDurableLatency;
+    stats.totalDurableLatency = m_totalDurableLatency;
+    return stats;
+}
+
+void GameWriter::run()
+{
+    ALLOC_SCOPE(AllocSubsystem::IO);
+    std::vector<std::chrono::steady_clock::time_point> queued;
+    bool stopping = false;
+    while (!stopping)
+    {
+        Record record;
+        if (!m_ring.tryPop(record))
+        {
+            m_ring.waitForItems();
+            continue;
+        }
+
+        // nothing is written after a failed commit: a later one would take m_durable past the failed records
+        if (m_failed.load(std::memory_order_acquire))
+        {
+            stopping = record.file.empty();
+            continue;
+        }
+
+        // everything already in the ring goes to the journal together, so it shares one commit
+        uint64_t ticket = 0;
+        queued.clear();
+        try
+        {
+            do
+            {
+                if (record.file.empty())
+                {
+                    stopping = true;
+                    break;
+                }
+                ticket = m_journal.submit(record.file, std::move(record.content), record.offset);
+                queued.push_back(record.queued);
+            } while (m_ring.tryPop(record));
+
+            if (!queued.empty())
+                m_journal.waitDurable(ticket);
+        }
+        catch (const std::exception &e)
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_error = e.what();
+            m_failed.store(true, std::memory_order_release);
+            publishProgress();
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            for (const auto &time : queued)
+            {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - time);
+                m_totalDurableLatency += latency;
+                m_maxDurableLatency = std::max(m_maxDurableLatency, latency);
+            }
+        }
+        m_durable.fetch_add(queued.size(), std::memory_order_release);
+        publishProgress();
+    }
+}
+
+void GameWriter::publishProgress()
+{
+    m_progress.fetch_add(1, std::memory_order_release);
+    m_progress.notify_all();
+}
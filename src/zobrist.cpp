@@ -0,0 +1,61 @@
+#include "zobrist.h"
+#include <array>
+
+namespace
+{
+    struct ZobristTable
+    {
+        std::array<uint64_t, 2 * 6 * 64> pieces;
+        std::array<uint64_t, 4> castling;
+        std::array<uint64_t, 8> enPassant;
+        uint64_t blackToMove;
+
+        ZobristTable()
+        {
+            // splitmix64, any fixed seed works as long as it never changes
+            uint64_t state = 0x9E3779B97F4A7C15ull;
+            auto next = [&state]()
+            {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            };
+            for (auto &key : pieces)
+                key = next();
+            for (auto &key : castling)
+                key = next();
+            for (auto &key : enPassant)
+                key = next();
+            blackToMove = next();
+        }
+    };
+
+    const ZobristTable &table()
+    {
+        static const ZobristTable keys;
+        return keys;
+    }
+}
+
+uint64_t Zobrist::piece(PieceColor color, PieceType type, const Position &position)
+{
+    int square = (position.row - 1) * 8 + (position.col - 'a');
+    int index = (static_cast<int>(color) * 6 + static_cast<int>(type)) * 64 + square;
+    return table().pieces[index];
+}
+
+uint64_t Zobrist::blackToMove()
+{
+    return table().blackToMove;
+}
+
+uint64_t Zobrist::castling(int right)
+{
+    return table().castling[right];
+}
+
+uint64_t Zobrist::enPassant(char col)
+{
+    return table().enPassant[col - 'a'];
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <iostream>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include "alloc.h"
+#include "analysis.h"
+#include "trace.h"
+
+namespace
+{
+    void report(unsigned threads, const AnalysisStats &stats, double baseline)
+    {
+        double positionsPerSecond = stats.positions / stats.seconds;
+        std::println("{0:>3} threads: {1} positions in {2:.3f} s, {3:.0f} positions/s, {4:.0f} nodes/s, speedup {5:.2f}",
+                     threads, stats.positions, stats.seconds, positionsPerSecond, stats.nodes / stats.seconds,
+                     baseline > 0 ? positionsPerSecond / baseline : 1.0);
+    }
+}
+
+/// @brief game-analyze: searches every position of a batch of games and writes the annotated games and a binary summary
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::println("usage: {0} <games dir | archive.cga | file.pgn> <output prefix> [--threads N] [--depth N] [--nodes N] [--multipv N] [--hash MB] [--scaling] [--trace prefix]", argv[0]);
+        return 1;
+    }
+
+    AnalysisOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    bool scaling = false;
+    std::string tracePrefix;
+
+    try
+    {
+        for (int i = 3; i < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            if (flag == "--scaling")
+            {
+                scaling = true;
+                i--;
+                continue;
+            }
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value for " + flag);
+            std::string value = argv[i + 1];
+            if (flag == "--threads")
+                options.threads = std::stoul(value);
+            else if (flag == "--depth")
+                options.limits.depth = std::stoi(value);
+            else if (flag == "--nodes")
+                options.limits.nodes = std::stoull(value);
+            else if (flag == "--multipv")
+                options.multiPv = std::stoul(value);
+            else if (flag == "--hash")
+                options.tableMegabytes = std::stoul(value);
+            else if (flag == "--trace" && Tracer::enabled)
+                tracePrefix = value;
+            else if (flag == "--trace")
+                throw std::invalid_argument("--trace needs a build configured with -DCHESS_TRACE=ON");
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+        // a node budget alone replaces the default depth
+        bool depthGiven = std::find(argv + 3, argv + argc, std::string("--depth")) != argv + argc;
+        if (options.limits.nodes && !depthGiven)
+            options.limits.depth = 0;
+
+        std::vector<AnalysisJob> jobs = GameAnalyzer::loadJobs(argv[1]);
+        std::println("{0} games, depth {1}, node budget {2}", jobs.size(), options.limits.depth, options.limits.nodes);
+
+        // with --scaling the same batch runs on 1, 2, 4, ... threads up to the requested count
+        std::vector<unsigned> threadCounts;
+        for (unsigned threads = 1; scaling && threads < options.threads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(options.threads);
+
+        double baseline = 0;
+        AnalysisStats stats;
+        GameAnalyzer analyzer(options);
+        for (unsigned threads : threadCounts)
+        {
+            AnalysisOptions run = options;
+            run.threads = threads;
+            analyzer = GameAnalyzer(run);
+            stats = analyzer.run(jobs);
+            if (baseline == 0)
+                baseline = stats.positions / stats.seconds;
+            report(threads, stats, baseline);
+        }
+
+        std::string prefix = argv[2];
+        analyzer.writePgn(prefix + ".pgn");
+        analyzer.writeSummary(prefix + ".cas");
+        std::println("{0} of {1} games analysed, written to {2}.pgn and {2}.cas", stats.validGames, stats.games, prefix);
+        for (size_t i = 0; i < analyzer.getResults().size(); i++)
+        {
+            if (!analyzer.getResults()[i].valid)
+                std::println("skipped {0}: {1}", jobs[i].name, analyzer.getResults()[i].error);
+        }
+        if (!tracePrefix.empty())
+        {
+            Tracer::writeFiles(tracePrefix);
+            std::println("search timings written to {0}.metrics.txt and {0}.trace.json", tracePrefix);
+        }
+        if constexpr (AllocTracker::enabled)
+            AllocTracker::writeReport(std::cout);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <print>
+#include <string>
+#include <vector>
+#include "classes.h"
+#include "archive.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /// @brief packs saved games (.txt), PGN files and directories of either into one archive
+    int pack(const std::string &archivePath, const std::vector<std::string> &inputs)
+    {
+        std::vector<fs::path> files;
+        for (const std::string &input : inputs)
+        {
+            if (fs::is_directory(input))
+            {
+                std::vector<fs::path> found;
+                for (const auto &entry : fs::directory_iterator(input))
+                {
+                    if (entry.path().extension() == ".txt" || entry.path().extension() == ".pgn")
+                        found.push_back(entry.path());
+                }
+                std::sort(found.begin(), found.end());
+                files.insert(files.end(), found.begin(), found.end());
+            }
+            else
+                files.emplace_back(input);
+        }
+
+        GameArchiveWriter writer(archivePath);
+        size_t sourceBytes = 0;
+        size_t rejected = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (const fs::path &file : files)
+        {
+            sourceBytes += fs::file_size(file);
+            if (file.extension() == ".pgn")
+            {
+                PgnStreamReader reader(file.string());
+                PgnGameView game;
+                while (reader.nextGame(game))
+                {
+                    try
+                    {
+                        writer.addPgnGame(game);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        rejected++;
+                        std::cerr << file.string() << ": skipped game: " << e.what() << '\n';
+                    }
+                }
+                continue;
+            }
+
+            ArchivedGame game;
+            try
+            {
+                if (!GameArchive::readTextGame(file.string(), game))
+                    throw std::runtime_error("cannot read file");
+                writer.addGame(game);
+            }
+            catch (const std::exception &e)
+            {
+                rejected++;
+                std::cerr << file.string() << ": skipped game: " << e.what() << '\n';
+            }
+        }
+        writer.finish();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t archiveBytes = fs::file_size(archivePath);
+        std::println("packed {0} games ({1} rejected) from {2} files in {3:.3f} s", writer.getGameCount(), rejected, files.size(), seconds);
+        std::println("size: {0} -> {1} bytes ({2:.1f}x smaller)", sourceBytes, archiveBytes,
+                     archiveBytes ? static_cast<double>(sourceBytes) / archiveBytes : 0.0);
+        return 0;
+    }
+
+    int unpack(const std::string &archivePath, const std::string &outDir)
+    {
+        GameArchiveReader reader(archivePath);
+        ArchivedGame game;
+        fs::create_directories(outDir);
+
+        for (size_t i = 0; i < reader.getGameCount(); i++)
+        {
+            reader.readGame(i, game);
+            std::string name = std::to_string(i + 1);
+            name.insert(0, name.size() < 6 ? 6 - name.size() : 0, '0');
+            GameArchive::writeTextGame((fs::path(outDir) / ("game-" + name + ".txt")).string(), game);
+        }
+        std::println("unpacked {0} games into {1}", reader.getGameCount(), outDir);
+        return 0;
+    }
+
+    int stats(const std::string &archivePath)
+    {
+        auto start = std::chrono::steady_clock::now();
+        GameArchiveReader reader(archivePath);
+        ArchivedGame game;
+        size_t plies = 0;
+
+        for (size_t i = 0; i < reader.getGameCount(); i++)
+        {
+            reader.readGame(i, game);
+            plies += game.moves.size();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::println("games:      {0}", reader.getGameCount());
+        std::println("plies:      {0}", plies);
+        std::println("size:       {0} bytes ({1:.2f} bytes/ply)", reader.getFileSize(),
+                     plies ? static_cast<double>(reader.getFileSize()) / plies : 0.0);
+        std::println("decode:     {0:.3f} s ({1:.0f} games/s)", seconds, reader.getGameCount() / seconds);
+        return 0;
+    }
+}
+
+/// @brief game-archive: converts between the games/ text format, PGN and the binary archive
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (command == "pack" && argc >= 4)
+            return pack(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        if (command == "unpack" && argc == 4)
+            return unpack(argv[2], argv[3]);
+        if (command == "stats" && argc == 3)
+            return stats(argv[2]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::println("usage: {0} pack <archive.cga> <games dir | file.txt | file.pgn>...", argv[0]);
+    std::println("       {0} unpack <archive.cga> <output dir>", argv[0]);
+    std::println("       {0} stats <archive.cga>", argv[0]);
+    return 1;
+}
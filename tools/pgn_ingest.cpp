@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <string>
+#include <thread>
+#include "ingest.h"
+#include "posindex.h"
+
+/// @brief pgn-ingest: validates every game of a PGN file in parallel and optionally writes an index
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::println("usage: {0} <file.pgn> [--readers N] [--parsers N] [--replayers N] [--chunk KB] [--index out.idx] [--position-index dir]", argv[0]);
+        return 1;
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    IngestOptions options;
+    options.path = argv[1];
+    // replay is by far the most expensive stage, so it gets most of the cores by default
+    options.readers = 1;
+    options.parsers = std::max(1u, cores / 8);
+    options.replayers = std::max(1u, cores - options.parsers);
+    std::string indexPath;
+    std::unique_ptr<PositionIndex> positionIndex;
+
+    try
+    {
+        for (int i = 2; i + 1 < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if (flag == "--readers")
+                options.readers = std::stoul(value);
+            else if (flag == "--parsers")
+                options.parsers = std::stoul(value);
+            else if (flag == "--replayers")
+                options.replayers = std::stoul(value);
+            else if (flag == "--chunk")
+                options.chunkSize = std::stoul(value) * 1024;
+            else if (flag == "--index")
+                indexPath = value;
+            else if (flag == "--position-index")
+            {
+                positionIndex = std::make_unique<PositionIndex>(value);
+                options.positionIndex = positionIndex.get();
+            }
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+
+        IngestPipeline pipeline(options);
+        IngestStats stats = pipeline.run();
+        if (!indexPath.empty())
+            pipeline.writeIndex(indexPath);
+
+        double megabytes = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+        std::println("threads:    {0} readers, {1} parsers, {2} replayers", options.readers, options.parsers, options.replayers);
+        std::println("chunks:     {0}", stats.chunks);
+        std::println("games:      {0} ({1} valid, {2} rejected)", stats.games, stats.validGames, stats.games - stats.validGames);
+        std::println("plies:      {0}", stats.plies);
+        std::println("time:       {0:.3f} s", stats.seconds);
+        std::println("throughput: {0:.0f} games/s, {1:.0f} plies/s, {2:.1f} MB/s",
+                     stats.games / stats.seconds, stats.plies / stats.seconds, megabytes / stats.seconds);
+        std::println("stalls:     readers {0}, parsers {1}", stats.readerStalls, stats.parserStalls);
+        if (positionIndex)
+            std::println("positions:  {0} entries for {1} games", positionIndex->getEntryCount(), positionIndex->getGameCount());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <iostream>
+#include <print>
+#include <string>
+#include <vector>
+#include "classes.h"
+#include "archive.h"
+#include "posindex.h"
+#include "fen.h"
+
+namespace
+{
+    /// @brief adds every game of a binary archive, named "<archive>#<game number>"
+    int build(const std::string &indexDir, const std::string &archivePath)
+    {
+        auto start = std::chrono::steady_clock::now();
+        PositionIndex index(indexDir);
+        GameArchiveReader reader(archivePath);
+        PieceFactory factory;
+        GameManager gm(factory);
+        ArchivedGame game;
+
+        for (size_t i = 0; i < reader.getGameCount(); i++)
+        {
+            reader.readGame(i, gm, game);
+            index.addGame(archivePath + "#" + std::to_string(i + 1), game.result, gm);
+        }
+        index.compact();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::println("indexed {0} games in {1:.3f} s, {2} positions in total", reader.getGameCount(), seconds, index.getEntryCount());
+        return 0;
+    }
+
+    /// @brief plays the given SAN moves from the starting position (or --fen) and lists what the index knows about the result
+    int query(const std::string &indexDir, const std::vector<std::string> &moves)
+    {
+        PositionIndex index(indexDir);
+        PieceFactory factory;
+        GameManager gm(factory);
+        gm.resetGame();
+        size_t first = 0;
+        if (moves.size() >= 2 && moves[0] == "--fen")
+        {
+            FenNotation::fromFen(gm, moves[1]);
+            first = 2;
+        }
+        for (const std::string &san : std::vector<std::string>(moves.begin() + first, moves.end()))
+        {
+            std::optional<Move> move = SanNotation::fromSan(gm, san);
+            if (!move)
+                throw std::invalid_argument("illegal or ambiguous move '" + san + "'");
+            gm.replayMove(*move);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<ExplorerLine> lines = index.explore(gm.getPositionHash());
+        std::vector<PositionEntry> hits = index.find(gm.getPositionHash());
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::println("position {0:016x}: {1} occurrences, looked up in {2:.3f} ms", gm.getPositionHash(), hits.size(), milliseconds);
+        for (const ExplorerLine &line : lines)
+        {
+            std::println("  {0:<8} {1:>7} games  +{2} ={3} -{4}", SanNotation::toSan(gm, PositionIndex::unpackMove(line.move)),
+                         line.games, line.whiteWins, line.draws, line.blackWins);
+        }
+
+        // the same position at a different ply is a transposition
+        const size_t shown = 20;
+        for (size_t i = 0; i < hits.size() && i < shown; i++)
+        {
+            std::optional<IndexedGame> game = index.getGame(hits[i].gameId);
+            std::println("  {0} at ply {1}{2}", game->name, hits[i].ply, hits[i].ply != moves.size() - first ? " (transposition)" : "");
+        }
+        if (hits.size() > shown)
+            std::println("  ... {0} more", hits.size() - shown);
+        return 0;
+    }
+
+    int stats(const std::string &indexDir)
+    {
+        PositionIndex index(indexDir);
+        std::println("games:      {0}", index.getGameCount());
+        std::println("positions:  {0}", index.getEntryCount());
+        return 0;
+    }
+}
+
+/// @brief position-index: builds and queries the position-hash index of saved games
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (command == "build" && argc == 4)
+            return build(argv[2], argv[3]);
+        if (command == "query" && argc >= 3)
+            return query(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        if (command == "compact" && argc == 3)
+        {
+            PositionIndex(argv[2]).compact();
+            return 0;
+        }
+        if (command == "stats" && argc == 3)
+            return stats(argv[2]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::println("usage: {0} build <index dir> <archive.cga>", argv[0]);
+    std::println("       {0} query <index dir> [--fen <fen>] [SAN move]...", argv[0]);
+    std::println("       {0} compact <index dir>", argv[0]);
+    std::println("       {0} stats <index dir>", argv[0]);
+    return 1;
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <iostream>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include "puzzle.h"
+
+/// @brief puzzle-mine: finds positions with a single winning move in a batch of games and writes them as EPD
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::println("usage: {0} <games dir | archive.cga | file.pgn> <out.epd> [--threads N] [--filter-depth N] [--swing CP] [--depth N] [--nodes N] [--win CP] [--gap CP]", argv[0]);
+        return 1;
+    }
+
+    PuzzleOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    try
+    {
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if (flag == "--threads")
+                options.threads = std::stoul(value);
+            else if (flag == "--filter-depth")
+                options.filter.depth = std::stoi(value);
+            else if (flag == "--swing")
+                options.swing = std::stoi(value);
+            else if (flag == "--depth")
+                options.verify.depth = std::stoi(value);
+            else if (flag == "--nodes")
+                options.verify.nodes = std::stoull(value);
+            else if (flag == "--win")
+                options.win = std::stoi(value);
+            else if (flag == "--gap")
+                options.uniqueGap = std::stoi(value);
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+
+        std::vector<AnalysisJob> jobs = GameAnalyzer::loadJobs(argv[1]);
+        PuzzleMiner miner(options);
+        PuzzleStats stats = miner.run(jobs);
+        miner.writeEpd(argv[2]);
+
+        std::println("threads:    {0}", options.threads);
+        std::println("games:      {0}", stats.games);
+        std::println("positions:  {0}", stats.positions);
+        std::println("candidates: {0} ({1:.2f}% of positions, {2} duplicates)", stats.candidates,
+                     stats.positions ? 100.0 * stats.candidates / stats.positions : 0.0, stats.duplicates);
+        std::println("puzzles:    {0}", stats.puzzles);
+        std::println("time:       {0:.3f} s", stats.seconds);
+        std::println("throughput: {0:.0f} positions/s, {1:.0f} nodes/s", stats.positions / stats.seconds, stats.nodes / stats.seconds);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
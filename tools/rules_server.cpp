@@ -0,0 +1,38 @@
+#include <csignal>
+#include <iostream>
+#include <print>
+#include <string>
+#include "rules.h"
+
+/// @brief rules-server: answers batched legality, status and move-list queries on a Unix domain socket until stopped
+int main(int argc, char **argv)
+{
+    if (argc != 2 || std::string(argv[1]) == "--help")
+    {
+        std::println("usage: {0} <socket>", argv[0]);
+        std::println("answers RulesService frames (see rules.h) on the socket until SIGINT or SIGTERM");
+        return argc != 2 ? 1 : 0;
+    }
+
+    try
+    {
+        // blocked before any thread starts, so only sigwait below sees them
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        RulesServer server(argv[1]);
+        std::println("listening on {0}", server.getPath());
+        int signal;
+        sigwait(&signals, &signal);
+        std::println("stopping");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
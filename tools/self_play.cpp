@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <string>
+#include <thread>
+#include "alloc.h"
+#include "match.h"
+#include "spectate.h"
+
+namespace
+{
+    const char *statusName(GameStatus status)
+    {
+        switch (status)
+        {
+        case GameStatus::CHECKMATE:
+            return "checkmate";
+        case GameStatus::STALEMATE:
+            return "stalemate";
+        case GameStatus::INSUFFICIENT_MATERIAL:
+            return "material";
+        case GameStatus::FIFTY_MOVE_RULE:
+            return "fifty-move";
+        case GameStatus::THREEFOLD_REPETITION:
+            return "repetition";
+        default:
+            return "adjudicated";
+        }
+    }
+
+    void reportSide(const char *label, const EngineConfig &config, const SideStats &stats)
+    {
+        std::println("{0} {1}: {2} moves, {3:.0f} nodes/s, {4:.0f} us per move, {5} us max", label, config.name, stats.moves,
+                     stats.nodesPerSecond(), stats.microsecondsPerMove(), stats.maxMoveTime.count());
+    }
+}
+
+/// @brief self-play: plays engine configuration B against A on all cores until the SPRT decides or the games run out
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--help")
+    {
+        std::println("usage: {0} [--games N] [--threads N] [--openings file] [--opening-plies N]", argv[0]);
+        std::println("       [--a-depth N] [--a-nodes N] [--a-time ms] [--b-depth N] [--b-nodes N] [--b-time ms] [--hash MB]");
+        std::println("       [--elo0 E] [--elo1 E] [--alpha P] [--beta P] [--max-plies N] [--log games.tsv]");
+        std::println("       [--spectate socket]");
+        return 0;
+    }
+
+    MatchOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    options.a.name = "A";
+    options.b.name = "B";
+    std::string openingsPath;
+    size_t openingPlies = 8;
+    std::unique_ptr<std::ofstream> log;
+    std::unique_ptr<SpectatorServer> spectators;
+
+    try
+    {
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            // --a-nodes and the like pick the side by their third character
+            EngineConfig *side = (flag.size() > 4 && flag[3] == '-') ? (flag[2] == 'a' ? &options.a : &options.b) : nullptr;
+            std::string option = side ? "--" + flag.substr(4) : flag;
+            if (side && option == "--depth")
+                side->limits = {std::stoi(value), 0, {}};
+            else if (side && option == "--nodes")
+                side->limits = {0, std::stoull(value), {}};
+            else if (side && option == "--time")
+                side->limits = {0, 0, std::chrono::milliseconds(std::stoi(value))};
+            else if (flag == "--games")
+                options.maxGames = std::stoul(value);
+            else if (flag == "--threads")
+                options.threads = std::stoul(value);
+            else if (flag == "--openings")
+                openingsPath = value;
+            else if (flag == "--opening-plies")
+                openingPlies = std::stoul(value);
+            else if (flag == "--hash")
+                options.a.tableMegabytes = options.b.tableMegabytes = std::stoul(value);
+            else if (flag == "--elo0")
+                options.sprt.elo0 = std::stod(value);
+            else if (flag == "--elo1")
+                options.sprt.elo1 = std::stod(value);
+            else if (flag == "--alpha")
+                options.sprt.alpha = std::stod(value);
+            else if (flag == "--beta")
+                options.sprt.beta = std::stod(value);
+            else if (flag == "--max-plies")
+                options.maxPlies = std::stoul(value);
+            else if (flag == "--log")
+                log = std::make_unique<std::ofstream>(value, std::ios::trunc);
+            else if (flag == "--spectate")
+                spectators = std::make_unique<SpectatorServer>(SpectatorOptions{value});
+            else
+                throw std::invalid_argument("unknown option " + flag);
+        }
+        if (!openingsPath.empty())
+            options.openings = MatchRunner::loadOpenings(openingsPath, openingPlies);
+
+        if (log)
+            *log << "game\topening\tb_color\tresult\tend\tplies\ta_nodes\ta_us\tb_nodes\tb_us\n";
+        options.onGame = [&log](const MatchGame &game, const MatchStats &stats)
+        {
+            if (log)
+                *log << stats.games << '\t' << game.opening << '\t' << (game.bIsWhite ? "white" : "black") << '\t' << game.score << '\t'
+                     << statusName(game.status) << '\t' << game.plies << '\t' << game.a.nodes << '\t' << game.a.time.count() << '\t'
+                     << game.b.nodes << '\t' << game.b.time.count() << '\n';
+            if (stats.games % 10 == 0)
+                std::println("{0} games: +{1} ={2} -{3}, LLR {4:.2f} ({5:.2f}, {6:.2f})", stats.games, stats.wins, stats.draws,
+                             stats.losses, stats.llr, stats.lowerBound, stats.upperBound);
+        };
+
+        options.spectators = spectators.get();
+        MatchRunner runner(options);
+        MatchStats stats = runner.run();
+
+        const char *verdict = stats.verdict > 0 ? "H1 accepted" : stats.verdict < 0 ? "H0 accepted" : "inconclusive";
+        std::println("result: {0} games, B +{1} ={2} -{3}, {4:+.1f} elo, LLR {5:.2f} ({6:.2f}, {7:.2f}), {8}", stats.games,
+                     stats.wins, stats.draws, stats.losses, stats.eloDifference(), stats.llr, stats.lowerBound, stats.upperBound, verdict);
+        reportSide("A", options.a, stats.a);
+        reportSide("B", options.b, stats.b);
+        if constexpr (AllocTracker::enabled)
+            AllocTracker::writeReport(std::cout);
+        std::println("time:   {0:.1f} s on {1} threads, {2:.2f} games/s", stats.seconds, options.threads, stats.games / stats.seconds);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}